@@ -1,10 +1,36 @@
 #define _USE_MATH_DEFINES
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
 #include <vector>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <glm/gtc/type_ptr.hpp>
-#include "GLShader.h"
+#include "Bvh.h"
+#include "CommandList.h"
+#include "CpuTexture.h"
+#include "FileWatcher.h"
+#include "GLRenderBackend.h"
+#include "ImageFile.h"
+#include "JobSystem.h"
+#include "LinearArena.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "MeshPool.h"
+#include "MeshQuantizer.h"
+#include "MeshSimplifier.h"
+#include "Meshlets.h"
+#include "ObjParser.h"
+#include "OcclusionBuffer.h"
+#include "PathTracer.h"
+#include "RingBuffer.h"
+#include "SoftwareRenderer.h"
 #include <iostream>
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -15,6 +41,7 @@
 using glm::mat4;
 using glm::vec2;
 using glm::vec3;
+using glm::vec4;
 
 // External optimus settings
 extern "C" {
@@ -31,11 +58,25 @@ struct Vertex2 {
     vec2 texCoords;
 };
 
-// Struct for 3D vertex
-struct Vertex3 {
-    vec3 position;
-    vec3 normal;
-    vec2 texCoords;
+// Per-object data read by the 3d shaders (std430 layout, see 3d.vs.glsl)
+struct ObjectData {
+    mat4 transformNormal;
+    mat4 transformWithProjection;
+    vec4 positionOffset;
+    vec4 positionScale;
+    vec4 ambientColor;
+    vec4 diffuseColor;
+    vec4 specularColor; // w: shininess
+};
+
+// Per-frame data read by the 3d shaders (std430 layout, see 3d.fs.glsl)
+struct FrameData {
+    vec4 lightDirection;
+    vec4 lightAmbientColor;
+    vec4 lightDiffuseColor;
+    vec4 lightSpecularColor;
+    vec3 view;
+    float time;
 };
 
 // Constants
@@ -44,6 +85,14 @@ const float DEG_TO_RAD = PI / 180;
 const float RAD_TO_DEG = 180 / PI;
 const float EPSILON = 0.01f;
 const float MOVEMENT_SPEED = 0.1f;
+const uint32_t PATH_TRACER_SAMPLES = 64;
+
+// Moves `data` to the heap, kept alive by the upload that copies it
+template <typename T>
+std::shared_ptr<const void> ShareUploadData(std::vector<T> data) {
+    auto shared = std::make_shared<std::vector<T>>(std::move(data));
+    return std::shared_ptr<const void>(shared, shared->data());
+}
 
 // Function for cotangent
 float cotan(float x) {
@@ -96,39 +145,112 @@ mat4 RotateZ(float angle) {
 
 class Application;
 
+// Draw commands sharing a pipeline, a texture and a mesh pool, submitted with
+// a single glMultiDrawElementsIndirect
+struct RenderBatch {
+    uint32_t pipeline = RENDER_NONE;
+    uint32_t texture = RENDER_NONE;
+    MeshPool* pool = nullptr;
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<uint32_t> drawObjects;
+};
+
+// Draws recorded from a chunk of objects, per batch; the chunks are merged
+// in order into the batches, so the frame does not depend on which thread
+// recorded what
+struct DrawRecorder {
+    std::vector<std::vector<DrawElementsIndirectCommand>> commands;
+    std::vector<std::vector<uint32_t>> drawObjects;
+    size_t occludedObjects = 0;
+    size_t occludedTriangles = 0;
+    size_t occludedMeshlets = 0;
+};
+
 class Obj {
 public:
     Application& app;
-    GLShader shader;
-    GLuint buffers[3] = { 0, 0, 0 };
-    GLuint vao = 0;
-    GLuint texture = 0;
+    uint32_t pipeline = RENDER_NONE;
+    // Texture drawn with, the placeholder until textureFile is uploaded
+    uint32_t texture = RENDER_NONE;
+    std::string textureFile;
+    std::string objFile;
+    MeshRange meshRange;
+    // Loading: load() runs as a job, then upload() queues the mesh uploads on
+    // the render thread. The object is drawn once they are done, with the
+    // placeholder texture until its own is uploaded
+    bool loaded = false;
+    std::shared_ptr<const void> uploadVertices;
+    size_t uploadVertexCount = 0;
+    std::shared_ptr<const void> uploadIndices;
+    std::vector<uint32_t> uploads;
+    bool uploaded = false;
+    bool textureUploaded = false;
+    size_t batch = 0;
     int numOfIndices = 0;
+    std::vector<MeshLod> lods;
+    vec3 boundsMin = { 0, 0, 0 };
+    vec3 boundsMax = { 0, 0, 0 };
+    vec3 boundsCenter = { 0, 0, 0 };
+    float boundsRadius = 0;
+    // CPU copy of the mesh, for meshlet culling and the occluder pass
+    Mesh mesh;
+    // Object space BVH of level 0, instanced by the scene's top level tree
+    Bvh blas;
     tinyobj::material_t material;
+    // .mtl files the material was looked up in, watched like the OBJ file
+    std::vector<std::string> materialFiles;
     vec3 scale = { 1, 1, 1 };
     float angle = 0;
     vec3 translation = { 0, 0, 0 };
     std::string name;
+    // Import options, set before initialize()
+    bool optimizeMesh = true;
+    bool optimizeOverdraw = false;
+    // Build simplified levels of detail (needs optimizeMesh), drawn while
+    // their error stays under lodPixelError pixels on screen
+    bool generateLods = true;
+    float lodPixelError = 1;
+    // Split level 0 into meshlets (needs optimizeMesh), culled on the CPU
+    // every frame
+    bool buildMeshlets = true;
+    // Store PackedVertex3 instead of Vertex3, drawn with the QUANTIZED
+    // permutation of the 3d shaders
+    bool quantizeVertices = false;
+    // Other shader permutation defines, see 3d.vs.glsl and 3d.fs.glsl
+    std::vector<std::string> shaderDefines;
+    vec3 positionOffset = { 0, 0, 0 };
+    vec3 positionScale = { 1, 1, 1 };
 
     explicit Obj(Application& app, const std::string& name = "") : app(app), name(name) {}
 
     void initialize(const char* shaderFileV, const char* shaderFileF, const std::string& objFile, const char* textureFile);
-    void render();
-    void destroy();
-    inline uint32_t getProgram() {
-        return this->shader.GetProgram();
-    }
+    std::string getObjFilePath() const;
+    bool load(std::ostream& log);
+    void upload();
+    void takeMesh(Obj& loaded);
+    bool importMesh(const std::string& objFilePath, MeshCacheData& data, std::ostream& log);
+    mat4 getTransform() const;
+    size_t selectLod(const mat4& transform, float pixelError, float screenHeight) const;
+    void renderOccluder(OcclusionBuffer& occlusionBuffer);
+    void buildBlas();
+    void render(uint32_t objectIndex, DrawRecorder& recorder) const;
 };
 
 class Application {
 public:
     int width;
     int height;
-    GLShader basicShader;
-    GLuint pausedBuffers[2] = { 0, 0 };
-    GLuint pausedVao = 0;
-    GLuint pausedTexture = 0;
+    // Everything drawn goes through the backend: resources are created
+    // there, each frame is recorded into frameCommands and submitted
+    GLRenderBackend backend;
+    CommandList frameCommands;
+    uint32_t pausedPipeline = RENDER_NONE;
+    uint32_t pausedBuffers[2] = { RENDER_NONE, RENDER_NONE };
+    uint32_t pausedTexture = RENDER_NONE;
     GLFWwindow* window = nullptr;
+    // Hidden window whose context, shared with the window's, is current on
+    // the backend's upload thread
+    GLFWwindow* uploadContext = nullptr;
     double lastMouseX = 0;
     double lastMouseY = 0;
     float cameraPhi = PI / 2;
@@ -140,9 +262,106 @@ public:
     mat4 projection = {};
     bool canMove = false;
     GLFWcursor* handCursor = nullptr;
+    // Run without a window or a GL context (--headless): no pipelines or GL
+    // textures are created, see runHeadless()
+    bool headless = false;
 
     std::vector<Obj> objects;
 
+    // Texture decoded by a job then uploaded; RENDER_NONE until decoded.
+    // A new version loaded after the file changed waits in `reloaded`
+    struct TextureAsset {
+        uint32_t texture = RENDER_NONE;
+        uint32_t upload = 0;
+        bool failed = false;
+        uint32_t reloaded = RENDER_NONE;
+        uint32_t reloadedUpload = 0;
+    };
+
+    // Shared by all objects: pipelines and textures by file name, one mesh
+    // pool per vertex format (Vertex3, PackedVertex3)
+    std::map<std::string, uint32_t> pipelines;
+    std::map<std::string, TextureAsset> textures;
+    // 1x1 white texture the objects are drawn with until theirs is uploaded
+    uint32_t placeholderTexture = RENDER_NONE;
+    MeshPool meshPools[2];
+
+    // The loading jobs hand their results to the render thread through
+    // loadCompletions, run at the start of the next frame. The main loop
+    // starts right away; the time until every object is drawn with its own
+    // texture is reported once
+    std::mutex loadMutex;
+    std::vector<std::function<void()>> loadCompletions;
+    bool fullyLoaded = false;
+
+    // Hot reload: the shaders (includes too), meshes and textures are
+    // watched; a changed shader file recompiles the permutations built from
+    // it and rebuilds the pipelines using them, a changed mesh or texture is
+    // loaded again in the background and swapped in between two frames once
+    // uploaded. Reload actions by file path
+    FileWatcher fileWatcher;
+    std::map<std::string, std::vector<std::function<void()>>> fileReloads;
+    // Objects loaded again, by index, waiting for their uploads
+    std::vector<std::pair<size_t, std::shared_ptr<Obj>>> meshReloads;
+    std::vector<RenderBatch> batches;
+    // Batches sorted by pipeline then texture, replayed in that order
+    std::vector<size_t> batchOrder;
+    // Per-frame draw data, written straight into frameRing and bound by
+    // offset: the per-object data (an ObjectData per object, filled by the
+    // recording jobs), then the object of each draw command, the draw
+    // commands and the FrameData
+    RingBuffer frameRing;
+    RingAllocation objectData;
+
+    // Software occlusion culling: the objects are drawn into a small depth
+    // buffer first, then tested against its depth pyramid
+    bool occlusionCulling = true;
+    OcclusionBuffer occlusionBuffer;
+    // Occluders are coarse LODs, boxes are grown by their error so the
+    // simplified silhouettes never hide something visible
+    float occluderPixelError = 2;
+    float occluderError = 0;
+    // Occlusion statistics, reported every second
+    struct OcclusionStats {
+        size_t frames = 0;
+        double seconds = 0;
+        size_t objects = 0;
+        size_t meshlets = 0;
+        size_t triangles = 0;
+        double lastReport = 0;
+    } occlusionStats;
+
+    // Runs the loading and per-frame work spread over the cores
+    JobSystem jobs;
+
+    // The objects' transforms, culling and draw commands are computed as
+    // jobs, one per chunk of objects
+    std::vector<DrawRecorder> drawRecorders;
+    // Recording and job statistics, reported every second
+    struct RecordStats {
+        size_t frames = 0;
+        double seconds = 0;
+        double fenceWaitSeconds = 0;
+        double lastReport = 0;
+    } recordStats;
+
+    // Top level tree over the objects' BVHs, for picking with the right
+    // mouse button; rebuilt when an object moves
+    Tlas sceneTlas;
+    std::vector<TlasInstance> sceneInstances;
+
+    // Offline reference of the current view (key P), written to render.ppm
+    PathTracer pathTracer;
+    std::map<std::string, CpuTexture> cpuTextures;
+
+    // CPU rasterization of the current view through the RenderDevice
+    // interface (key R), benchmarked per thread count and written to
+    // software.ppm; device mesh and texture of each object, created again
+    // after a hot reload
+    SoftwareRenderer softwareRenderer;
+    std::vector<uint32_t> deviceMeshes;
+    std::vector<uint32_t> deviceTextures;
+
     Application(int width, int height) : width(width), height(height) {}
 
     inline void setSize(int width, int height) {
@@ -151,41 +370,194 @@ public:
     }
 
     bool initialize(GLFWwindow* window);
+    int runHeadless(bool pathTraced);
+    void createObjects();
+    void updateCamera();
+    uint32_t getPipeline(const char* shaderFileV, const char* shaderFileF, const std::vector<std::string>& defines, bool quantized);
+    void requestTexture(const std::string& textureFile);
+    void loadObjects();
+    void finishOnRenderThread(std::function<void()> completion);
+    void updateLoading();
+    void watchFile(const std::string& path, std::function<void()> reload);
+    void watchShaders(uint32_t pipeline);
+    void reloadShader(const std::string& path);
+    void reloadTexture(const std::string& textureFile);
+    void reloadMesh(size_t index);
+    void updateHotReload();
+    const CpuTexture* getCpuTexture(const std::string& textureFile);
+    size_t getBatch(uint32_t pipeline, uint32_t texture, MeshPool* pool);
+    void buildSceneTlas();
+    void updateSceneTlas();
+    bool castCursorRay(const mat4& inverseViewProjection, double x, double y, TlasHit& hit) const;
+    void pick();
+    void benchmarkPicking();
+    void renderPathTraced();
+    void createDeviceScene(RenderDevice& device);
+    void renderDevice(RenderDevice& device);
+    void renderSoftware();
+    void renderOcclusion();
+    void recordDraws();
+    void renderBatches();
     void renderPaused();
     void render();
     void deinitialize();
-    inline uint32_t getBasicProgram() {
-        return this->basicShader.GetProgram();
-    }
 };
 
 // Implementation of Obj methods
 void Obj::initialize(const char* shaderFileV, const char* shaderFileF, const std::string& objFile, const char* textureFile) {
-    // File paths
-    std::string vertexShaderPath = std::string("C:\\Users\\Safi\\Desktop\\computer-grphics-ESIEE\\OpenGL-OBJ-Renderer\\Projet\\shaders\\") + shaderFileV;
-    std::string fragmentShaderPath = std::string("C:\\Users\\Safi\\Desktop\\computer-grphics-ESIEE\\OpenGL-OBJ-Renderer\\Projet\\shaders\\") + shaderFileF;
-    std::string objFilePath = std::string("C:\\Users\\Safi\\Desktop\\computer-grphics-ESIEE\\OpenGL-OBJ-Renderer\\Projet\\Obj\\") + objFile;
-    std::string textureFilePath = std::string("C:\\Users\\Safi\\Desktop\\computer-grphics-ESIEE\\OpenGL-OBJ-Renderer\\Projet\\Obj\\") + textureFile;
+    // Pipelines and textures are shared between objects; the texture and the
+    // mesh are loaded by jobs, see Application::loadObjects()
+    this->pipeline = this->app.getPipeline(shaderFileV, shaderFileF, this->shaderDefines, this->quantizeVertices);
+    this->textureFile = textureFile;
+    this->app.requestTexture(textureFile);
+    this->objFile = objFile;
+}
+
+std::string Obj::getObjFilePath() const {
+    return std::string("C:\\Users\\Safi\\Desktop\\computer-grphics-ESIEE\\OpenGL-OBJ-Renderer\\Projet\\Obj\\") + this->objFile;
+}
+
+// Imports the mesh, or loads it from the cache, and builds everything the
+// CPU needs of it; runs as a job and only touches this object, the messages
+// go to `log`. Returns false if the OBJ file cannot be parsed
+bool Obj::load(std::ostream& log) {
+    std::string objFilePath = this->getObjFilePath();
+
+    // Load the processed mesh from the cache, or import the OBJ file
+    std::string cachePath = objFilePath + ".meshcache";
+    bool lodsEnabled = this->optimizeMesh && this->generateLods;
+    bool meshletsEnabled = this->optimizeMesh && this->buildMeshlets;
+    uint32_t cacheOptions = (this->optimizeMesh ? 1u : 0u) | (this->optimizeOverdraw ? 2u : 0u) |
+        (lodsEnabled ? 4u : 0u) | (meshletsEnabled ? 8u : 0u);
+    MeshCacheKey cacheKey;
+    MeshCacheData meshData;
+    bool cacheable = GetMeshCacheKey(objFilePath, cacheOptions, cacheKey);
+    if (cacheable && LoadMeshCache(cachePath, cacheKey, meshData)) {
+        log << "Loaded mesh cache: " << cachePath << std::endl;
+    } else {
+        if (!this->importMesh(objFilePath, meshData, log))
+            return false;
+        if (cacheable && !SaveMeshCache(cachePath, cacheKey, meshData))
+            std::cerr << "Failed to write mesh cache: " << cachePath << std::endl;
+    }
+    if (this->optimizeMesh) {
+        log << "Vertices: " << meshData.sourceVertexCount << " -> " << meshData.mesh.vertices.size()
+            << ", ACMR: " << meshData.statsBefore.acmr << " -> " << meshData.statsAfter.acmr
+            << ", ATVR: " << meshData.statsBefore.atvr << " -> " << meshData.statsAfter.atvr << std::endl;
+    }
+    const Mesh& mesh = meshData.mesh;
+    this->lods = mesh.lods;
+    if (this->lods.empty())
+        this->lods.push_back({ 0, uint32_t(mesh.indices.size()), 0 });
+    this->numOfIndices = int(this->lods[0].indexCount);
+    if (this->lods.size() > 1) {
+        log << "LODs:";
+        for (const MeshLod& lod : this->lods)
+            log << " " << lod.indexCount / 3 << " (" << lod.error << ")";
+        log << " triangles (error)" << std::endl;
+    }
+
+    // Bounding box and sphere, for occlusion culling and LOD selection
+    if (!mesh.vertices.empty()) {
+        this->boundsMin = mesh.vertices[0].position;
+        this->boundsMax = this->boundsMin;
+        for (const Vertex3& vertex : mesh.vertices) {
+            this->boundsMin = glm::min(this->boundsMin, vertex.position);
+            this->boundsMax = glm::max(this->boundsMax, vertex.position);
+        }
+        this->boundsCenter = (this->boundsMin + this->boundsMax) * 0.5f;
+        this->boundsRadius = glm::length(this->boundsMax - this->boundsMin) * 0.5f;
+    }
+    this->material = meshData.material;
+    this->materialFiles.clear();
+    for (const MeshCacheDependency& dependency : meshData.dependencies)
+        this->materialFiles.push_back(dependency.path);
+
+    // Data for the pool of its vertex format, uploaded from copies since the
+    // CPU mesh is kept
+    if (this->quantizeVertices) {
+        QuantizedMesh quantized;
+        QuantizationError error;
+        QuantizeMesh(mesh, quantized, &error);
+        this->positionOffset = quantized.positionOffset;
+        this->positionScale = quantized.positionScale;
+        log << "Quantized vertices: " << sizeof(Vertex3) << " -> " << sizeof(PackedVertex3) << " bytes ("
+            << mesh.vertices.size() * sizeof(Vertex3) / 1024 << " -> " << quantized.vertices.size() * sizeof(PackedVertex3) / 1024
+            << " KB), max error: position " << error.position << " (" << error.positionRelative * 100 << "% of extent)"
+            << ", normal " << error.normalDegrees << " deg, texCoords " << error.texCoords << std::endl;
+        this->uploadVertexCount = quantized.vertices.size();
+        this->uploadVertices = ShareUploadData(std::move(quantized.vertices));
+    } else {
+        this->uploadVertexCount = mesh.vertices.size();
+        this->uploadVertices = ShareUploadData(mesh.vertices);
+    }
+    this->uploadIndices = ShareUploadData(mesh.indices);
+    this->mesh = std::move(meshData.mesh);
 
-    // Load shaders
-    std::cout << "Trying to open vertex shader file: " << vertexShaderPath << std::endl;
-    this->shader.LoadVertexShader(vertexShaderPath.c_str());
-    std::cout << "Trying to open fragment shader file: " << fragmentShaderPath << std::endl;
-    this->shader.LoadFragmentShader(fragmentShaderPath.c_str());
-    this->shader.Create();
+    this->buildBlas();
+    if (!this->blas.IsEmpty())
+        log << "BLAS: " << this->blas.GetTriangleCount() << " triangles, " << this->blas.GetNodeCount()
+            << " nodes, built in " << this->blas.GetBuildSeconds() * 1000 << " ms" << std::endl;
+    return true;
+}
 
+// Appends the loaded mesh to the pool of its vertex format, on the render
+// thread; the uploads finish in the background
+void Obj::upload() {
+    MeshPool& pool = this->app.meshPools[this->quantizeVertices ? 1 : 0];
+    uint32_t meshUploads[2];
+    this->meshRange = pool.AddAsync(std::move(this->uploadVertices), this->uploadVertexCount, std::move(this->uploadIndices),
+        this->mesh.indices.size(), meshUploads);
+    this->uploads.assign(meshUploads, meshUploads + 2);
+    this->loaded = true;
+}
+
+// Replaces the mesh with the one `loaded` holds, once it is uploaded; the
+// pool range of the old one is reused once the frames drawing it are done
+void Obj::takeMesh(Obj& loaded) {
+    this->app.meshPools[this->quantizeVertices ? 1 : 0].Remove(this->meshRange);
+    this->meshRange = loaded.meshRange;
+    this->lods = std::move(loaded.lods);
+    this->numOfIndices = loaded.numOfIndices;
+    this->boundsMin = loaded.boundsMin;
+    this->boundsMax = loaded.boundsMax;
+    this->boundsCenter = loaded.boundsCenter;
+    this->boundsRadius = loaded.boundsRadius;
+    this->mesh = std::move(loaded.mesh);
+    this->blas = std::move(loaded.blas);
+    this->material = loaded.material;
+    this->positionOffset = loaded.positionOffset;
+    this->positionScale = loaded.positionScale;
+}
+
+// Builds the object space BVH of level 0; only touches this object, so
+// objects are built in parallel
+void Obj::buildBlas() {
+    if (this->mesh.vertices.empty())
+        return;
+    BvhMesh blasMesh;
+    blasMesh.positions = &this->mesh.vertices[0].position;
+    blasMesh.positionStride = sizeof(Vertex3);
+    blasMesh.indices = this->mesh.indices.data();
+    blasMesh.indexCount = this->lods[0].indexCount;
+    this->blas.Build({ blasMesh });
+}
+
+bool Obj::importMesh(const std::string& objFilePath, MeshCacheData& data, std::ostream& log) {
     // Load OBJ file
-    std::cout << "Trying to open OBJ file: " << objFilePath << std::endl;
-    tinyobj::ObjReader reader;
+    log << "Trying to open OBJ file: " << objFilePath << std::endl;
+    FastObjReader reader;
     if (!reader.ParseFromFile(objFilePath)) {
         if (!reader.Error().empty()) {
-            std::cerr << "TinyObjReader(" << objFilePath << "): " << reader.Error();
+            std::cerr << "FastObjReader(" << objFilePath << "): " << reader.Error();
         }
-        exit(1);
+        return false;
     }
     if (!reader.Warning().empty()) {
-        std::cout << "TinyObjReader(" << objFilePath << "): " << reader.Warning();
+        log << "FastObjReader(" << objFilePath << "): " << reader.Warning();
     }
+    log << "Parsed " << reader.BytesParsed() / 1024 << " KB in " << reader.ParseSeconds() * 1000
+        << " ms (" << reader.ThroughputMBps() << " MB/s, " << reader.ChunkCount() << " chunks)" << std::endl;
 
     // Process OBJ data
     auto& attrib = reader.GetAttrib();
@@ -195,104 +567,70 @@ void Obj::initialize(const char* shaderFileV, const char* shaderFileF, const std
     for (const auto& shape : shapes)
         for (const auto& num_face_vertice : shape.mesh.num_face_vertices)
             verticesCount += size_t(num_face_vertice);
-    this->numOfIndices = int(verticesCount);
 
-    std::vector<float> objVertices(8 * verticesCount);
-    std::vector<int> objIndices(verticesCount);
+    Mesh& mesh = data.mesh;
+    mesh.vertices.assign(verticesCount, Vertex3());
+    mesh.indices.resize(verticesCount);
 
     size_t vertex_offset = 0;
-    size_t index_offset = 0;
     for (const auto& shape : shapes) {
         size_t shape_index_offset = 0;
         for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); f++) {
             auto fv = size_t(shape.mesh.num_face_vertices[f]);
             for (size_t v = 0; v < fv; v++) {
                 tinyobj::index_t idx = shape.mesh.indices[shape_index_offset + v];
-                objVertices[8 * vertex_offset + 0] = attrib.vertices[3 * size_t(idx.vertex_index) + 0];
-                objVertices[8 * vertex_offset + 1] = attrib.vertices[3 * size_t(idx.vertex_index) + 2];
-                objVertices[8 * vertex_offset + 2] = -attrib.vertices[3 * size_t(idx.vertex_index) + 1];
+                Vertex3& vertex = mesh.vertices[vertex_offset];
+                vertex.position.x = attrib.vertices[3 * size_t(idx.vertex_index) + 0];
+                vertex.position.y = attrib.vertices[3 * size_t(idx.vertex_index) + 2];
+                vertex.position.z = -attrib.vertices[3 * size_t(idx.vertex_index) + 1];
                 if (idx.normal_index >= 0) {
-                    objVertices[8 * vertex_offset + 3] = attrib.normals[3 * size_t(idx.normal_index) + 0];
-                    objVertices[8 * vertex_offset + 4] = attrib.normals[3 * size_t(idx.normal_index) + 2];
-                    objVertices[8 * vertex_offset + 5] = -attrib.normals[3 * size_t(idx.normal_index) + 1];
+                    vertex.normal.x = attrib.normals[3 * size_t(idx.normal_index) + 0];
+                    vertex.normal.y = attrib.normals[3 * size_t(idx.normal_index) + 2];
+                    vertex.normal.z = -attrib.normals[3 * size_t(idx.normal_index) + 1];
                 }
                 if (idx.texcoord_index >= 0) {
-                    objVertices[8 * vertex_offset + 6] = attrib.texcoords[2 * size_t(idx.texcoord_index) + 0];
-                    objVertices[8 * vertex_offset + 7] = attrib.texcoords[2 * size_t(idx.texcoord_index) + 1];
+                    vertex.texCoords.x = attrib.texcoords[2 * size_t(idx.texcoord_index) + 0];
+                    vertex.texCoords.y = attrib.texcoords[2 * size_t(idx.texcoord_index) + 1];
                 }
-                objIndices[index_offset] = int(vertex_offset);
+                mesh.indices[vertex_offset] = uint32_t(vertex_offset);
                 vertex_offset++;
-                index_offset++;
             }
             shape_index_offset += fv;
         }
     }
-    this->material = materials[0];
-
-    // Set up OpenGL buffers and arrays
-    uint32_t prog = this->getProgram();
-    glGenBuffers(3, this->buffers);
-    glGenVertexArrays(1, &this->vao);
-    glBindVertexArray(this->vao);
-    glBindBuffer(GL_ARRAY_BUFFER, this->buffers[0]);
-    glBufferData(GL_ARRAY_BUFFER, objVertices.size() * sizeof(float), objVertices.data(), GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->buffers[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, objIndices.size() * sizeof(int), objIndices.data(), GL_STATIC_DRAW);
-    const int32_t PROG_POSITION = glGetAttribLocation(prog, "position");
-    const int32_t PROG_NORMAL = glGetAttribLocation(prog, "normal");
-    const int32_t PROG_TEX_COORDS = glGetAttribLocation(prog, "texCoords");
-    glEnableVertexAttribArray(PROG_POSITION);
-    glEnableVertexAttribArray(PROG_NORMAL);
-    glEnableVertexAttribArray(PROG_TEX_COORDS);
-    glVertexAttribPointer(PROG_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex3), (void*)offsetof(Vertex3, position));
-    glVertexAttribPointer(PROG_NORMAL, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex3), (void*)offsetof(Vertex3, normal));
-    glVertexAttribPointer(PROG_TEX_COORDS, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex3), (void*)offsetof(Vertex3, texCoords));
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-    // Load texture
-    int w, h;
-    uint8_t* data = stbi_load(textureFilePath.c_str(), &w, &h, nullptr, STBI_rgb_alpha);
-    if (!data) {
-        std::cerr << "Failed to load texture: " << textureFilePath << std::endl;
-        exit(1);
+    data.material = materials[0];
+    // The material comes from the .mtl files, the cache entry depends on them
+    data.dependencies.clear();
+    for (const std::string& path : reader.GetMaterialPaths()) {
+        bool listed = std::any_of(data.dependencies.begin(), data.dependencies.end(),
+            [&path](const MeshCacheDependency& dependency) { return dependency.path == path; });
+        if (!listed)
+            data.dependencies.push_back(GetMeshCacheDependency(path));
     }
-    glGenTextures(1, &this->texture);
-    glBindTexture(GL_TEXTURE_2D, this->texture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    stbi_image_free(data);
+    data.sourceVertexCount = uint32_t(verticesCount);
+
+    // Optimize for the post-transform cache and vertex fetch. The steps take
+    // their temporaries from one arena, each reusing the memory of the last
+    if (this->optimizeMesh) {
+        LinearArena scratch;
+        WeldVertices(mesh, &scratch);
+        data.statsBefore = AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+        std::vector<size_t> clusters;
+        OptimizeVertexCache(mesh.indices, mesh.vertices.size(), 16, &clusters, &scratch);
+        if (this->optimizeOverdraw)
+            OptimizeOverdraw(mesh.indices, mesh.vertices, clusters);
+        if (this->buildMeshlets)
+            BuildMeshlets(mesh, 64, &scratch);
+        OptimizeVertexFetch(mesh);
+        data.statsAfter = AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+        if (this->generateLods)
+            BuildLodChain(mesh, 8, 0.5f, &scratch);
+        log << "Import scratch: " << scratch.GetCapacity() / 1024 << " KB in " << scratch.GetBlockCount() << " blocks" << std::endl;
+    }
+    return true;
 }
 
-void Obj::render() {
-    auto time = static_cast<float>(glfwGetTime());
-    uint32_t prog = this->getProgram();
-    glUseProgram(prog);
-
-    const int32_t PROG_TIME = glGetUniformLocation(prog, "time");
-    const int32_t PROG_SAMPLER = glGetUniformLocation(prog, "sampler_");
-    const int32_t PROG_LIGHT_DIRECTION = glGetUniformLocation(prog, "light.direction");
-    const int32_t PROG_LIGHT_AMBIENT_COLOR = glGetUniformLocation(prog, "light.ambientColor");
-    const int32_t PROG_LIGHT_DIFFUSE_COLOR = glGetUniformLocation(prog, "light.diffuseColor");
-    const int32_t PROG_LIGHT_SPECULAR_COLOR = glGetUniformLocation(prog, "light.specularColor");
-    const int32_t PROG_MATERIAL_AMBIENT_COLOR = glGetUniformLocation(prog, "material.ambientColor");
-    const int32_t PROG_MATERIAL_DIFFUSE_COLOR = glGetUniformLocation(prog, "material.diffuseColor");
-    const int32_t PROG_MATERIAL_SPECULAR_COLOR = glGetUniformLocation(prog, "material.specularColor");
-    const int32_t PROG_SHININESS = glGetUniformLocation(prog, "shininess");
-
-    glUniform1f(PROG_TIME, time);
-    glUniform1i(PROG_SAMPLER, 0);
-    glUniform3f(PROG_LIGHT_DIRECTION, 1, -1, -1);
-    glUniform3f(PROG_LIGHT_AMBIENT_COLOR, 0.1, 0.1, 0.1);
-    glUniform3f(PROG_LIGHT_DIFFUSE_COLOR, 1, 1, 1);
-    glUniform3f(PROG_LIGHT_SPECULAR_COLOR, 0.5, 0.5, 0.5);
-    glUniform3f(PROG_MATERIAL_AMBIENT_COLOR, this->material.ambient[0], this->material.ambient[1], this->material.ambient[2]);
-    glUniform3f(PROG_MATERIAL_DIFFUSE_COLOR, this->material.diffuse[0], this->material.diffuse[1], this->material.diffuse[2]);
-    glUniform3f(PROG_MATERIAL_SPECULAR_COLOR, this->material.specular[0], this->material.specular[1], this->material.specular[2]);
-    glUniform1f(PROG_SHININESS, this->material.shininess);
-
+mat4 Obj::getTransform() const {
     mat4 scaleMatrix = {
         this->scale.x, 0, 0, 0,
         0, this->scale.y, 0, 0,
@@ -321,168 +659,1007 @@ void Obj::render() {
         this->translation.x, this->translation.y, this->translation.z, 1,
     };
 
-    const int32_t PROG_VIEW = glGetUniformLocation(prog, "view");
-    glUniform3f(PROG_VIEW, this->app.cameraPosition.x, this->app.cameraPosition.y, this->app.cameraPosition.z);
+    return translationMatrix * rotationMatrix * scaleMatrix;
+}
+
+// Adds a coarse LOD to the occluders of the occlusion buffer and returns through
+// app.occluderError how far its surface may be from the real one
+void Obj::renderOccluder(OcclusionBuffer& occlusionBuffer) {
+    // Not drawn yet, so it must not hide anything either
+    if (this->mesh.vertices.empty() || !this->uploaded)
+        return;
+    mat4 transform = this->getTransform();
+    size_t level = this->selectLod(transform, this->app.occluderPixelError, float(occlusionBuffer.GetHeight()));
+    const MeshLod& lod = this->lods[level];
+    occlusionBuffer.AddOccluder(&this->mesh.vertices[0].position, sizeof(Vertex3), &this->mesh.indices[lod.indexOffset],
+        lod.indexCount, this->app.projection * this->app.camera * transform);
+    float scale = glm::max(this->scale.x, glm::max(this->scale.y, this->scale.z));
+    this->app.occluderError = glm::max(this->app.occluderError, lod.error * scale);
+}
 
-    mat4 transform = translationMatrix * rotationMatrix * scaleMatrix;
+// Fills the object's data and appends its draw commands to `recorder`; only
+// writes the object's ObjectData, so objects are recorded in parallel
+void Obj::render(uint32_t objectIndex, DrawRecorder& recorder) const {
+    if (!this->uploaded)
+        return;
+    mat4 transform = this->getTransform();
     mat4 transformNormal = glm::transpose(glm::inverse(transform));
     mat4 transformWithProjection = this->app.projection * this->app.camera * transform;
 
-    const int32_t PROG_TRANSFORM_NORMAL = glGetUniformLocation(prog, "transformNormal");
-    glUniformMatrix4fv(PROG_TRANSFORM_NORMAL, 1, GL_FALSE, glm::value_ptr(transformNormal));
-    const int32_t PROG_TRANSFORM_WITH_PROJECTION = glGetUniformLocation(prog, "transformWithProjection");
-    glUniformMatrix4fv(PROG_TRANSFORM_WITH_PROJECTION, 1, GL_FALSE, glm::value_ptr(transformWithProjection));
+    ObjectData data;
+    data.transformNormal = transformNormal;
+    data.transformWithProjection = transformWithProjection;
+    data.positionOffset = vec4(this->positionOffset, 0);
+    data.positionScale = vec4(this->positionScale, 0);
+    data.ambientColor = vec4(this->material.ambient[0], this->material.ambient[1], this->material.ambient[2], 0);
+    data.diffuseColor = vec4(this->material.diffuse[0], this->material.diffuse[1], this->material.diffuse[2], 0);
+    data.specularColor = vec4(this->material.specular[0], this->material.specular[1], this->material.specular[2], this->material.shininess);
+    // Written once, the ring is write-combined memory
+    static_cast<ObjectData*>(this->app.objectData.data)[objectIndex] = data;
+
+    // Skip the object if it is hidden behind the occluders; the margin, in
+    // object space, covers the error of the simplified occluders
+    const OcclusionBuffer* occlusion = this->app.occlusionCulling ? &this->app.occlusionBuffer : nullptr;
+    float minScale = glm::min(this->scale.x, glm::min(this->scale.y, this->scale.z));
+    float margin = this->app.occluderError / minScale;
+    if (occlusion && !occlusion->IsVisible(this->boundsMin - vec3(margin), this->boundsMax + vec3(margin), transformWithProjection)) {
+        recorder.occludedObjects++;
+        recorder.occludedTriangles += this->lods[0].indexCount / 3;
+        return;
+    }
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, this->texture);
-    glBindVertexArray(this->vao);
-    glDrawElements(GL_TRIANGLES, this->numOfIndices, GL_UNSIGNED_INT, nullptr);
-    glBindVertexArray(0);
+    // Append the draw commands to the batch, relative to the mesh pool
+    std::vector<DrawElementsIndirectCommand>& commands = recorder.commands[this->batch];
+    size_t firstCommand = commands.size();
+    size_t level = this->selectLod(transform, this->lodPixelError, float(this->app.height));
+    if (level == 0 && !this->mesh.meshlets.empty()) {
+        // Only the meshlets in the frustum, facing the camera and not occluded are drawn
+        vec3 eye = vec3(glm::inverse(transform) * vec4(this->app.cameraPosition, 1));
+        size_t occluded = 0;
+        CullMeshlets(this->mesh.meshlets, transformWithProjection, eye, commands, occlusion, margin, &occluded);
+        recorder.occludedMeshlets += occluded;
+    } else {
+        const MeshLod& lod = this->lods[level];
+        commands.push_back({ lod.indexCount, 1, lod.indexOffset, 0, 0 });
+    }
+    for (size_t i = firstCommand; i < commands.size(); i++) {
+        commands[i].firstIndex += this->meshRange.firstIndex;
+        commands[i].baseVertex = this->meshRange.baseVertex;
+        recorder.drawObjects[this->batch].push_back(objectIndex);
+    }
 }
 
-void Obj::destroy() {
-    glDeleteBuffers(2, this->buffers);
-    glDeleteVertexArrays(1, &this->vao);
-    glDeleteTextures(1, &this->texture);
-    this->shader.Destroy();
+size_t Obj::selectLod(const mat4& transform, float pixelError, float screenHeight) const {
+    // Projected size of one world unit at the nearest point of the bounding sphere
+    float scale = glm::max(this->scale.x, glm::max(this->scale.y, this->scale.z));
+    vec3 center = vec3(transform * vec4(this->boundsCenter, 1));
+    float distance = glm::length(center - this->app.cameraPosition) - this->boundsRadius * scale;
+    if (distance <= 0)
+        return 0;
+    float pixelsPerUnit = this->app.projection[1][1] * 0.5f * screenHeight / distance;
+
+    // Coarsest level whose error stays under the threshold
+    size_t level = this->lods.size() - 1;
+    while (level > 0 && this->lods[level].error * scale * pixelsPerUnit > pixelError)
+        level--;
+    return level;
 }
 
 // Implementation of Application methods
 bool Application::initialize(GLFWwindow* window) {
     this->window = window;
-    glEnable(GL_SCISSOR_TEST);
-    glEnable(GL_CULL_FACE);
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_FRAMEBUFFER_SRGB);
-    std::cout << "Graphic card: " << glGetString(GL_RENDERER) << std::endl;
-    std::cout << "OpenGL: " << glGetString(GL_VERSION) << std::endl;
-    std::cout << "GLEW: " << glewGetString(GLEW_VERSION) << std::endl;
-    std::cout << "GLSL: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << std::endl;
-    std::cout << "Extensions: " << glGetString(GL_EXTENSIONS) << std::endl;
-
-    this->basicShader.LoadVertexShader("C:\\Users\\Safi\\Desktop\\computer-grphics-ESIEE\\OpenGL-OBJ-Renderer\\Projet\\shaders\\basic.vs.glsl");
-    this->basicShader.LoadFragmentShader("C:\\Users\\Safi\\Desktop\\computer-grphics-ESIEE\\OpenGL-OBJ-Renderer\\Projet\\shaders\\basic.fs.glsl");
-    this->basicShader.Create();
-    uint32_t basic = this->getBasicProgram();
-
-    // Initialize objects
+    if (!this->backend.Create())
+        return false;
+    // Uploads run on their own context, the objects appear as they finish;
+    // without it they are done right away
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    this->uploadContext = glfwCreateWindow(1, 1, "Uploads", nullptr, window);
+    glfwDefaultWindowHints();
+    if (this->uploadContext) {
+        GLFWwindow* uploadContext = this->uploadContext;
+        this->backend.StartUploadThread([uploadContext]() { glfwMakeContextCurrent(uploadContext); },
+            []() { glfwMakeContextCurrent(nullptr); });
+    } else {
+        std::cerr << "Failed to create the upload context, uploading on the render thread" << std::endl;
+    }
+    if (!this->fileWatcher.Start())
+        std::cerr << "Failed to start the file watcher, hot reload disabled" << std::endl;
+    this->jobs.Start();
+    std::cout << "Job system: " << this->jobs.GetThreadCount() << " threads" << std::endl;
+    this->occlusionBuffer.SetJobSystem(&this->jobs);
+    this->softwareRenderer.SetJobSystem(&this->jobs);
+    this->pathTracer.SetJobSystem(&this->jobs);
+
+    // Paused screen pipeline, the basic shaders have no layout qualifiers
+    PipelineDesc paused;
+    paused.vertexShader = "C:\\Users\\Safi\\Desktop\\computer-grphics-ESIEE\\OpenGL-OBJ-Renderer\\Projet\\shaders\\basic.vs.glsl";
+    paused.fragmentShader = "C:\\Users\\Safi\\Desktop\\computer-grphics-ESIEE\\OpenGL-OBJ-Renderer\\Projet\\shaders\\basic.fs.glsl";
+    paused.attributes = {
+        { "position", 0, 2, ATTRIBUTE_FLOAT, false, offsetof(Vertex2, position) },
+        { "color", 0, 3, ATTRIBUTE_FLOAT, false, offsetof(Vertex2, color) },
+        { "texCoords", 0, 2, ATTRIBUTE_FLOAT, false, offsetof(Vertex2, texCoords) },
+    };
+    paused.vertexStride = sizeof(Vertex2);
+    paused.blend = true;
+    this->pausedPipeline = this->backend.CreatePipeline(paused);
+    this->watchShaders(this->pausedPipeline);
+
+    // Mesh pools and the per-frame draw data
+    this->meshPools[0].Create(this->backend, sizeof(Vertex3));
+    this->meshPools[1].Create(this->backend, sizeof(PackedVertex3));
+    this->frameRing.Create(this->backend, 256 * 1024);
+
+    // Drawn on the objects until their texture is uploaded
+    const uint8_t white[4] = { 255, 255, 255, 255 };
+    TextureDesc placeholder;
+    placeholder.width = placeholder.height = 1;
+    placeholder.mipmaps = false;
+    placeholder.data = white;
+    this->placeholderTexture = this->backend.CreateTexture(placeholder);
+
+    // Initialize objects, loaded in the background from here on
+    this->createObjects();
+    this->loadObjects();
+    this->buildSceneTlas();
+
+    // Set up paused screen
+    const Vertex2 pausedVertex[] = {
+        { { -0.265f, +0.8f }, { 1, 1, 1 }, { 0, 1 } },
+        { { -0.265f, +0.7f }, { 1, 1, 1 }, { 0, 0 } },
+        { { +0.265f, +0.7f }, { 1, 1, 1 }, { 1, 0 } },
+        { { +0.265f, +0.8f }, { 1, 1, 1 }, { 1, 1 } },
+    };
+    const unsigned int pausedIndices[] = { 0, 1, 2, 0, 2, 3 };
+
+    this->pausedBuffers[0] = this->backend.CreateBuffer(sizeof(pausedVertex), pausedVertex);
+    this->pausedBuffers[1] = this->backend.CreateBuffer(sizeof(pausedIndices), pausedIndices);
+
+    // Load paused screen texture
+    TextureDesc pausedTexture;
+    pausedTexture.data = stbi_load("C:\\Users\\Safi\\Desktop\\computer-grphics-ESIEE\\OpenGL-OBJ-Renderer\\Projet\\paused.png",
+        &pausedTexture.width, &pausedTexture.height, nullptr, STBI_rgb_alpha);
+    if (!pausedTexture.data) return false;
+    this->pausedTexture = this->backend.CreateTexture(pausedTexture);
+    stbi_image_free((void*)pausedTexture.data);
+
+    this->handCursor = glfwCreateStandardCursor(GLFW_HAND_CURSOR);
+
+    // Set GLFW callbacks
+    glfwSetKeyCallback(this->window, [](GLFWwindow* window, int key, int scancode, int action, int mods) {
+        if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
+            auto app = static_cast<Application*>(glfwGetWindowUserPointer(window));
+            app->canMove = !app->canMove;
+        }
+        if (key == GLFW_KEY_B && action == GLFW_PRESS) {
+            auto app = static_cast<Application*>(glfwGetWindowUserPointer(window));
+            app->benchmarkPicking();
+        }
+        if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+            auto app = static_cast<Application*>(glfwGetWindowUserPointer(window));
+            app->renderPathTraced();
+        }
+        if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+            auto app = static_cast<Application*>(glfwGetWindowUserPointer(window));
+            app->renderSoftware();
+        }
+        });
+    glfwSetMouseButtonCallback(this->window, [](GLFWwindow* window, int button, int action, int mods) {
+        if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
+            auto app = static_cast<Application*>(glfwGetWindowUserPointer(window));
+            app->canMove = true;
+        }
+        if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS) {
+            auto app = static_cast<Application*>(glfwGetWindowUserPointer(window));
+            app->pick();
+        }
+        });
+    glfwSetScrollCallback(this->window, [](GLFWwindow* window, double xoffset, double yoffset) {
+        auto app = static_cast<Application*>(glfwGetWindowUserPointer(window));
+        if (app->canMove)
+            app->cameraR = glm::clamp(app->cameraR - static_cast<float>(yoffset) * 0.5f, 1.f, 500.f);
+        });
+    glfwGetCursorPos(this->window, &this->lastMouseX, &this->lastMouseY);
+    this->canMove = true;
+
+    return true;
+}
+
+// Adds the scene's objects and requests their pipelines and textures; their
+// meshes are loaded afterwards
+void Application::createObjects() {
     Obj table(*this);
+    table.quantizeVertices = true;
     table.initialize("3d.vs.glsl", "3d.fs.glsl", "Meshes\\dinertable.obj", "Textures\\table.png");
     table.translation = { 0, 0, 0 };
     table.scale = { 1, 1, 1 };
     this->objects.push_back(table);
 
     Obj bottle(*this, "botle");
+    bottle.quantizeVertices = true;
     bottle.initialize("3d.vs.glsl", "3d.fs.glsl", "Meshes/Botle.obj", "Textures/Bottle.png");
     bottle.translation = { -20, 50, 10 };
     bottle.scale = { 1, 1, 1 };
     this->objects.push_back(bottle);
 
     Obj nolegs(*this);
+    nolegs.quantizeVertices = true;
     nolegs.initialize("3d.vs.glsl", "3d.fs.glsl", "Meshes/nolegs.obj", "Textures/nolegs.png");
     nolegs.translation = { 10, 115, 10 };
     nolegs.scale = { 3, 3, 3 };
     this->objects.push_back(nolegs);
 
     Obj pirate(*this);
-    pirate.initialize("3d.vs.glsl", "3d_blink.fs.glsl", "Meshes/Stylized_pirate_scene.obj", "Textures/Barrel_BaseColor_2K.png");
+    pirate.quantizeVertices = true;
+    pirate.shaderDefines = { "BLINK" };
+    pirate.initialize("3d.vs.glsl", "3d.fs.glsl", "Meshes/Stylized_pirate_scene.obj", "Textures/Barrel_BaseColor_2K.png");
     pirate.translation = { -110, -10, -20 };
     pirate.scale = { 1.5, 1.5, 1.5 };
     this->objects.push_back(pirate);
 
     Obj mrbean(*this, "mrbean");
+    mrbean.quantizeVertices = true;
     mrbean.initialize("3d.vs.glsl", "3d.fs.glsl", "Meshes/Mr_Bean_Pirate.obj", "Textures/Tex_0013_0.png");
     mrbean.translation = { 0, 0, -50 };
     mrbean.scale = { 80, 80, 80 };
     this->objects.push_back(mrbean);
 
     Obj map(*this, "map");
+    map.quantizeVertices = true;
     map.initialize("3d.vs.glsl", "3d.fs.glsl", "Meshes/Wooden.obj", "Textures/WoodenTexture.png");
     map.translation = { 40, 56, 10 };
     map.scale = { 3, 3, 3 };
     map.angle = 90;
     this->objects.push_back(map);
+}
 
-    // Set up paused screen
-    const Vertex2 pausedVertex[] = {
-        { { -0.265f, +0.8f }, { 1, 1, 1 }, { 0, 1 } },
-        { { -0.265f, +0.7f }, { 1, 1, 1 }, { 0, 0 } },
-        { { +0.265f, +0.7f }, { 1, 1, 1 }, { 1, 0 } },
-        { { +0.265f, +0.8f }, { 1, 1, 1 }, { 1, 1 } },
-    };
-    const unsigned int pausedIndices[] = { 0, 1, 2, 0, 2, 3 };
+// Renders the default view without a window or a GL context: the objects are
+// loaded with Obj::load() on the job system, then drawn by the software
+// rasterizer through RenderDevice, see renderSoftware(), and path traced if
+// `pathTraced`, see renderPathTraced(). Returns the exit code
+int Application::runHeadless(bool pathTraced) {
+    this->headless = true;
+    this->jobs.Start();
+    std::cout << "Job system: " << this->jobs.GetThreadCount() << " threads" << std::endl;
+    this->occlusionBuffer.SetJobSystem(&this->jobs);
+    this->softwareRenderer.SetJobSystem(&this->jobs);
+    this->pathTracer.SetJobSystem(&this->jobs);
+    this->createObjects();
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::string> messages(this->objects.size());
+    std::atomic<bool> failed(false);
+    JobCounter loading;
+    for (size_t i = 0; i < this->objects.size(); i++) {
+        this->jobs.Run([this, i, &messages, &failed]() {
+            std::ostringstream log;
+            if (!this->objects[i].load(log))
+                failed = true;
+            messages[i] = log.str();
+        }, &loading);
+    }
+    this->jobs.Wait(loading);
+    for (const std::string& message : messages)
+        std::cout << message;
+    if (failed) {
+        std::cerr << "Failed to load the objects" << std::endl;
+        return -1;
+    }
+    this->fullyLoaded = true;
+    std::cout << "Time to fully loaded: " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000
+        << " ms" << std::endl;
+
+    this->updateCamera();
+    this->renderSoftware();
+    if (pathTraced)
+        this->renderPathTraced();
+    this->jobs.Stop();
+    return 0;
+}
 
-    glGenBuffers(2, this->pausedBuffers);
-    glGenVertexArrays(1, &this->pausedVao);
-    glBindVertexArray(this->pausedVao);
-    glBindBuffer(GL_ARRAY_BUFFER, this->pausedBuffers[0]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex2) * 4, pausedVertex, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->pausedBuffers[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * 6, pausedIndices, GL_STATIC_DRAW);
-    const int32_t BASIC_POSITION = glGetAttribLocation(basic, "position");
-    const int32_t BASIC_COLOR = glGetAttribLocation(basic, "color");
-    const int32_t BASIC_TEX_COORDS = glGetAttribLocation(basic, "texCoords");
-    glEnableVertexAttribArray(BASIC_POSITION);
-    glEnableVertexAttribArray(BASIC_COLOR);
-    glEnableVertexAttribArray(BASIC_TEX_COORDS);
-    glVertexAttribPointer(BASIC_POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex2), (void*)offsetof(Vertex2, position));
-    glVertexAttribPointer(BASIC_COLOR, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex2), (void*)offsetof(Vertex2, color));
-    glVertexAttribPointer(BASIC_TEX_COORDS, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex2), (void*)offsetof(Vertex2, texCoords));
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+// One pipeline per shader files and permutation; the quantized vertex format
+// adds the QUANTIZED define
+uint32_t Application::getPipeline(const char* shaderFileV, const char* shaderFileF, const std::vector<std::string>& defines, bool quantized) {
+    if (this->headless)
+        return RENDER_NONE;
+    std::vector<std::string> permutation = defines;
+    if (quantized)
+        permutation.push_back("QUANTIZED");
+    std::sort(permutation.begin(), permutation.end());
+    std::string key = std::string(shaderFileV) + "|" + shaderFileF;
+    for (const std::string& define : permutation)
+        key += "|" + define;
+    auto found = this->pipelines.find(key);
+    if (found != this->pipelines.end())
+        return found->second;
+
+    PipelineDesc desc;
+    desc.vertexShader = std::string("C:\\Users\\Safi\\Desktop\\computer-grphics-ESIEE\\OpenGL-OBJ-Renderer\\Projet\\shaders\\") + shaderFileV;
+    desc.fragmentShader = std::string("C:\\Users\\Safi\\Desktop\\computer-grphics-ESIEE\\OpenGL-OBJ-Renderer\\Projet\\shaders\\") + shaderFileF;
+    desc.defines = permutation;
+    std::cout << "Trying to open vertex shader file: " << desc.vertexShader << std::endl;
+    std::cout << "Trying to open fragment shader file: " << desc.fragmentShader << std::endl;
+    // The attribute locations match the layout qualifiers of the 3d shaders
+    if (quantized) {
+        desc.attributes = {
+            { nullptr, 0, 3, ATTRIBUTE_UNSIGNED_SHORT, true, offsetof(PackedVertex3, position) },
+            { nullptr, 1, 2, ATTRIBUTE_SHORT, true, offsetof(PackedVertex3, normal) },
+            { nullptr, 2, 2, ATTRIBUTE_HALF_FLOAT, false, offsetof(PackedVertex3, texCoords) },
+        };
+        desc.vertexStride = sizeof(PackedVertex3);
+    } else {
+        desc.attributes = {
+            { nullptr, 0, 3, ATTRIBUTE_FLOAT, false, offsetof(Vertex3, position) },
+            { nullptr, 1, 3, ATTRIBUTE_FLOAT, false, offsetof(Vertex3, normal) },
+            { nullptr, 2, 2, ATTRIBUTE_FLOAT, false, offsetof(Vertex3, texCoords) },
+        };
+        desc.vertexStride = sizeof(Vertex3);
+    }
+    uint32_t pipeline = this->backend.CreatePipeline(desc);
+    this->pipelines[key] = pipeline;
+    this->watchShaders(pipeline);
+    return pipeline;
+}
 
-    // Load paused screen texture
+// Decodes the texture in a job and uploads it, once per file; the objects
+// keep the placeholder if it fails to load. Headless, the CPU renderers load
+// the textures themselves
+void Application::requestTexture(const std::string& textureFile) {
+    if (this->headless || this->textures.count(textureFile))
+        return;
+    this->textures[textureFile] = TextureAsset();
+
+    std::string textureFilePath = std::string("C:\\Users\\Safi\\Desktop\\computer-grphics-ESIEE\\OpenGL-OBJ-Renderer\\Projet\\Obj\\") + textureFile;
+    this->watchFile(textureFilePath, [this, textureFile]() { this->reloadTexture(textureFile); });
+    this->jobs.RunBackground([this, textureFile, textureFilePath]() {
+        TextureDesc desc;
+        std::shared_ptr<const void> data(stbi_load(textureFilePath.c_str(), &desc.width, &desc.height, nullptr, STBI_rgb_alpha),
+            stbi_image_free);
+        this->finishOnRenderThread([this, textureFile, textureFilePath, desc, data]() {
+            TextureAsset& asset = this->textures[textureFile];
+            if (!data) {
+                std::cerr << "Failed to load texture: " << textureFilePath << std::endl;
+                asset.failed = true;
+                return;
+            }
+            asset.texture = this->backend.CreateTextureAsync(desc, data, &asset.upload);
+        });
+    });
+}
+
+// Loads the objects' meshes as background jobs; the window is drawn in the
+// meantime, each object appearing once its mesh is uploaded
+void Application::loadObjects() {
+    for (size_t i = 0; i < this->objects.size(); i++) {
+        Obj* loading = &this->objects[i];
+        this->watchFile(loading->getObjFilePath(), [this, i]() { this->reloadMesh(i); });
+        this->jobs.RunBackground([this, i, loading]() {
+            std::ostringstream log;
+            bool loaded = loading->load(log);
+            std::string messages = log.str();
+            this->finishOnRenderThread([this, i, loading, loaded, messages]() {
+                std::cout << messages;
+                if (!loaded)
+                    exit(1);
+                for (const std::string& path : loading->materialFiles)
+                    this->watchFile(path, [this, i]() { this->reloadMesh(i); });
+                loading->upload();
+            });
+        });
+    }
+}
+
+// Queues work of a loading job that must run on the render thread, see
+// updateLoading()
+void Application::finishOnRenderThread(std::function<void()> completion) {
+    std::lock_guard<std::mutex> lock(this->loadMutex);
+    this->loadCompletions.push_back(std::move(completion));
+}
+
+// Runs what the loading jobs left for the render thread, then draws the
+// objects whose uploads are done; never waits for a job or an upload
+void Application::updateLoading() {
+    std::vector<std::function<void()>> completions;
+    {
+        std::lock_guard<std::mutex> lock(this->loadMutex);
+        completions.swap(this->loadCompletions);
+    }
+    for (std::function<void()>& completion : completions)
+        completion();
+    this->backend.UpdateUploads();
+    if (this->fullyLoaded)
+        return;
+
+    bool fullyLoaded = true;
+    bool appeared = false;
+    for (Obj& object : this->objects) {
+        MeshPool* pool = &this->meshPools[object.quantizeVertices ? 1 : 0];
+        if (object.loaded && !object.uploaded) {
+            object.uploaded = std::all_of(object.uploads.begin(), object.uploads.end(),
+                [this](uint32_t upload) { return this->backend.IsUploadDone(upload); });
+            if (object.uploaded) {
+                object.texture = this->placeholderTexture;
+                object.batch = this->getBatch(object.pipeline, object.texture, pool);
+                appeared = true;
+            }
+        }
+        if (object.uploaded && !object.textureUploaded) {
+            const TextureAsset& asset = this->textures[object.textureFile];
+            if (asset.failed || (asset.texture != RENDER_NONE && this->backend.IsUploadDone(asset.upload))) {
+                object.textureUploaded = true;
+                if (!asset.failed) {
+                    object.texture = asset.texture;
+                    object.batch = this->getBatch(object.pipeline, object.texture, pool);
+                }
+            }
+        }
+        fullyLoaded = fullyLoaded && object.textureUploaded;
+    }
+    if (appeared)
+        this->buildSceneTlas();
+    if (fullyLoaded) {
+        std::cout << "Time to fully loaded: " << glfwGetTime() * 1000 << " ms" << std::endl;
+        this->fullyLoaded = true;
+    }
+}
+
+// Calls `reload` on the render thread whenever `path` changes on disk
+void Application::watchFile(const std::string& path, std::function<void()> reload) {
+    this->fileWatcher.Watch(path);
+    this->fileReloads[path].push_back(std::move(reload));
+}
+
+// Watches the files a pipeline's shaders were built from; each file gets a
+// single reload action, whatever the number of permutations built from it
+void Application::watchShaders(uint32_t pipeline) {
+    if (pipeline == RENDER_NONE)
+        return;
+    for (const std::string& file : this->backend.GetPipelineFiles(pipeline))
+        if (!this->fileReloads.count(file))
+            this->watchFile(file, [this, file]() { this->reloadShader(file); });
+}
+
+// Recompiles the permutations built from a changed shader file, drawn with
+// once built; a shader that does not compile keeps the current ones
+void Application::reloadShader(const std::string& path) {
+    size_t rebuilt = this->backend.ReloadShaderFile(path);
+    std::cout << "Reloaded " << path << ": rebuilding " << rebuilt << " pipelines" << std::endl;
+    // The changed file may include new ones
+    this->watchShaders(this->pausedPipeline);
+    for (const auto& pipeline : this->pipelines)
+        this->watchShaders(pipeline.second);
+}
+
+// Decodes the changed texture again and uploads it next to the current one,
+// see updateHotReload()
+void Application::reloadTexture(const std::string& textureFile) {
+    const TextureAsset& asset = this->textures[textureFile];
+    if (asset.texture == RENDER_NONE && !asset.failed) {
+        std::cout << "Still loading, reload skipped: " << textureFile << std::endl;
+        return;
+    }
+    std::string textureFilePath = std::string("C:\\Users\\Safi\\Desktop\\computer-grphics-ESIEE\\OpenGL-OBJ-Renderer\\Projet\\Obj\\") + textureFile;
+    this->jobs.RunBackground([this, textureFile, textureFilePath]() {
+        TextureDesc desc;
+        std::shared_ptr<const void> data(stbi_load(textureFilePath.c_str(), &desc.width, &desc.height, nullptr, STBI_rgb_alpha),
+            stbi_image_free);
+        this->finishOnRenderThread([this, textureFile, textureFilePath, desc, data]() {
+            if (!data) {
+                std::cerr << "Failed to reload texture, keeping the current one: " << textureFilePath << std::endl;
+                return;
+            }
+            // A newer version replaces one still uploading
+            TextureAsset& asset = this->textures[textureFile];
+            this->backend.DestroyTexture(asset.reloaded);
+            asset.reloaded = this->backend.CreateTextureAsync(desc, data, &asset.reloadedUpload);
+        });
+    });
+}
+
+// Loads the changed mesh of an object again into a copy of its settings,
+// swapped in by updateHotReload()
+void Application::reloadMesh(size_t index) {
+    const Obj& object = this->objects[index];
+    if (!object.uploaded) {
+        std::cout << "Still loading, reload skipped: " << object.objFile << std::endl;
+        return;
+    }
+    auto reloaded = std::make_shared<Obj>(*this, object.name);
+    reloaded->objFile = object.objFile;
+    reloaded->optimizeMesh = object.optimizeMesh;
+    reloaded->optimizeOverdraw = object.optimizeOverdraw;
+    reloaded->generateLods = object.generateLods;
+    reloaded->buildMeshlets = object.buildMeshlets;
+    reloaded->quantizeVertices = object.quantizeVertices;
+    this->jobs.RunBackground([this, index, reloaded]() {
+        std::ostringstream log;
+        bool loaded = reloaded->load(log);
+        std::string messages = log.str();
+        this->finishOnRenderThread([this, index, reloaded, loaded, messages]() {
+            std::cout << messages;
+            if (!loaded) {
+                std::cerr << "Failed to reload mesh, keeping the current one: " << reloaded->objFile << std::endl;
+                return;
+            }
+            reloaded->upload();
+            this->meshReloads.push_back({ index, reloaded });
+        });
+    });
+}
+
+// Starts reloading what changed on disk, then swaps in the new meshes and
+// textures that are uploaded; everything switches between two frames
+void Application::updateHotReload() {
+    for (const std::string& path : this->fileWatcher.TakeChanged()) {
+        std::cout << "Changed on disk: " << path << std::endl;
+        for (std::function<void()>& reload : this->fileReloads[path])
+            reload();
+    }
+
+    bool swapped = false;
+    for (auto& entry : this->textures) {
+        TextureAsset& asset = entry.second;
+        if (asset.reloaded == RENDER_NONE || !this->backend.IsUploadDone(asset.reloadedUpload))
+            continue;
+        uint32_t previous = asset.texture;
+        asset.texture = asset.reloaded;
+        asset.upload = asset.reloadedUpload;
+        asset.failed = false;
+        asset.reloaded = RENDER_NONE;
+        for (Obj& object : this->objects) {
+            if (object.textureUploaded && object.textureFile == entry.first) {
+                object.texture = asset.texture;
+                object.batch = this->getBatch(object.pipeline, object.texture, &this->meshPools[object.quantizeVertices ? 1 : 0]);
+            }
+        }
+        this->backend.DestroyTexture(previous);
+        this->cpuTextures.erase(entry.first);
+        std::cout << "Reloaded texture: " << entry.first << std::endl;
+        swapped = true;
+    }
+
+    bool meshSwapped = false;
+    for (size_t i = 0; i < this->meshReloads.size();) {
+        Obj& reloaded = *this->meshReloads[i].second;
+        if (!std::all_of(reloaded.uploads.begin(), reloaded.uploads.end(),
+                [this](uint32_t upload) { return this->backend.IsUploadDone(upload); })) {
+            i++;
+            continue;
+        }
+        this->objects[this->meshReloads[i].first].takeMesh(reloaded);
+        std::cout << "Reloaded mesh: " << reloaded.objFile << std::endl;
+        this->meshReloads.erase(this->meshReloads.begin() + i);
+        meshSwapped = true;
+    }
+    if (meshSwapped)
+        this->buildSceneTlas();
+
+    // The software renderer's copies are out of date, see renderSoftware()
+    if (swapped || meshSwapped) {
+        this->softwareRenderer.DestroyResources();
+        this->deviceMeshes.clear();
+        this->deviceTextures.clear();
+    }
+}
+
+// Same file as requestTexture() uploads, decoded once and kept in memory for
+// the path tracer
+const CpuTexture* Application::getCpuTexture(const std::string& textureFile) {
+    auto found = this->cpuTextures.find(textureFile);
+    if (found != this->cpuTextures.end())
+        return &found->second;
+
+    std::string textureFilePath = std::string("C:\\Users\\Safi\\Desktop\\computer-grphics-ESIEE\\OpenGL-OBJ-Renderer\\Projet\\Obj\\") + textureFile;
     int w, h;
-    uint8_t* data = stbi_load("C:\\Users\\Safi\\Desktop\\computer-grphics-ESIEE\\OpenGL-OBJ-Renderer\\Projet\\paused.png", &w, &h, nullptr, STBI_rgb_alpha);
-    if (!data) return false;
-    glGenTextures(1, &this->pausedTexture);
-    glBindTexture(GL_TEXTURE_2D, this->pausedTexture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
+    uint8_t* data = stbi_load(textureFilePath.c_str(), &w, &h, nullptr, STBI_rgb_alpha);
+    if (!data) {
+        std::cerr << "Failed to load texture: " << textureFilePath << std::endl;
+        return nullptr;
+    }
+    CpuTexture& texture = this->cpuTextures[textureFile];
+    texture.Create(w, h, data);
     stbi_image_free(data);
+    return &texture;
+}
 
-    this->handCursor = glfwCreateStandardCursor(GLFW_HAND_CURSOR);
+size_t Application::getBatch(uint32_t pipeline, uint32_t texture, MeshPool* pool) {
+    for (size_t i = 0; i < this->batches.size(); i++)
+        if (this->batches[i].pipeline == pipeline && this->batches[i].texture == texture && this->batches[i].pool == pool)
+            return i;
+    RenderBatch batch;
+    batch.pipeline = pipeline;
+    batch.texture = texture;
+    batch.pool = pool;
+    this->batches.push_back(batch);
+    return this->batches.size() - 1;
+}
 
-    // Set GLFW callbacks
-    glfwSetKeyCallback(this->window, [](GLFWwindow* window, int key, int scancode, int action, int mods) {
-        if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
-            auto app = static_cast<Application*>(glfwGetWindowUserPointer(window));
-            app->canMove = !app->canMove;
+void Application::buildSceneTlas() {
+    this->sceneInstances.clear();
+    for (const Obj& object : this->objects) {
+        // Objects still loading are not picked
+        TlasInstance instance;
+        instance.blas = object.uploaded ? &object.blas : nullptr;
+        instance.transform = object.getTransform();
+        this->sceneInstances.push_back(instance);
+    }
+    this->sceneTlas.Build(this->sceneInstances);
+    std::cout << "Scene TLAS: " << this->sceneTlas.GetInstanceCount() << " instances, " << this->sceneTlas.GetNodeCount()
+        << " nodes, built in " << this->sceneTlas.GetBuildSeconds() * 1e6 << " us" << std::endl;
+}
+
+// Rebuilds the top level tree if an object moved since the last frame; the
+// objects' own trees never change
+void Application::updateSceneTlas() {
+    bool moved = false;
+    for (size_t i = 0; i < this->objects.size(); i++) {
+        mat4 transform = this->objects[i].getTransform();
+        if (transform != this->sceneInstances[i].transform) {
+            this->sceneInstances[i].transform = transform;
+            moved = true;
         }
-        });
-    glfwSetMouseButtonCallback(this->window, [](GLFWwindow* window, int button, int action, int mods) {
-        if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
-            auto app = static_cast<Application*>(glfwGetWindowUserPointer(window));
-            app->canMove = true;
+    }
+    if (moved)
+        this->sceneTlas.Build(this->sceneInstances);
+}
+
+// Casts a ray from the camera through the window position (x, y)
+bool Application::castCursorRay(const mat4& inverseViewProjection, double x, double y, TlasHit& hit) const {
+    vec2 ndc = { float(2 * x / this->width - 1), float(1 - 2 * y / this->height) };
+    vec4 farPoint = inverseViewProjection * vec4(ndc, 1, 1);
+    vec3 direction = glm::normalize(vec3(farPoint) / farPoint.w - this->cameraPosition);
+    return this->sceneTlas.Intersect(this->cameraPosition, direction, hit);
+}
+
+void Application::pick() {
+    double x, y;
+    glfwGetCursorPos(this->window, &x, &y);
+    TlasHit hit;
+    if (!this->castCursorRay(glm::inverse(this->projection * this->camera), x, y, hit)) {
+        std::cout << "Picked: nothing" << std::endl;
+        return;
+    }
+    const Obj& object = this->objects[hit.instance];
+    std::cout << "Picked: object " << hit.instance << (object.name.empty() ? "" : " (" + object.name + ")")
+        << ", triangle " << hit.hit.ref.triangle << ", distance " << hit.hit.distance << std::endl;
+}
+
+// Casts one ray per 4x4 pixels of the current view and reports the throughput
+void Application::benchmarkPicking() {
+    mat4 inverse = glm::inverse(this->projection * this->camera);
+    size_t rays = 0, hits = 0;
+    double start = glfwGetTime();
+    for (int y = 0; y < this->height; y += 4) {
+        for (int x = 0; x < this->width; x += 4) {
+            TlasHit hit;
+            hits += this->castCursorRay(inverse, x + 0.5, y + 0.5, hit) ? 1 : 0;
+            rays++;
         }
+    }
+    double seconds = glfwGetTime() - start;
+    this->sceneTlas.Build(this->sceneInstances);
+    std::cout << "BVH picking: " << rays << " rays (" << hits << " hits) in " << seconds * 1000 << " ms, "
+        << double(rays) / seconds / 1e6 << " Mrays/s, TLAS rebuild " << this->sceneTlas.GetBuildSeconds() * 1e6
+        << " us for " << this->sceneTlas.GetInstanceCount() << " instances" << std::endl;
+}
+
+// Path traces the current view with the objects' materials and the GL light,
+// PATH_TRACER_SAMPLES samples per pixel, and writes it to render.ppm; key P,
+// or headless with --path-traced
+void Application::renderPathTraced() {
+    if (!this->fullyLoaded) {
+        std::cout << "Still loading, path tracing skipped" << std::endl;
+        return;
+    }
+    std::vector<PathTracerObject> objects;
+    for (const Obj& object : this->objects) {
+        if (object.blas.IsEmpty())
+            continue;
+        PathTracerObject traced;
+        traced.blas = &object.blas;
+        traced.vertices = object.mesh.vertices.data();
+        traced.indices = object.mesh.indices.data();
+        traced.transform = object.getTransform();
+        traced.material.ambient = vec3(object.material.ambient[0], object.material.ambient[1], object.material.ambient[2]);
+        traced.material.diffuse = vec3(object.material.diffuse[0], object.material.diffuse[1], object.material.diffuse[2]);
+        traced.material.specular = vec3(object.material.specular[0], object.material.specular[1], object.material.specular[2]);
+        traced.material.shininess = object.material.shininess;
+        traced.material.texture = this->getCpuTexture(object.textureFile);
+        objects.push_back(traced);
+    }
+    PathTracerCamera camera;
+    camera.position = this->cameraPosition;
+    camera.inverseViewProjection = glm::inverse(this->projection * this->camera);
+
+    PathTracer& tracer = this->pathTracer;
+    tracer.SetSettings(PathTracerSettings());
+    tracer.Resize(this->width, this->height);
+    tracer.SetScene(objects);
+    tracer.SetCamera(camera);
+    while (tracer.GetSamplesPerPixel() < PATH_TRACER_SAMPLES) {
+        tracer.RenderPass();
+        if (tracer.GetSamplesPerPixel() % 8 == 0) {
+            std::cout << "Path tracer: " << tracer.GetSamplesPerPixel() << "/" << PATH_TRACER_SAMPLES << " samples per pixel, "
+                << tracer.GetSamplesPerSecondPerCore() / 1000 << " Ksamples/s/core (" << tracer.GetPassThreads() << " threads, "
+                << tracer.GetPassSteals() << " tiles stolen)" << std::endl;
+        }
+    }
+    std::cout << "Path tracer: " << tracer.GetWidth() << "x" << tracer.GetHeight() << " in " << tracer.GetTotalSeconds() << " s" << std::endl;
+    if (tracer.SavePpm("render.ppm"))
+        std::cout << "Saved render.ppm" << std::endl;
+}
+
+// Copies the objects' meshes and textures to a render device, replacing the
+// ones it held
+void Application::createDeviceScene(RenderDevice& device) {
+    std::map<std::string, uint32_t> textures;
+    device.DestroyResources();
+    this->deviceMeshes.clear();
+    this->deviceTextures.clear();
+    for (const Obj& object : this->objects) {
+        this->deviceMeshes.push_back(device.CreateMesh(object.mesh.vertices.data(), object.mesh.vertices.size(),
+            object.mesh.indices.data(), object.mesh.indices.size()));
+        auto found = textures.find(object.textureFile);
+        if (found == textures.end()) {
+            std::string textureFilePath = std::string("C:\\Users\\Safi\\Desktop\\computer-grphics-ESIEE\\OpenGL-OBJ-Renderer\\Projet\\Obj\\") + object.textureFile;
+            int w, h;
+            uint8_t* data = stbi_load(textureFilePath.c_str(), &w, &h, nullptr, STBI_rgb_alpha);
+            uint32_t texture = RENDER_NONE;
+            if (data) {
+                texture = device.CreateTexture(w, h, data);
+                stbi_image_free(data);
+            } else {
+                std::cerr << "Failed to load texture: " << textureFilePath << std::endl;
+            }
+            found = textures.insert({ object.textureFile, texture }).first;
+        }
+        this->deviceTextures.push_back(found->second);
+    }
+}
+
+// Draws the current view through a render device, with the same LODs and
+// lighting as the GL frame
+void Application::renderDevice(RenderDevice& device) {
+    RenderFrame frame;
+    frame.width = this->width;
+    frame.height = this->height;
+    frame.viewProjection = this->projection * this->camera;
+    frame.view = this->cameraPosition;
+    device.BeginFrame(frame);
+    for (size_t i = 0; i < this->objects.size(); i++) {
+        const Obj& object = this->objects[i];
+        mat4 transform = object.getTransform();
+        const MeshLod& lod = object.lods[object.selectLod(transform, object.lodPixelError, float(this->height))];
+        RenderDraw draw;
+        draw.mesh = this->deviceMeshes[i];
+        draw.texture = this->deviceTextures[i];
+        draw.firstIndex = lod.indexOffset;
+        draw.indexCount = lod.indexCount;
+        draw.transform = transform;
+        draw.material.ambient = vec3(object.material.ambient[0], object.material.ambient[1], object.material.ambient[2]);
+        draw.material.diffuse = vec3(object.material.diffuse[0], object.material.diffuse[1], object.material.diffuse[2]);
+        draw.material.specular = vec3(object.material.specular[0], object.material.specular[1], object.material.specular[2]);
+        draw.material.shininess = object.material.shininess;
+        device.Draw(draw);
+    }
+    device.EndFrame();
+}
+
+// Renders the current view with the software rasterizer on 1, 2, 4... jobs
+// up to the job system's threads, reports the best of 3 frames for each count
+void Application::renderSoftware() {
+    if (!this->fullyLoaded) {
+        std::cout << "Still loading, software rendering skipped" << std::endl;
+        return;
+    }
+    if (this->deviceMeshes.size() != this->objects.size())
+        this->createDeviceScene(this->softwareRenderer);
+    unsigned maxThreads = this->jobs.GetThreadCount();
+    for (unsigned threads = 1;; threads = std::min(threads * 2, maxThreads)) {
+        this->softwareRenderer.SetThreadCount(threads);
+        double best = 1e30;
+        for (int i = 0; i < 3; i++) {
+            auto start = std::chrono::steady_clock::now();
+            this->renderDevice(this->softwareRenderer);
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        const SoftwareRenderer& renderer = this->softwareRenderer;
+        std::cout << "Software rasterizer: " << threads << " threads, " << best * 1000 << " ms/frame (setup "
+            << renderer.GetSetupSeconds() * 1000 << " ms, raster " << renderer.GetRasterSeconds() * 1000 << " ms), "
+            << double(renderer.GetTrianglesSubmitted()) / best / 1e6 << " Mtriangles/s (" << renderer.GetTrianglesRasterized()
+            << " of " << renderer.GetTrianglesSubmitted() << " rasterized)" << std::endl;
+        if (threads == maxThreads)
+            break;
+    }
+    std::vector<uint8_t> pixels;
+    this->softwareRenderer.ReadPixels(pixels);
+    if (SavePpm("software.ppm", this->softwareRenderer.GetWidth(), this->softwareRenderer.GetHeight(), pixels))
+        std::cout << "Saved software.ppm" << std::endl;
+}
+
+// Rasterizes every object into the occlusion buffer and builds its depth
+// pyramid, before any object is submitted
+void Application::renderOcclusion() {
+    const int OCCLUSION_WIDTH = 320;
+    int occlusionHeight = glm::max(OCCLUSION_WIDTH * this->height / glm::max(this->width, 1), 1);
+    if (this->occlusionBuffer.GetWidth() != OCCLUSION_WIDTH || this->occlusionBuffer.GetHeight() != occlusionHeight)
+        this->occlusionBuffer.Resize(OCCLUSION_WIDTH, occlusionHeight);
+    this->occlusionBuffer.Clear();
+    this->occluderError = 0;
+    for (Obj& object : this->objects)
+        object.renderOccluder(this->occlusionBuffer);
+    this->occlusionBuffer.BuildPyramid();
+}
+
+// Records the draws of every object: each chunk of objects is a job with its
+// own recorder, then the chunks are appended in order to the batches
+void Application::recordDraws() {
+    const size_t CHUNK_OBJECTS = 64;
+    double start = glfwGetTime();
+    size_t chunkCount = (this->objects.size() + CHUNK_OBJECTS - 1) / CHUNK_OBJECTS;
+    if (this->drawRecorders.size() < chunkCount)
+        this->drawRecorders.resize(chunkCount);
+    for (size_t i = 0; i < chunkCount; i++) {
+        DrawRecorder& recorder = this->drawRecorders[i];
+        recorder.commands.resize(this->batches.size());
+        recorder.drawObjects.resize(this->batches.size());
+        for (size_t batch = 0; batch < this->batches.size(); batch++) {
+            recorder.commands[batch].clear();
+            recorder.drawObjects[batch].clear();
+        }
+        recorder.occludedObjects = recorder.occludedTriangles = recorder.occludedMeshlets = 0;
+    }
+
+    this->jobs.ParallelFor(chunkCount, 1, [this](size_t begin, size_t end) {
+        for (size_t chunk = begin; chunk < end; chunk++) {
+            size_t last = std::min(this->objects.size(), (chunk + 1) * CHUNK_OBJECTS);
+            for (size_t i = chunk * CHUNK_OBJECTS; i < last; i++)
+                this->objects[i].render(uint32_t(i), this->drawRecorders[chunk]);
+        }
+    });
+
+    for (size_t batch = 0; batch < this->batches.size(); batch++) {
+        RenderBatch& merged = this->batches[batch];
+        merged.commands.clear();
+        merged.drawObjects.clear();
+        for (size_t i = 0; i < chunkCount; i++) {
+            const DrawRecorder& recorder = this->drawRecorders[i];
+            merged.commands.insert(merged.commands.end(), recorder.commands[batch].begin(), recorder.commands[batch].end());
+            merged.drawObjects.insert(merged.drawObjects.end(), recorder.drawObjects[batch].begin(), recorder.drawObjects[batch].end());
+        }
+    }
+    for (size_t i = 0; i < chunkCount; i++) {
+        this->occlusionStats.objects += this->drawRecorders[i].occludedObjects;
+        this->occlusionStats.triangles += this->drawRecorders[i].occludedTriangles;
+        this->occlusionStats.meshlets += this->drawRecorders[i].occludedMeshlets;
+    }
+
+    RecordStats& stats = this->recordStats;
+    double end = glfwGetTime();
+    stats.frames++;
+    stats.seconds += end - start;
+    if (end - stats.lastReport >= 1) {
+        size_t jobCount = 0, steals = 0;
+        double busy = 0;
+        for (const JobThreadStats& thread : this->jobs.GetStats()) {
+            jobCount += thread.jobs;
+            steals += thread.steals;
+            busy += thread.busySeconds;
+        }
+        std::cout << "Draw recording: " << stats.seconds * 1000 / double(stats.frames) << " ms/frame, "
+            << this->objects.size() << " objects; jobs: " << jobCount << " (" << steals << " stolen), "
+            << busy * 100 / ((end - stats.lastReport) * this->jobs.GetThreadCount()) << "% busy on "
+            << this->jobs.GetThreadCount() << " threads; ring: " << this->frameRing.GetFrameSize() / 1024
+            << " KB per frame, fence wait " << stats.fenceWaitSeconds * 1000 / double(stats.frames) << " ms/frame" << std::endl;
+        this->jobs.ResetStats();
+        stats = RecordStats();
+        stats.lastReport = end;
+    }
+}
+
+// Records the upload of the frame's per-object data and draw commands, then
+// one glMultiDrawElementsIndirect per batch, with the batches sorted so that
+// the pipeline and texture only change when needed
+void Application::renderBatches() {
+    if (this->batchOrder.size() != this->batches.size()) {
+        this->batchOrder.resize(this->batches.size());
+        for (size_t i = 0; i < this->batches.size(); i++)
+            this->batchOrder[i] = i;
+        std::stable_sort(this->batchOrder.begin(), this->batchOrder.end(), [this](size_t a, size_t b) {
+            const RenderBatch& batchA = this->batches[a];
+            const RenderBatch& batchB = this->batches[b];
+            if (batchA.pipeline != batchB.pipeline)
+                return batchA.pipeline < batchB.pipeline;
+            return batchA.texture < batchB.texture;
         });
-    glfwSetScrollCallback(this->window, [](GLFWwindow* window, double xoffset, double yoffset) {
-        auto app = static_cast<Application*>(glfwGetWindowUserPointer(window));
-        if (app->canMove)
-            app->cameraR = glm::clamp(app->cameraR - static_cast<float>(yoffset) * 0.5f, 1.f, 500.f);
-        });
-    glfwGetCursorPos(this->window, &this->lastMouseX, &this->lastMouseY);
-    this->canMove = true;
+    }
 
-    return true;
+    size_t commandCount = 0;
+    for (const RenderBatch& batch : this->batches)
+        commandCount += batch.commands.size();
+    if (commandCount == 0)
+        return;
+
+    // The batches' draws, in replay order, and the frame's constants
+    RingAllocation drawObjects = this->frameRing.Allocate(commandCount * sizeof(uint32_t));
+    RingAllocation drawCommands = this->frameRing.Allocate(commandCount * sizeof(DrawElementsIndirectCommand));
+    size_t written = 0;
+    for (size_t i : this->batchOrder) {
+        const RenderBatch& batch = this->batches[i];
+        std::copy(batch.drawObjects.begin(), batch.drawObjects.end(), static_cast<uint32_t*>(drawObjects.data) + written);
+        std::copy(batch.commands.begin(), batch.commands.end(), static_cast<DrawElementsIndirectCommand*>(drawCommands.data) + written);
+        written += batch.commands.size();
+    }
+    RingAllocation frame = this->frameRing.Allocate(sizeof(FrameData));
+    FrameData frameData;
+    frameData.lightDirection = vec4(1, -1, -1, 0);
+    frameData.lightAmbientColor = vec4(0.1f);
+    frameData.lightDiffuseColor = vec4(1);
+    frameData.lightSpecularColor = vec4(0.5f);
+    frameData.view = this->cameraPosition;
+    frameData.time = static_cast<float>(glfwGetTime());
+    *static_cast<FrameData*>(frame.data) = frameData;
+
+    CommandList& commands = this->frameCommands;
+    commands.BindStorageBuffer(0, this->objectData.buffer, this->objectData.offset, this->objects.size() * sizeof(ObjectData));
+    commands.BindStorageBuffer(1, drawObjects.buffer, drawObjects.offset, commandCount * sizeof(uint32_t));
+    commands.BindStorageBuffer(2, frame.buffer, frame.offset, sizeof(FrameData));
+    commands.BindIndirectBuffer(drawCommands.buffer);
+
+    size_t firstCommand = 0;
+    const RenderBatch* previous = nullptr;
+    for (size_t i : this->batchOrder) {
+        const RenderBatch& batch = this->batches[i];
+        if (batch.commands.empty())
+            continue;
+        bool pipelineChanged = !previous || previous->pipeline != batch.pipeline;
+        if (pipelineChanged) {
+            commands.BindPipeline(batch.pipeline);
+            commands.SetUniform("sampler_", int32_t(0));
+        }
+        commands.SetUniform("drawOffset", uint32_t(firstCommand));
+        if (pipelineChanged || previous->texture != batch.texture)
+            commands.BindTexture(0, batch.texture);
+        if (pipelineChanged || previous->pool != batch.pool) {
+            commands.BindVertexBuffer(batch.pool->GetVertexBuffer());
+            commands.BindIndexBuffer(batch.pool->GetIndexBuffer());
+        }
+        previous = &batch;
+        commands.MultiDrawIndexedIndirect(drawCommands.offset + firstCommand * sizeof(DrawElementsIndirectCommand),
+            uint32_t(batch.commands.size()));
+        firstCommand += batch.commands.size();
+    }
 }
 
 void Application::renderPaused() {
-    uint32_t basic = this->getBasicProgram();
-    glUseProgram(basic);
-    const int32_t BASIC_TIME = glGetUniformLocation(basic, "time");
-    const int32_t BASIC_SAMPLER = glGetUniformLocation(basic, "sampler_");
-    glUniform1f(BASIC_TIME, 0);
-    glUniform1i(BASIC_SAMPLER, 0);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, this->pausedTexture);
-    glBindVertexArray(this->pausedVao);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
-    glDisable(GL_BLEND);
+    CommandList& commands = this->frameCommands;
+    commands.BindPipeline(this->pausedPipeline);
+    commands.SetUniform("time", 0.f);
+    commands.SetUniform("sampler_", int32_t(0));
+    commands.BindTexture(0, this->pausedTexture);
+    commands.BindVertexBuffer(this->pausedBuffers[0]);
+    commands.BindIndexBuffer(this->pausedBuffers[1]);
+    commands.DrawIndexed(6, 0, 0);
+}
+
+// Projection and view of the orbit camera around `target`
+void Application::updateCamera() {
+    float aspect = static_cast<float>(this->width) / static_cast<float>(this->height);
+    float near = 0.01, far = 500;
+    float fovY = 55 * DEG_TO_RAD;
+    float f = cotan(fovY / 2);
+    this->projection = {
+        f / aspect, 0, 0, 0,
+        0, f, 0, 0,
+        0, 0, (far + near) / (near - far), -1,
+        0, 0, 2 * near * far / (near - far), 0,
+    };
+    vec3 rawCameraPosition = {
+        this->cameraR * cos(this->cameraTheta) * cos(this->cameraPhi),
+        this->cameraR * sin(this->cameraTheta),
+        this->cameraR * cos(this->cameraTheta) * sin(this->cameraPhi)
+    };
+    this->cameraPosition = this->target + rawCameraPosition;
+    this->camera = LookAt(this->cameraPosition, this->target, { 0, 1, 0 });
 }
 
 void Application::render() {
@@ -523,48 +1700,67 @@ void Application::render() {
     };
     this->target += movementRotation * movement;
 
-    float aspect = static_cast<float>(this->width) / static_cast<float>(this->height);
-    float near = 0.01, far = 500;
-    float fovY = 55 * DEG_TO_RAD;
-    float f = cotan(fovY / 2);
-    this->projection = {
-        f / aspect, 0, 0, 0,
-        0, f, 0, 0,
-        0, 0, (far + near) / (near - far), -1,
-        0, 0, 2 * near * far / (near - far), 0,
-    };
-    vec3 rawCameraPosition = {
-        this->cameraR * cos(this->cameraTheta) * cos(this->cameraPhi),
-        this->cameraR * sin(this->cameraTheta),
-        this->cameraR * cos(this->cameraTheta) * sin(this->cameraPhi)
-    };
-    this->cameraPosition = this->target + rawCameraPosition;
-    this->camera = LookAt(this->cameraPosition, this->target, { 0, 1, 0 });
-
-    glClearColor(0, 0, 0, 1);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    for (Obj& object : this->objects)
-        object.render();
+    this->updateCamera();
+
+    this->frameCommands.Reset();
+    this->frameCommands.Clear(vec3(0));
+
+    this->updateLoading();
+    this->updateHotReload();
+
+    // Blocks if the GPU is still reading the ring region of this frame
+    this->frameRing.BeginFrame();
+    this->recordStats.fenceWaitSeconds += this->frameRing.GetWaitSeconds();
+    this->objectData = this->frameRing.Allocate(this->objects.size() * sizeof(ObjectData));
+    this->updateSceneTlas();
+
+    double occlusionStart = glfwGetTime();
+    if (this->occlusionCulling)
+        this->renderOcclusion();
+    double occlusionEnd = glfwGetTime();
+    this->recordDraws();
+    this->renderBatches();
+
+    // Cost of the occluder pass against the geometry it kept from the GPU
+    OcclusionStats& stats = this->occlusionStats;
+    stats.frames++;
+    stats.seconds += occlusionEnd - occlusionStart;
+    if (this->occlusionCulling && occlusionEnd - stats.lastReport >= 1) {
+        const OcclusionBuffer& buffer = this->occlusionBuffer;
+        std::cout << "Occlusion: " << stats.seconds * 1000 / double(stats.frames) << " ms/frame (occluders "
+            << buffer.GetTrianglesRasterized() << " triangles, "
+            << double(buffer.GetTrianglesRasterized()) / (buffer.GetRasterizeSeconds() * 1000 + 1e-9) << " triangles/ms), rejected per frame "
+            << stats.objects / stats.frames << " objects (" << stats.triangles / stats.frames << " triangles), "
+            << stats.meshlets / stats.frames << " meshlets" << std::endl;
+        stats = OcclusionStats();
+        stats.lastReport = occlusionEnd;
+    }
 
     if (!this->canMove)
         this->renderPaused();
+    this->backend.Submit(this->frameCommands);
+    this->frameRing.EndFrame();
 }
 
 void Application::deinitialize() {
-    for (Obj& object : this->objects)
-        object.destroy();
-
-    glDeleteBuffers(2, this->pausedBuffers);
-    glDeleteVertexArrays(1, &this->pausedVao);
-    glDeleteTextures(1, &this->pausedTexture);
-    this->basicShader.Destroy();
+    this->fileWatcher.Stop();
+    this->jobs.Stop();
+    this->frameRing.Destroy();
+    this->meshPools[0].Destroy();
+    this->meshPools[1].Destroy();
+    // Pipelines, textures and paused screen buffers, after the upload thread
+    this->backend.Destroy();
+    if (this->uploadContext)
+        glfwDestroyWindow(this->uploadContext);
 
     glfwDestroyCursor(this->handCursor);
 }
 
-int main() {
+int main(int argc, char** argv) {
     Application app(1280, 960);
+    // --headless [--path-traced]: software.ppm (and render.ppm) without a GPU
+    if (argc > 1 && std::string(argv[1]) == "--headless")
+        return app.runHeadless(argc > 2 && std::string(argv[2]) == "--path-traced");
     GLFWwindow* window;
 
     if (!glfwInit()) {
@@ -588,12 +1784,22 @@ int main() {
         return -1;
     }
 
+    // The objects load while the first frames are drawn
+    bool firstFrame = true;
     while (!glfwWindowShouldClose(window)) {
         int width, height;
         glfwGetWindowSize(window, &width, &height);
         app.setSize(width, height);
         app.render();
         glfwSwapBuffers(window);
+        if (firstFrame) {
+            std::cout << "Time to first frame: " << glfwGetTime() * 1000 << " ms" << std::endl;
+            const ShaderLoadStats& shaders = app.backend.GetShaderLoadStats();
+            std::cout << "Shaders: " << shaders.stages << " stages, " << shaders.files << " files (" << shaders.bytes / 1024.0
+                << " KB) read in " << shaders.readSeconds * 1000 << " ms, builds issued in " << shaders.issueSeconds * 1000
+                << " ms, waited for in " << shaders.waitSeconds * 1000 << " ms" << std::endl;
+            firstFrame = false;
+        }
         glfwPollEvents();
     }
 
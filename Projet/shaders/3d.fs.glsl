@@ -1,11 +1,9 @@
-#version 420
+#version 430
 
-struct Light {
-    vec3 direction;
-    vec3 ambientColor;
-    vec3 diffuseColor;
-    vec3 specularColor;
-};
+// Permutations, see Application::getPipeline():
+//   BLINK  modulates the color with the time
+
+#include "3d_common.glsl"
 
 struct Material {
     vec3 ambientColor;
@@ -14,13 +12,12 @@ struct Material {
 };
 
 uniform sampler2D sampler_;
-uniform Light light;
-uniform Material material;
-uniform float shininess;
-uniform vec3 view;
+Material material;
+float shininess;
 
 in vec3 fragNormal;
 in vec2 fragTexCoords;
+flat in uint fragObject;
 
 out vec4 color;
 
@@ -40,7 +37,14 @@ vec3 specular(vec3 n, vec3 l) {
 }
 
 void main(void) {
+    ObjectData object = objects[fragObject];
+    material = Material(object.ambientColor.rgb, object.diffuseColor.rgb, object.specularColor.rgb);
+    shininess = object.specularColor.w;
     vec3 n = normalize(fragNormal);
     vec3 l = -light.direction;
     color = texture2D(sampler_, vec2(fragTexCoords.x, -fragTexCoords.y)) * vec4(ambient() + diffuse(n, l) + specular(n, l), 0);
+#ifdef BLINK
+    float blink = 0.5 + 0.5 * sin(time * 7);
+    color *= vec4(blink, blink, blink, 1);
+#endif
 }
@@ -1,21 +1,56 @@
-#version 420
+#version 430
+#extension GL_ARB_shader_draw_parameters : require
 
-//layout(binding=0) uniform matrices {
-//    mat4 transformNormal;
-//    mat4 transformWithProjection;
-//};
-uniform mat4 transformNormal;
-uniform mat4 transformWithProjection;
+// Permutations, see Application::getPipeline():
+//   QUANTIZED   PackedVertex3 inputs, positions relative to the object's
+//               positionOffset/positionScale
+//   SHAKE       moves the vertices with the time
 
-in vec3 position;
-in vec3 normal;
-in vec2 texCoords;
+#include "3d_common.glsl"
+
+// Object drawn by each indirect command; drawOffset is the first command of
+// the current glMultiDrawElementsIndirect call
+layout(std430, binding = 1) readonly buffer DrawObjects {
+    uint drawObjects[];
+};
+uniform uint drawOffset;
+
+#ifdef QUANTIZED
+layout(location = 0) in vec3 position;  // unorm16
+layout(location = 1) in vec2 normal;    // octahedral, snorm16
+layout(location = 2) in vec2 texCoords; // half float
+#else
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 texCoords;
+#endif
 
 out vec3 fragNormal;
 out vec2 fragTexCoords;
+flat out uint fragObject;
+
+#ifdef QUANTIZED
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0)));
+    return normalize(n);
+}
+#endif
 
 void main(void) {
-    fragNormal = mat3(transformNormal) * normal;
+    fragObject = drawObjects[drawOffset + gl_DrawIDARB];
+    ObjectData object = objects[fragObject];
+#ifdef QUANTIZED
+    fragNormal = mat3(object.transformNormal) * decodeOctahedral(normal);
+    vec3 objectPosition = object.positionOffset.xyz + object.positionScale.xyz * position;
+#else
+    fragNormal = mat3(object.transformNormal) * normal;
+    vec3 objectPosition = position;
+#endif
     fragTexCoords = texCoords;
-    gl_Position = transformWithProjection * vec4(position, 1);
+#ifdef SHAKE
+    objectPosition += vec3(0.1 * sin(time * 10), 0.05 * sin(time * 50), 0.1 * cos(time * 10));
+#endif
+    gl_Position = object.transformWithProjection * vec4(objectPosition, 1);
 }
@@ -0,0 +1,30 @@
+// Buffers shared by the 3d shaders, see ObjectData and FrameData in main.cpp
+
+// Per-object data
+struct ObjectData {
+    mat4 transformNormal;
+    mat4 transformWithProjection;
+    vec4 positionOffset;
+    vec4 positionScale;
+    vec4 ambientColor;
+    vec4 diffuseColor;
+    vec4 specularColor; // w: shininess
+};
+
+layout(std430, binding = 0) readonly buffer Objects {
+    ObjectData objects[];
+};
+
+struct Light {
+    vec3 direction;
+    vec3 ambientColor;
+    vec3 diffuseColor;
+    vec3 specularColor;
+};
+
+// Per-frame data
+layout(std430, binding = 2) readonly buffer Frame {
+    Light light;
+    vec3 view;
+    float time;
+};
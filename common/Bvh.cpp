@@ -0,0 +1,541 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BVH_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const int BIN_COUNT = 16;
+// SAH costs, relative to one ray-triangle test.
+const float TRAVERSAL_COST = 1.f;
+// Leaf size of the triangle trees; leaves may be larger only when no split
+// separates their primitives.
+const uint32_t MAX_LEAF_SIZE = 8;
+// Instances are expensive to test (ray transform and a tree of their own),
+// the top level tree keeps one per leaf.
+const uint32_t TLAS_MAX_LEAF_SIZE = 1;
+// Deeper nodes are made leaves, which bounds the traversal stacks.
+const int MAX_DEPTH = 64;
+
+struct Bounds {
+	glm::vec3 min = glm::vec3(1e30f);
+	glm::vec3 max = glm::vec3(-1e30f);
+
+	inline void Grow(const glm::vec3& p) {
+		min = glm::min(min, p);
+		max = glm::max(max, p);
+	}
+	inline void Grow(const Bounds& b) {
+		min = glm::min(min, b.min);
+		max = glm::max(max, b.max);
+	}
+	inline float HalfArea() const {
+		glm::vec3 e = max - min;
+		return e.x < 0 ? 0 : e.x * e.y + e.y * e.z + e.z * e.x;
+	}
+};
+
+struct BuildState {
+	const std::vector<glm::vec3>& boundsMin;
+	const std::vector<glm::vec3>& boundsMax;
+	std::vector<glm::vec3> centroids;
+	uint32_t maxLeafSize;
+	std::vector<BvhNode>& nodes;
+	std::vector<uint32_t>& order;
+
+	BuildState(const std::vector<glm::vec3>& boundsMin, const std::vector<glm::vec3>& boundsMax, uint32_t maxLeafSize,
+		std::vector<BvhNode>& nodes, std::vector<uint32_t>& order)
+		: boundsMin(boundsMin), boundsMax(boundsMax), maxLeafSize(maxLeafSize), nodes(nodes), order(order) {}
+};
+
+void MakeLeaf(BvhNode& node, uint32_t first, uint32_t count) {
+	node.index = first;
+	node.count = count;
+}
+
+// Builds the subtree over order[first .. first + count) and returns its node.
+uint32_t Subdivide(BuildState& state, uint32_t first, uint32_t count, int depth) {
+	const uint32_t nodeIndex = uint32_t(state.nodes.size());
+	state.nodes.push_back(BvhNode());
+	Bounds bounds, centroidBounds;
+	for (uint32_t i = first; i < first + count; i++) {
+		bounds.Grow(state.boundsMin[state.order[i]]);
+		bounds.Grow(state.boundsMax[state.order[i]]);
+		centroidBounds.Grow(state.centroids[state.order[i]]);
+	}
+	state.nodes[nodeIndex].boundsMin = bounds.min;
+	state.nodes[nodeIndex].boundsMax = bounds.max;
+	if (count <= 1 || depth >= MAX_DEPTH - 1) {
+		MakeLeaf(state.nodes[nodeIndex], first, count);
+		return nodeIndex;
+	}
+
+	// Cheapest split among BIN_COUNT bins of the centroids on each axis.
+	int bestAxis = -1, bestSplit = 0;
+	float bestCost = float(count);
+	const float parentArea = bounds.HalfArea();
+	for (int axis = 0; axis < 3; axis++) {
+		float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+		if (extent <= 0)
+			continue;
+		Bounds bins[BIN_COUNT];
+		uint32_t binCounts[BIN_COUNT] = {};
+		float scale = float(BIN_COUNT) / extent;
+		for (uint32_t i = first; i < first + count; i++) {
+			uint32_t primitive = state.order[i];
+			int bin = std::min(int((state.centroids[primitive][axis] - centroidBounds.min[axis]) * scale), BIN_COUNT - 1);
+			bins[bin].Grow(state.boundsMin[primitive]);
+			bins[bin].Grow(state.boundsMax[primitive]);
+			binCounts[bin]++;
+		}
+		float rightAreas[BIN_COUNT];
+		uint32_t rightCounts[BIN_COUNT];
+		Bounds right;
+		uint32_t rightCount = 0;
+		for (int bin = BIN_COUNT - 1; bin > 0; bin--) {
+			right.Grow(bins[bin]);
+			rightCount += binCounts[bin];
+			rightAreas[bin] = right.HalfArea();
+			rightCounts[bin] = rightCount;
+		}
+		Bounds left;
+		uint32_t leftCount = 0;
+		for (int split = 1; split < BIN_COUNT; split++) {
+			left.Grow(bins[split - 1]);
+			leftCount += binCounts[split - 1];
+			if (leftCount == 0 || rightCounts[split] == 0)
+				continue;
+			float cost = TRAVERSAL_COST + (left.HalfArea() * float(leftCount) + rightAreas[split] * float(rightCounts[split])) / parentArea;
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = split;
+			}
+		}
+	}
+
+	uint32_t leftCount = 0;
+	if (bestAxis >= 0) {
+		float minimum = centroidBounds.min[bestAxis];
+		float scale = float(BIN_COUNT) / (centroidBounds.max[bestAxis] - minimum);
+		auto middle = std::partition(state.order.begin() + first, state.order.begin() + first + count, [&](uint32_t primitive) {
+			return std::min(int((state.centroids[primitive][bestAxis] - minimum) * scale), BIN_COUNT - 1) < bestSplit;
+		});
+		leftCount = uint32_t(middle - (state.order.begin() + first));
+	} else if (count > state.maxLeafSize) {
+		// No split beats a leaf (or all centroids are equal) but the leaf
+		// would be too large: split in the middle.
+		leftCount = count / 2;
+	}
+	if (leftCount == 0 || leftCount == count) {
+		MakeLeaf(state.nodes[nodeIndex], first, count);
+		return nodeIndex;
+	}
+
+	Subdivide(state, first, leftCount, depth + 1);
+	uint32_t rightIndex = Subdivide(state, first + leftCount, count - leftCount, depth + 1);
+	state.nodes[nodeIndex].index = rightIndex;
+	state.nodes[nodeIndex].count = 0;
+	return nodeIndex;
+}
+
+inline glm::vec3 TransformPoint(const glm::mat4& m, const glm::vec3& p) {
+	return glm::vec3(m[0]) * p.x + glm::vec3(m[1]) * p.y + glm::vec3(m[2]) * p.z + glm::vec3(m[3]);
+}
+
+inline glm::vec3 Position(const BvhMesh& mesh, uint32_t index) {
+	const glm::vec3& position = *reinterpret_cast<const glm::vec3*>(
+		reinterpret_cast<const char*>(mesh.positions) + size_t(index) * mesh.positionStride);
+	return TransformPoint(mesh.transform, position);
+}
+
+// Ray prepared for the slab test.
+struct Ray {
+	glm::vec3 origin;
+	glm::vec3 direction;
+	glm::vec3 invDirection;
+#ifdef BVH_SSE2
+	__m128 origin4;
+	__m128 invDirection4;
+#endif
+};
+
+// Entry distance of the ray into the node box, or a negative value if it
+// misses it or enters it beyond `maxDistance`.
+inline float IntersectBox(const Ray& ray, const BvhNode& node, float maxDistance) {
+#ifdef BVH_SSE2
+	// The fourth lane holds index/count and is ignored.
+	__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.boundsMin.x), ray.origin4), ray.invDirection4);
+	__m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.boundsMax.x), ray.origin4), ray.invDirection4);
+	__m128 tMin = _mm_min_ps(t1, t2), tMax = _mm_max_ps(t1, t2);
+	__m128 nearest = _mm_max_ss(_mm_max_ss(tMin, _mm_shuffle_ps(tMin, tMin, 1)), _mm_shuffle_ps(tMin, tMin, 2));
+	__m128 farthest = _mm_min_ss(_mm_min_ss(tMax, _mm_shuffle_ps(tMax, tMax, 1)), _mm_shuffle_ps(tMax, tMax, 2));
+	float entry = std::max(_mm_cvtss_f32(nearest), 0.f);
+	float exit = std::min(_mm_cvtss_f32(farthest), maxDistance);
+#else
+	glm::vec3 t1 = (node.boundsMin - ray.origin) * ray.invDirection;
+	glm::vec3 t2 = (node.boundsMax - ray.origin) * ray.invDirection;
+	glm::vec3 tMin = glm::min(t1, t2), tMax = glm::max(t1, t2);
+	float entry = std::max(std::max(tMin.x, std::max(tMin.y, tMin.z)), 0.f);
+	float exit = std::min(std::min(tMax.x, std::min(tMax.y, tMax.z)), maxDistance);
+#endif
+	return entry <= exit ? entry : -1.f;
+}
+
+inline bool Overlaps(const glm::vec3& minA, const glm::vec3& maxA, const glm::vec3& minB, const glm::vec3& maxB) {
+	return minA.x <= maxB.x && minA.y <= maxB.y && minA.z <= maxB.z &&
+		maxA.x >= minB.x && maxA.y >= minB.y && maxA.z >= minB.z;
+}
+
+inline Ray MakeRay(const glm::vec3& origin, const glm::vec3& direction) {
+	Ray ray;
+	ray.origin = origin;
+	ray.direction = direction;
+	ray.invDirection = 1.f / direction;
+#ifdef BVH_SSE2
+	ray.origin4 = _mm_setr_ps(origin.x, origin.y, origin.z, 0);
+	ray.invDirection4 = _mm_setr_ps(ray.invDirection.x, ray.invDirection.y, ray.invDirection.z, 0);
+#endif
+	return ray;
+}
+
+// Visits the leaves hit by the ray, nearest first. `leaf(node)` tests their
+// primitives, lowers `best` on a hit and returns whether there was one.
+template <typename LeafFunction>
+bool Traverse(const std::vector<BvhNode>& nodes, const Ray& ray, float& best, LeafFunction leaf) {
+	bool found = false;
+	struct Entry {
+		uint32_t node;
+		float distance;
+	};
+	Entry stack[MAX_DEPTH];
+	size_t stackSize = 0;
+	if (IntersectBox(ray, nodes[0], best) >= 0)
+		stack[stackSize++] = { 0, 0 };
+
+	while (stackSize > 0) {
+		Entry entry = stack[--stackSize];
+		if (entry.distance > best)
+			continue;
+		uint32_t nodeIndex = entry.node;
+		while (true) {
+			const BvhNode& node = nodes[nodeIndex];
+			if (node.count > 0) {
+				found = leaf(node) || found;
+				break;
+			}
+			// Visit the nearest child first, keep the other for later.
+			uint32_t nearChild = nodeIndex + 1, farChild = node.index;
+			float nearDistance = IntersectBox(ray, nodes[nearChild], best);
+			float farDistance = IntersectBox(ray, nodes[farChild], best);
+			if (farDistance >= 0 && (nearDistance < 0 || farDistance < nearDistance)) {
+				std::swap(nearChild, farChild);
+				std::swap(nearDistance, farDistance);
+			}
+			if (nearDistance < 0)
+				break;
+			if (farDistance >= 0)
+				stack[stackSize++] = { farChild, farDistance };
+			nodeIndex = nearChild;
+		}
+	}
+	return found;
+}
+
+// Visits the leaves whose bounds overlap the box.
+template <typename LeafFunction>
+void TraverseOverlapping(const std::vector<BvhNode>& nodes, const glm::vec3& boundsMin, const glm::vec3& boundsMax, LeafFunction leaf) {
+	uint32_t stack[MAX_DEPTH];
+	size_t stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0) {
+		uint32_t nodeIndex = stack[--stackSize];
+		const BvhNode& node = nodes[nodeIndex];
+		if (!Overlaps(node.boundsMin, node.boundsMax, boundsMin, boundsMax))
+			continue;
+		if (node.count == 0) {
+			stack[stackSize++] = node.index;
+			stack[stackSize++] = nodeIndex + 1;
+			continue;
+		}
+		leaf(node);
+	}
+}
+
+// Recomputes the bounds bottom up, `leaf(node)` gives the bounds of a leaf.
+template <typename LeafFunction>
+void RefitNodes(std::vector<BvhNode>& nodes, LeafFunction leaf) {
+	// Children are stored after their parent.
+	for (size_t i = nodes.size(); i-- > 0;) {
+		BvhNode& node = nodes[i];
+		Bounds bounds;
+		if (node.count > 0) {
+			bounds = leaf(node);
+		} else {
+			const BvhNode& left = nodes[i + 1];
+			const BvhNode& right = nodes[node.index];
+			bounds.min = glm::min(left.boundsMin, right.boundsMin);
+			bounds.max = glm::max(left.boundsMax, right.boundsMax);
+		}
+		node.boundsMin = bounds.min;
+		node.boundsMax = bounds.max;
+	}
+}
+
+} // namespace
+
+void BuildBvhNodes(const std::vector<glm::vec3>& boundsMin, const std::vector<glm::vec3>& boundsMax,
+	uint32_t maxLeafSize, std::vector<BvhNode>& nodes, std::vector<uint32_t>& order) {
+	nodes.clear();
+	order.resize(boundsMin.size());
+	if (boundsMin.empty())
+		return;
+	BuildState state(boundsMin, boundsMax, maxLeafSize, nodes, order);
+	state.centroids.resize(boundsMin.size());
+	for (size_t i = 0; i < boundsMin.size(); i++) {
+		state.centroids[i] = (boundsMin[i] + boundsMax[i]) * 0.5f;
+		order[i] = uint32_t(i);
+	}
+	nodes.reserve(boundsMin.size() * 2);
+	Subdivide(state, 0, uint32_t(boundsMin.size()), 0);
+}
+
+void Bvh::Clear() {
+	m_Nodes.clear();
+	m_Triangles.clear();
+	m_Refs.clear();
+}
+
+void Bvh::UpdateTriangles(const std::vector<BvhMesh>& meshes) {
+	m_Triangles.resize(m_Refs.size());
+	for (size_t i = 0; i < m_Refs.size(); i++) {
+		const BvhMesh& mesh = meshes[m_Refs[i].mesh];
+		const uint32_t* indices = mesh.indices + size_t(m_Refs[i].triangle) * 3;
+		glm::vec3 p0 = Position(mesh, indices[0]);
+		m_Triangles[i].vertex0 = p0;
+		m_Triangles[i].edge1 = Position(mesh, indices[1]) - p0;
+		m_Triangles[i].edge2 = Position(mesh, indices[2]) - p0;
+	}
+}
+
+void Bvh::Build(const std::vector<BvhMesh>& meshes) {
+	auto start = std::chrono::steady_clock::now();
+	Clear();
+	for (size_t m = 0; m < meshes.size(); m++)
+		for (size_t t = 0; t < meshes[m].indexCount / 3; t++)
+			m_Refs.push_back({ uint32_t(m), uint32_t(t) });
+	if (m_Refs.empty())
+		return;
+	UpdateTriangles(meshes);
+
+	std::vector<glm::vec3> boundsMin(m_Triangles.size()), boundsMax(m_Triangles.size());
+	for (size_t i = 0; i < m_Triangles.size(); i++) {
+		const Triangle& triangle = m_Triangles[i];
+		glm::vec3 p1 = triangle.vertex0 + triangle.edge1, p2 = triangle.vertex0 + triangle.edge2;
+		boundsMin[i] = glm::min(triangle.vertex0, glm::min(p1, p2));
+		boundsMax[i] = glm::max(triangle.vertex0, glm::max(p1, p2));
+	}
+	std::vector<uint32_t> order;
+	BuildBvhNodes(boundsMin, boundsMax, MAX_LEAF_SIZE, m_Nodes, order);
+
+	// Store the triangles in leaf order.
+	std::vector<Triangle> triangles(m_Triangles.size());
+	std::vector<BvhTriangleRef> refs(m_Refs.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		triangles[i] = m_Triangles[order[i]];
+		refs[i] = m_Refs[order[i]];
+	}
+	m_Triangles.swap(triangles);
+	m_Refs.swap(refs);
+	m_BuildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Bvh::Refit(const std::vector<BvhMesh>& meshes) {
+	auto start = std::chrono::steady_clock::now();
+	if (m_Nodes.empty())
+		return;
+	UpdateTriangles(meshes);
+	RefitNodes(m_Nodes, [&](const BvhNode& node) {
+		Bounds bounds;
+		for (uint32_t t = node.index; t < node.index + node.count; t++) {
+			bounds.Grow(m_Triangles[t].vertex0);
+			bounds.Grow(m_Triangles[t].vertex0 + m_Triangles[t].edge1);
+			bounds.Grow(m_Triangles[t].vertex0 + m_Triangles[t].edge2);
+		}
+		return bounds;
+	});
+	m_BuildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool Bvh::Intersect(const glm::vec3& origin, const glm::vec3& direction, BvhHit& hit, float maxDistance) const {
+	if (m_Nodes.empty())
+		return false;
+	Ray ray = MakeRay(origin, direction);
+	float best = maxDistance;
+	return Traverse(m_Nodes, ray, best, [&](const BvhNode& node) {
+		bool found = false;
+		// Moller-Trumbore, both sides.
+		for (uint32_t t = node.index; t < node.index + node.count; t++) {
+			const Triangle& triangle = m_Triangles[t];
+			glm::vec3 p = glm::cross(direction, triangle.edge2);
+			float determinant = glm::dot(triangle.edge1, p);
+			if (determinant == 0)
+				continue;
+			float inverse = 1 / determinant;
+			glm::vec3 s = origin - triangle.vertex0;
+			float u = glm::dot(s, p) * inverse;
+			if (u < 0 || u > 1)
+				continue;
+			glm::vec3 q = glm::cross(s, triangle.edge1);
+			float v = glm::dot(direction, q) * inverse;
+			if (v < 0 || u + v > 1)
+				continue;
+			float distance = glm::dot(triangle.edge2, q) * inverse;
+			if (distance > 0 && distance < best) {
+				best = distance;
+				found = true;
+				hit.ref = m_Refs[t];
+				hit.distance = distance;
+				hit.barycentrics = glm::vec2(u, v);
+			}
+		}
+		return found;
+	});
+}
+
+size_t Bvh::Query(const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<BvhTriangleRef>& triangles) const {
+	if (m_Nodes.empty())
+		return 0;
+	size_t found = 0;
+	TraverseOverlapping(m_Nodes, boundsMin, boundsMax, [&](const BvhNode& node) {
+		for (uint32_t t = node.index; t < node.index + node.count; t++) {
+			const Triangle& triangle = m_Triangles[t];
+			glm::vec3 p1 = triangle.vertex0 + triangle.edge1, p2 = triangle.vertex0 + triangle.edge2;
+			if (Overlaps(glm::min(triangle.vertex0, glm::min(p1, p2)), glm::max(triangle.vertex0, glm::max(p1, p2)), boundsMin, boundsMax)) {
+				triangles.push_back(m_Refs[t]);
+				found++;
+			}
+		}
+	});
+	return found;
+}
+
+void Tlas::Clear() {
+	m_Nodes.clear();
+	m_Instances.clear();
+	m_InstanceIndices.clear();
+	m_BoundsMin.clear();
+	m_BoundsMax.clear();
+}
+
+void Tlas::UpdateInstances(const std::vector<TlasInstance>& instances) {
+	for (size_t i = 0; i < m_Instances.size(); i++) {
+		const TlasInstance& instance = instances[m_InstanceIndices[i]];
+		m_Instances[i].blas = instance.blas;
+		m_Instances[i].worldToObject = glm::inverse(instance.transform);
+		// World box of the root box (Arvo): transformed center, extent
+		// through the absolute matrix.
+		const BvhNode& root = instance.blas->GetNodes()[0];
+		glm::vec3 center = TransformPoint(instance.transform, (root.boundsMin + root.boundsMax) * 0.5f);
+		glm::vec3 halfSize = (root.boundsMax - root.boundsMin) * 0.5f;
+		glm::vec3 extent = glm::abs(glm::vec3(instance.transform[0])) * halfSize.x +
+			glm::abs(glm::vec3(instance.transform[1])) * halfSize.y + glm::abs(glm::vec3(instance.transform[2])) * halfSize.z;
+		m_BoundsMin[i] = center - extent;
+		m_BoundsMax[i] = center + extent;
+	}
+}
+
+void Tlas::Build(const std::vector<TlasInstance>& instances) {
+	auto start = std::chrono::steady_clock::now();
+	Clear();
+	for (size_t i = 0; i < instances.size(); i++)
+		if (instances[i].blas && !instances[i].blas->IsEmpty())
+			m_InstanceIndices.push_back(uint32_t(i));
+	if (m_InstanceIndices.empty())
+		return;
+	m_Instances.resize(m_InstanceIndices.size());
+	m_BoundsMin.resize(m_InstanceIndices.size());
+	m_BoundsMax.resize(m_InstanceIndices.size());
+	UpdateInstances(instances);
+
+	std::vector<uint32_t> order;
+	BuildBvhNodes(m_BoundsMin, m_BoundsMax, TLAS_MAX_LEAF_SIZE, m_Nodes, order);
+
+	// Store the instances in leaf order.
+	std::vector<Instance> sorted(m_Instances.size());
+	std::vector<uint32_t> indices(order.size());
+	std::vector<glm::vec3> boundsMin(order.size()), boundsMax(order.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		sorted[i] = m_Instances[order[i]];
+		indices[i] = m_InstanceIndices[order[i]];
+		boundsMin[i] = m_BoundsMin[order[i]];
+		boundsMax[i] = m_BoundsMax[order[i]];
+	}
+	m_Instances.swap(sorted);
+	m_InstanceIndices.swap(indices);
+	m_BoundsMin.swap(boundsMin);
+	m_BoundsMax.swap(boundsMax);
+	m_BuildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Tlas::Refit(const std::vector<TlasInstance>& instances) {
+	auto start = std::chrono::steady_clock::now();
+	if (m_Nodes.empty())
+		return;
+	UpdateInstances(instances);
+	RefitNodes(m_Nodes, [&](const BvhNode& node) {
+		Bounds bounds;
+		for (uint32_t i = node.index; i < node.index + node.count; i++) {
+			bounds.Grow(m_BoundsMin[i]);
+			bounds.Grow(m_BoundsMax[i]);
+		}
+		return bounds;
+	});
+	m_BuildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool Tlas::Intersect(const glm::vec3& origin, const glm::vec3& direction, TlasHit& hit, float maxDistance) const {
+	if (m_Nodes.empty())
+		return false;
+	Ray ray = MakeRay(origin, direction);
+	float best = maxDistance;
+	return Traverse(m_Nodes, ray, best, [&](const BvhNode& node) {
+		bool found = false;
+		for (uint32_t i = node.index; i < node.index + node.count; i++) {
+			// An affine transform keeps the ray parameter, so the object
+			// space distance is the world one.
+			const glm::mat4& m = m_Instances[i].worldToObject;
+			glm::vec3 objectOrigin = TransformPoint(m, origin);
+			glm::vec3 objectDirection = glm::vec3(m[0]) * direction.x + glm::vec3(m[1]) * direction.y + glm::vec3(m[2]) * direction.z;
+			BvhHit objectHit;
+			if (m_Instances[i].blas->Intersect(objectOrigin, objectDirection, objectHit, best)) {
+				best = objectHit.distance;
+				found = true;
+				hit.instance = m_InstanceIndices[i];
+				hit.hit = objectHit;
+			}
+		}
+		return found;
+	});
+}
+
+size_t Tlas::Query(const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<uint32_t>& instances) const {
+	if (m_Nodes.empty())
+		return 0;
+	size_t found = 0;
+	TraverseOverlapping(m_Nodes, boundsMin, boundsMax, [&](const BvhNode& node) {
+		for (uint32_t i = node.index; i < node.index + node.count; i++) {
+			if (Overlaps(m_BoundsMin[i], m_BoundsMax[i], boundsMin, boundsMax)) {
+				instances.push_back(m_InstanceIndices[i]);
+				found++;
+			}
+		}
+	});
+	return found;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Triangles of one mesh placed in the world by `transform`. Positions are
+// read every `positionStride` bytes, so they can be taken straight from a
+// vertex array; they must stay alive while the Bvh is built or refit.
+struct BvhMesh {
+	const glm::vec3* positions = nullptr;
+	size_t positionStride = sizeof(glm::vec3);
+	const uint32_t* indices = nullptr;
+	size_t indexCount = 0;
+	glm::mat4 transform = glm::mat4(1);
+};
+
+// Triangle `triangle` (indices 3 * triangle .. 3 * triangle + 2) of mesh `mesh`.
+struct BvhTriangleRef {
+	uint32_t mesh;
+	uint32_t triangle;
+};
+
+struct BvhHit {
+	BvhTriangleRef ref = { ~0u, ~0u };
+	float distance = 0;
+	// Barycentric coordinates of vertices 1 and 2.
+	glm::vec2 barycentrics = glm::vec2(0);
+};
+
+// Node of the flattened tree, 32 bytes. Nodes are stored depth first: the
+// left child of an inner node follows it, `index` points at the right child.
+// A leaf (count > 0) holds the triangles index .. index + count - 1.
+struct BvhNode {
+	glm::vec3 boundsMin;
+	uint32_t index;
+	glm::vec3 boundsMax;
+	uint32_t count;
+};
+
+// Builds a flattened tree with the binned surface area heuristic over
+// primitives given by their bounds. `order` receives the primitive indices in
+// leaf order, the leaves index into it.
+void BuildBvhNodes(const std::vector<glm::vec3>& boundsMin, const std::vector<glm::vec3>& boundsMax,
+	uint32_t maxLeafSize, std::vector<BvhNode>& nodes, std::vector<uint32_t>& order);
+
+// Bounding volume hierarchy over the world space triangles of several
+// meshes, built with the surface area heuristic (binned), for ray picking and
+// box queries. Triangles are copied in leaf order so a leaf is one
+// contiguous read. When the meshes move the tree can be refit: the topology
+// is kept and only the bounds are recomputed, which is much cheaper than a
+// rebuild but degrades if the meshes move a lot relative to each other.
+class Bvh
+{
+private:
+	struct Triangle
+	{
+		glm::vec3 vertex0;
+		glm::vec3 edge1;
+		glm::vec3 edge2;
+	};
+
+	std::vector<BvhNode> m_Nodes;
+	std::vector<Triangle> m_Triangles;
+	std::vector<BvhTriangleRef> m_Refs;
+	double m_BuildSeconds = 0;
+
+	void UpdateTriangles(const std::vector<BvhMesh>& meshes);
+
+public:
+	void Build(const std::vector<BvhMesh>& meshes);
+	// Same meshes and indices as Build(), with new positions or transforms.
+	void Refit(const std::vector<BvhMesh>& meshes);
+	void Clear();
+
+	// Nearest triangle hit by the ray (either side), within `maxDistance`
+	// in units of `direction`.
+	bool Intersect(const glm::vec3& origin, const glm::vec3& direction, BvhHit& hit, float maxDistance = 1e30f) const;
+	// Appends the triangles whose bounds overlap the box.
+	size_t Query(const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<BvhTriangleRef>& triangles) const;
+
+	inline bool IsEmpty() const { return m_Nodes.empty(); }
+	inline size_t GetNodeCount() const { return m_Nodes.size(); }
+	inline size_t GetTriangleCount() const { return m_Triangles.size(); }
+	inline const std::vector<BvhNode>& GetNodes() const { return m_Nodes; }
+	// Time spent in the last Build() or Refit().
+	inline double GetBuildSeconds() const { return m_BuildSeconds; }
+};
+
+// Bottom level tree placed in the world by `transform`. The tree is built in
+// object space (BvhMesh::transform left to identity) and must stay alive
+// while the Tlas is used.
+struct TlasInstance {
+	const Bvh* blas = nullptr;
+	glm::mat4 transform = glm::mat4(1);
+};
+
+struct TlasHit {
+	// Index in the instances given to Build().
+	uint32_t instance = ~0u;
+	// Hit in the bottom level tree; the distance is the same in world and
+	// object space since rays are transformed as a whole.
+	BvhHit hit;
+};
+
+// Top level tree over instances of bottom level trees, for scenes where
+// objects move: each mesh gets its own Bvh, built once, and only this small
+// tree over the instance boxes is rebuilt (or refit) when the transforms
+// change. Rays reaching an instance are moved into its object space and
+// traced in its bottom level tree.
+class Tlas
+{
+private:
+	struct Instance
+	{
+		const Bvh* blas;
+		glm::mat4 worldToObject;
+	};
+
+	std::vector<BvhNode> m_Nodes;
+	// Instances in leaf order, and their index in the caller's array.
+	std::vector<Instance> m_Instances;
+	std::vector<uint32_t> m_InstanceIndices;
+	std::vector<glm::vec3> m_BoundsMin;
+	std::vector<glm::vec3> m_BoundsMax;
+	double m_BuildSeconds = 0;
+
+	void UpdateInstances(const std::vector<TlasInstance>& instances);
+
+public:
+	// Instances without a tree or with an empty one are left out.
+	void Build(const std::vector<TlasInstance>& instances);
+	// Same instances as Build(), with new transforms.
+	void Refit(const std::vector<TlasInstance>& instances);
+	void Clear();
+
+	// Nearest triangle hit by the ray (either side) over all instances.
+	bool Intersect(const glm::vec3& origin, const glm::vec3& direction, TlasHit& hit, float maxDistance = 1e30f) const;
+	// Appends the instances whose world bounds overlap the box.
+	size_t Query(const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<uint32_t>& instances) const;
+
+	inline bool IsEmpty() const { return m_Nodes.empty(); }
+	inline size_t GetNodeCount() const { return m_Nodes.size(); }
+	inline size_t GetInstanceCount() const { return m_Instances.size(); }
+	// Time spent in the last Build() or Refit().
+	inline double GetBuildSeconds() const { return m_BuildSeconds; }
+};
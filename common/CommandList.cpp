@@ -0,0 +1,120 @@
+#include "CommandList.h"
+
+#include <cstring>
+
+namespace {
+
+Command MakeCommand(CommandType type, uint32_t handle = RENDER_NONE) {
+	Command command;
+	command.type = type;
+	command.handle = handle;
+	return command;
+}
+
+} // namespace
+
+void CommandList::Reset() {
+	m_Commands.clear();
+	m_Data.clear();
+}
+
+void CommandList::Clear(const glm::vec3& color, float depth) {
+	Command command = MakeCommand(COMMAND_CLEAR);
+	command.value = glm::vec4(color, depth);
+	m_Commands.push_back(command);
+}
+
+void CommandList::BindPipeline(uint32_t pipeline) {
+	m_Commands.push_back(MakeCommand(COMMAND_BIND_PIPELINE, pipeline));
+}
+
+void CommandList::BindVertexBuffer(uint32_t buffer, size_t offset) {
+	Command command = MakeCommand(COMMAND_BIND_VERTEX_BUFFER, buffer);
+	command.offset = offset;
+	m_Commands.push_back(command);
+}
+
+void CommandList::BindIndexBuffer(uint32_t buffer) {
+	m_Commands.push_back(MakeCommand(COMMAND_BIND_INDEX_BUFFER, buffer));
+}
+
+void CommandList::BindTexture(uint32_t slot, uint32_t texture) {
+	Command command = MakeCommand(COMMAND_BIND_TEXTURE, texture);
+	command.args[0] = slot;
+	m_Commands.push_back(command);
+}
+
+void CommandList::BindStorageBuffer(uint32_t slot, uint32_t buffer, size_t offset, size_t size) {
+	Command command = MakeCommand(COMMAND_BIND_STORAGE_BUFFER, buffer);
+	command.args[0] = slot;
+	command.offset = offset;
+	command.size = size;
+	m_Commands.push_back(command);
+}
+
+void CommandList::BindIndirectBuffer(uint32_t buffer) {
+	m_Commands.push_back(MakeCommand(COMMAND_BIND_INDIRECT_BUFFER, buffer));
+}
+
+void CommandList::UpdateBuffer(uint32_t buffer, const void* data, size_t size) {
+	Command command = MakeCommand(COMMAND_UPDATE_BUFFER, buffer);
+	command.offset = m_Data.size();
+	command.size = size;
+	m_Data.resize(m_Data.size() + size);
+	if (size)
+		memcpy(&m_Data[command.offset], data, size);
+	m_Commands.push_back(command);
+}
+
+void CommandList::SetUniform(const char* name, float value) {
+	Command command = MakeCommand(COMMAND_SET_UNIFORM_FLOAT);
+	command.name = name;
+	command.value.x = value;
+	m_Commands.push_back(command);
+}
+
+void CommandList::SetUniform(const char* name, int32_t value) {
+	Command command = MakeCommand(COMMAND_SET_UNIFORM_INT);
+	command.name = name;
+	command.args[0] = uint32_t(value);
+	m_Commands.push_back(command);
+}
+
+void CommandList::SetUniform(const char* name, uint32_t value) {
+	Command command = MakeCommand(COMMAND_SET_UNIFORM_UINT);
+	command.name = name;
+	command.args[0] = value;
+	m_Commands.push_back(command);
+}
+
+void CommandList::SetUniform(const char* name, const glm::vec3& value) {
+	Command command = MakeCommand(COMMAND_SET_UNIFORM_VEC3);
+	command.name = name;
+	command.value = glm::vec4(value, 0);
+	m_Commands.push_back(command);
+}
+
+void CommandList::DrawIndexed(uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex) {
+	Command command = MakeCommand(COMMAND_DRAW_INDEXED);
+	command.args[0] = indexCount;
+	command.args[1] = firstIndex;
+	command.args[2] = uint32_t(baseVertex);
+	m_Commands.push_back(command);
+}
+
+void CommandList::MultiDrawIndexedIndirect(size_t offset, uint32_t drawCount) {
+	Command command = MakeCommand(COMMAND_MULTI_DRAW_INDEXED_INDIRECT);
+	command.offset = offset;
+	command.args[0] = drawCount;
+	m_Commands.push_back(command);
+}
+
+void CommandList::Append(const CommandList& commands) {
+	size_t dataOffset = m_Data.size();
+	m_Data.insert(m_Data.end(), commands.m_Data.begin(), commands.m_Data.end());
+	for (Command command : commands.m_Commands) {
+		if (command.type == COMMAND_UPDATE_BUFFER)
+			command.offset += dataOffset;
+		m_Commands.push_back(command);
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "RenderDevice.h"
+
+enum CommandType : uint32_t {
+	COMMAND_CLEAR,
+	COMMAND_BIND_PIPELINE,
+	COMMAND_BIND_VERTEX_BUFFER,
+	COMMAND_BIND_INDEX_BUFFER,
+	COMMAND_BIND_TEXTURE,
+	COMMAND_BIND_STORAGE_BUFFER,
+	COMMAND_BIND_INDIRECT_BUFFER,
+	COMMAND_UPDATE_BUFFER,
+	COMMAND_SET_UNIFORM_FLOAT,
+	COMMAND_SET_UNIFORM_INT,
+	COMMAND_SET_UNIFORM_UINT,
+	COMMAND_SET_UNIFORM_VEC3,
+	COMMAND_DRAW_INDEXED,
+	COMMAND_MULTI_DRAW_INDEXED_INDIRECT,
+};
+
+// One recorded command; which fields are used depends on the type, see the
+// CommandList methods.
+struct Command {
+	CommandType type;
+	uint32_t handle = RENDER_NONE;
+	uint32_t args[3] = { 0, 0, 0 };
+	glm::vec4 value = glm::vec4(0);
+	// Byte range in the list's data (COMMAND_UPDATE_BUFFER) or in the bound
+	// buffer.
+	size_t offset = 0;
+	size_t size = 0;
+	const char* name = nullptr;
+};
+
+// Commands for a RenderBackend, recorded without touching the graphics API so
+// any thread can fill a list; the thread owning the context submits it.
+// Handles are only resolved at submission. Draws use the last bound
+// pipeline, buffers and textures; vertex and index buffers must be bound
+// after the pipeline. Reset() keeps the memory for the next frame.
+class CommandList
+{
+private:
+	std::vector<Command> m_Commands;
+	// Contents of the buffer updates.
+	std::vector<uint8_t> m_Data;
+
+public:
+	void Reset();
+
+	// Clears the color and depth of the frame.
+	void Clear(const glm::vec3& color, float depth = 1);
+	void BindPipeline(uint32_t pipeline);
+	// Vertex buffer binding 0, with the stride of the bound pipeline.
+	void BindVertexBuffer(uint32_t buffer, size_t offset = 0);
+	// 32-bit indices.
+	void BindIndexBuffer(uint32_t buffer);
+	void BindTexture(uint32_t slot, uint32_t texture);
+	// `size` = 0 binds the whole buffer.
+	void BindStorageBuffer(uint32_t slot, uint32_t buffer, size_t offset = 0, size_t size = 0);
+	void BindIndirectBuffer(uint32_t buffer);
+	// Replaces the contents of a BUFFER_STREAM buffer with a copy of `data`.
+	void UpdateBuffer(uint32_t buffer, const void* data, size_t size);
+	// Uniforms of the bound pipeline. Names are kept by pointer, string
+	// literals or strings outliving the submission.
+	void SetUniform(const char* name, float value);
+	void SetUniform(const char* name, int32_t value);
+	void SetUniform(const char* name, uint32_t value);
+	void SetUniform(const char* name, const glm::vec3& value);
+	void DrawIndexed(uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex);
+	// `drawCount` DrawElementsIndirectCommand from byte `offset` of the
+	// indirect buffer.
+	void MultiDrawIndexedIndirect(size_t offset, uint32_t drawCount);
+
+	// Appends the commands of another list, for merging lists recorded in
+	// parallel.
+	void Append(const CommandList& commands);
+
+	inline const std::vector<Command>& GetCommands() const { return m_Commands; }
+	inline const uint8_t* GetData() const { return m_Data.data(); }
+	inline bool IsEmpty() const { return m_Commands.empty(); }
+};
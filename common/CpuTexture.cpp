@@ -0,0 +1,53 @@
+#include "CpuTexture.h"
+
+#include <cmath>
+
+namespace {
+
+float SrgbToLinear(float c) {
+	return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+} // namespace
+
+void CpuTexture::Create(int width, int height, const uint8_t* rgba) {
+	float table[256];
+	for (int i = 0; i < 256; i++)
+		table[i] = SrgbToLinear(float(i) / 255.f);
+	m_Width = width;
+	m_Height = height;
+	m_Texels.resize(size_t(width) * size_t(height));
+	for (size_t i = 0; i < m_Texels.size(); i++) {
+		// Alpha is stored linearly by GL_SRGB8_ALPHA8.
+		m_Texels[i] = glm::vec4(table[rgba[4 * i + 0]], table[rgba[4 * i + 1]], table[rgba[4 * i + 2]], float(rgba[4 * i + 3]) / 255.f);
+	}
+}
+
+void CpuTexture::Destroy() {
+	m_Width = 0;
+	m_Height = 0;
+	m_Texels.clear();
+	m_Texels.shrink_to_fit();
+}
+
+glm::vec4 CpuTexture::Sample(const glm::vec2& texCoords) const {
+	if (m_Texels.empty())
+		return glm::vec4(1);
+	// Texel centers are at half integers, wrap both neighbours.
+	float x = texCoords.x * float(m_Width) - 0.5f;
+	float y = texCoords.y * float(m_Height) - 0.5f;
+	float fx = std::floor(x), fy = std::floor(y);
+	float wx = x - fx, wy = y - fy;
+	int x0 = int(fx) % m_Width, y0 = int(fy) % m_Height;
+	if (x0 < 0)
+		x0 += m_Width;
+	if (y0 < 0)
+		y0 += m_Height;
+	int x1 = x0 + 1 == m_Width ? 0 : x0 + 1;
+	int y1 = y0 + 1 == m_Height ? 0 : y0 + 1;
+	const glm::vec4* row0 = &m_Texels[size_t(y0) * size_t(m_Width)];
+	const glm::vec4* row1 = &m_Texels[size_t(y1) * size_t(m_Width)];
+	glm::vec4 top = row0[x0] + (row0[x1] - row0[x0]) * wx;
+	glm::vec4 bottom = row1[x0] + (row1[x1] - row1[x0]) * wx;
+	return top + (bottom - top) * wy;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+// RGBA8 sRGB texture kept in memory for the CPU renderers, sampled the way
+// the GL textures are set up in main.cpp (GL_SRGB8_ALPHA8, GL_REPEAT,
+// bilinear): texels are decoded to linear before filtering.
+class CpuTexture
+{
+private:
+	int m_Width = 0;
+	int m_Height = 0;
+	// Linear RGBA, converted once at creation.
+	std::vector<glm::vec4> m_Texels;
+
+public:
+	// `rgba` holds width * height texels, the first row at t = 0 as with
+	// glTexImage2D.
+	void Create(int width, int height, const uint8_t* rgba);
+	void Destroy();
+
+	// Same coordinates as texture2D() in the shaders.
+	glm::vec4 Sample(const glm::vec2& texCoords) const;
+
+	inline bool IsEmpty() const { return m_Texels.empty(); }
+	inline int GetWidth() const { return m_Width; }
+	inline int GetHeight() const { return m_Height; }
+};
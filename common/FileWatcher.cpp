@@ -0,0 +1,132 @@
+#include "FileWatcher.h"
+
+#include <chrono>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Time between two checks, and the longest Stop() waits for the thread.
+const int POLL_MILLISECONDS = 100;
+
+// Last write time at the file system's resolution (nanoseconds, 100 ns on
+// Windows), so two saves within a second are both seen; -1 if missing.
+int64_t GetModificationTime(const std::string& path) {
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA info;
+	if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &info))
+		return -1;
+	return int64_t((uint64_t(info.ftLastWriteTime.dwHighDateTime) << 32) | info.ftLastWriteTime.dwLowDateTime);
+#else
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0)
+		return -1;
+#ifdef __APPLE__
+	return int64_t(info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+	return int64_t(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+#endif
+}
+
+// Directory part of `path`, with its separator; empty for a bare file name.
+std::string GetDirectory(const std::string& path) {
+	size_t separator = path.find_last_of("/\\");
+	return separator == std::string::npos ? std::string() : path.substr(0, separator + 1);
+}
+
+} // namespace
+
+bool FileWatcher::Start() {
+	Stop();
+	m_Stopping = false;
+#ifdef __linux__
+	m_Inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m_Inotify < 0)
+		return false;
+#endif
+	m_Thread = std::thread(&FileWatcher::Run, this);
+	return true;
+}
+
+void FileWatcher::Stop() {
+	if (!m_Thread.joinable())
+		return;
+	m_Stopping = true;
+	m_Thread.join();
+#ifdef __linux__
+	close(m_Inotify);
+#endif
+	m_Inotify = -1;
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Directories.clear();
+}
+
+void FileWatcher::Watch(const std::string& path) {
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (m_Files.count(path))
+		return;
+	m_Files[path] = GetModificationTime(path);
+#ifdef __linux__
+	if (m_Inotify < 0)
+		return;
+	std::string directory = GetDirectory(path);
+	int watch = inotify_add_watch(m_Inotify, directory.empty() ? "." : directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (watch >= 0)
+		m_Directories[watch].insert(directory);
+#endif
+}
+
+std::vector<std::string> FileWatcher::TakeChanged() {
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	std::vector<std::string> changed(m_Changed.begin(), m_Changed.end());
+	m_Changed.clear();
+	return changed;
+}
+
+void FileWatcher::Run() {
+	while (!m_Stopping) {
+#ifdef __linux__
+		pollfd descriptor = { m_Inotify, POLLIN, 0 };
+		if (poll(&descriptor, 1, POLL_MILLISECONDS) <= 0)
+			continue;
+		alignas(inotify_event) char events[4096];
+		ssize_t size;
+		while ((size = read(m_Inotify, events, sizeof(events))) > 0) {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			for (ssize_t offset = 0; offset < size;) {
+				const inotify_event* event = reinterpret_cast<const inotify_event*>(events + offset);
+				offset += ssize_t(sizeof(inotify_event) + event->len);
+				auto directories = m_Directories.find(event->wd);
+				if (directories == m_Directories.end() || !event->len)
+					continue;
+				for (const std::string& directory : directories->second) {
+					std::string path = directory + event->name;
+					if (m_Files.count(path))
+						m_Changed.insert(path);
+				}
+			}
+		}
+#else
+		std::this_thread::sleep_for(std::chrono::milliseconds(POLL_MILLISECONDS));
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		for (auto& file : m_Files) {
+			int64_t time = GetModificationTime(file.first);
+			if (time != file.second) {
+				file.second = time;
+				m_Changed.insert(file.first);
+			}
+		}
+#endif
+	}
+}
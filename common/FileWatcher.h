@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Reports files changed on disk, from a thread: on Linux the directories of
+// the watched files are watched with inotify (editors often replace a file
+// instead of writing it), elsewhere the modification times are polled. The
+// changes are collected until the render thread takes them between frames.
+class FileWatcher
+{
+private:
+	std::thread m_Thread;
+	std::atomic<bool> m_Stopping{ false };
+	std::mutex m_Mutex;
+	// Watched files, with their modification time when polled.
+	std::map<std::string, int64_t> m_Files;
+	std::set<std::string> m_Changed;
+	// Directory of each inotify watch, separator included, as spelled by
+	// each watched path in it: "a/b/" and "a/./b/" share one watch.
+	std::map<int, std::set<std::string>> m_Directories;
+	int m_Inotify = -1;
+
+	void Run();
+
+public:
+	FileWatcher() {}
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+	~FileWatcher() { Stop(); }
+
+	bool Start();
+	void Stop();
+
+	// `path` is reported as given; may be called from any thread once
+	// started.
+	void Watch(const std::string& path);
+	// The watched files changed since the last call, each once.
+	std::vector<std::string> TakeChanged();
+};
@@ -0,0 +1,578 @@
+#include "GLRenderBackend.h"
+#include "CommandList.h"
+#include "ShaderPreprocessor.h"
+#define GLEW_STATIC
+#include "GL/glew.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace {
+
+GLenum GetAttributeType(AttributeType type) {
+	switch (type) {
+	case ATTRIBUTE_HALF_FLOAT: return GL_HALF_FLOAT;
+	case ATTRIBUTE_SHORT: return GL_SHORT;
+	case ATTRIBUTE_UNSIGNED_SHORT: return GL_UNSIGNED_SHORT;
+	default: return GL_FLOAT;
+	}
+}
+
+void SetEnabled(GLenum capability, bool enabled) {
+	if (enabled)
+		glEnable(capability);
+	else
+		glDisable(capability);
+}
+
+// Allocates the storage of a buffer created with `flags`, returns where it is
+// mapped for BUFFER_PERSISTENT.
+void* AllocateStorage(GLuint name, size_t size, const void* data, uint32_t flags) {
+	if (flags & BUFFER_PERSISTENT) {
+		const GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glNamedBufferStorage(name, GLsizeiptr(size), data, access);
+		return glMapNamedBufferRange(name, 0, GLsizeiptr(size), access);
+	}
+	if (flags & BUFFER_STREAM) {
+		// Respecified by every UpdateBuffer, so it cannot be immutable
+		glNamedBufferData(name, GLsizeiptr(size), data, GL_STREAM_DRAW);
+	} else {
+		// Immutable storage, the driver never reallocates it; written only
+		// through glNamedBufferSubData and copies. Empty storage is invalid
+		glNamedBufferStorage(name, GLsizeiptr(std::max<size_t>(size, 1)), data, GL_DYNAMIC_STORAGE_BIT);
+	}
+	return nullptr;
+}
+
+// Takes a released slot or appends one.
+template <typename T>
+uint32_t AllocateSlot(std::vector<T>& slots, std::vector<uint32_t>& freeSlots) {
+	if (!freeSlots.empty()) {
+		uint32_t slot = freeSlots.back();
+		freeSlots.pop_back();
+		return slot;
+	}
+	slots.emplace_back();
+	return uint32_t(slots.size() - 1);
+}
+
+} // namespace
+
+bool GLRenderBackend::Create() {
+	std::cout << "Graphic card: " << glGetString(GL_RENDERER) << std::endl;
+	std::cout << "OpenGL: " << glGetString(GL_VERSION) << std::endl;
+	std::cout << "GLEW: " << glewGetString(GLEW_VERSION) << std::endl;
+	std::cout << "GLSL: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << std::endl;
+	std::cout << "Extensions: " << glGetString(GL_EXTENSIONS) << std::endl;
+	if (!GLEW_VERSION_4_5 && !GLEW_ARB_direct_state_access) {
+		std::cerr << "OpenGL 4.5 or ARB_direct_state_access is required" << std::endl;
+		return false;
+	}
+	// The 3d shaders find the object of each draw with gl_DrawIDARB; without
+	// it no pipeline would link
+	if (!GLEW_ARB_shader_draw_parameters) {
+		std::cerr << "ARB_shader_draw_parameters is required" << std::endl;
+		return false;
+	}
+	glEnable(GL_SCISSOR_TEST);
+	glEnable(GL_FRAMEBUFFER_SRGB);
+	GLint alignment = 0;
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	m_StorageBufferAlignment = std::max<size_t>(size_t(alignment), 4);
+	// As many compiler threads as the driver likes, see GLShader::IsReady()
+	if (GLEW_KHR_parallel_shader_compile)
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	return true;
+}
+
+void GLRenderBackend::Destroy() {
+	m_UploadThread.Stop();
+	m_UploadThread.TakeFinished(m_FinishedUploads);
+	for (GLUpload& upload : m_FinishedUploads) {
+		glDeleteSync(GLsync(upload.fence));
+		glDeleteTextures(1, &upload.texture);
+		glDeleteBuffers(1, &upload.staging);
+	}
+	m_FinishedUploads.clear();
+	m_Uploads.clear();
+	for (uint32_t i = 0; i < m_Buffers.size(); i++)
+		DestroyBuffer(i);
+	for (uint32_t i = 0; i < m_Textures.size(); i++)
+		DestroyTexture(i);
+	for (uint32_t i = 0; i < m_Pipelines.size(); i++)
+		DestroyPipeline(i);
+	for (auto& stage : m_ShaderStages)
+		glDeleteShader(stage.second.shader);
+	m_ShaderStages.clear();
+	for (void* fence : m_Fences)
+		if (fence)
+			glDeleteSync(GLsync(fence));
+	m_Buffers.clear();
+	m_Textures.clear();
+	m_Pipelines.clear();
+	m_Fences.clear();
+	m_FreeBuffers.clear();
+	m_FreeTextures.clear();
+	m_FreePipelines.clear();
+	m_FreeFences.clear();
+}
+
+uint32_t GLRenderBackend::CreateBuffer(size_t size, const void* data, uint32_t flags) {
+	uint32_t buffer = AllocateSlot(m_Buffers, m_FreeBuffers);
+	Buffer& slot = m_Buffers[buffer];
+	slot.flags = flags;
+	slot.size = size;
+	glCreateBuffers(1, &slot.name);
+	slot.mapped = AllocateStorage(slot.name, size, data, flags);
+	return buffer;
+}
+
+void GLRenderBackend::WriteBuffer(uint32_t buffer, size_t offset, const void* data, size_t size) {
+	if (buffer < m_Buffers.size() && size)
+		glNamedBufferSubData(m_Buffers[buffer].name, GLintptr(offset), GLsizeiptr(size), data);
+}
+
+void GLRenderBackend::CopyBuffer(uint32_t source, size_t sourceOffset, uint32_t destination, size_t destinationOffset, size_t size) {
+	if (source < m_Buffers.size() && destination < m_Buffers.size() && size)
+		glCopyNamedBufferSubData(m_Buffers[source].name, m_Buffers[destination].name, GLintptr(sourceOffset),
+			GLintptr(destinationOffset), GLsizeiptr(size));
+}
+
+void GLRenderBackend::ResizeBuffer(uint32_t buffer, size_t size, size_t keep) {
+	if (buffer >= m_Buffers.size() || !m_Buffers[buffer].name || m_Buffers[buffer].mapped)
+		return;
+	Buffer& slot = m_Buffers[buffer];
+	GLuint name;
+	glCreateBuffers(1, &name);
+	AllocateStorage(name, size, nullptr, slot.flags);
+	keep = std::min(keep, std::min(size, slot.size));
+	if (keep)
+		glCopyNamedBufferSubData(slot.name, name, 0, 0, GLsizeiptr(keep));
+	glDeleteBuffers(1, &slot.name);
+	slot.name = name;
+	slot.size = size;
+}
+
+void GLRenderBackend::DestroyBuffer(uint32_t buffer) {
+	if (buffer >= m_Buffers.size())
+		return;
+	for (auto& upload : m_Uploads)
+		if (upload.second.buffer == buffer)
+			upload.second.buffer = RENDER_NONE;
+	if (!m_Buffers[buffer].name)
+		return;
+	if (m_Buffers[buffer].mapped)
+		glUnmapNamedBuffer(m_Buffers[buffer].name);
+	glDeleteBuffers(1, &m_Buffers[buffer].name);
+	m_Buffers[buffer] = Buffer();
+	m_FreeBuffers.push_back(buffer);
+}
+
+void* GLRenderBackend::GetMappedPointer(uint32_t buffer) const {
+	return buffer < m_Buffers.size() ? m_Buffers[buffer].mapped : nullptr;
+}
+
+uint32_t GLRenderBackend::CreateTextureName(const TextureDesc& desc, bool unpackBuffer) {
+	GLsizei levels = 1;
+	if (desc.mipmaps)
+		while ((std::max(desc.width, desc.height) >> levels) > 0)
+			levels++;
+
+	GLuint name;
+	glCreateTextures(GL_TEXTURE_2D, 1, &name);
+	glTextureStorage2D(name, levels, desc.format == TEXTURE_SRGB8_ALPHA8 ? GL_SRGB8_ALPHA8 : GL_RGBA8, desc.width, desc.height);
+	if (desc.data || unpackBuffer)
+		glTextureSubImage2D(name, 0, 0, 0, desc.width, desc.height, GL_RGBA, GL_UNSIGNED_BYTE, unpackBuffer ? nullptr : desc.data);
+	if (desc.mipmaps) {
+		glTextureParameteri(name, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glGenerateTextureMipmap(name);
+	} else {
+		glTextureParameteri(name, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	}
+	return name;
+}
+
+uint32_t GLRenderBackend::CreateTexture(const TextureDesc& desc) {
+	uint32_t texture = AllocateSlot(m_Textures, m_FreeTextures);
+	m_Textures[texture] = CreateTextureName(desc);
+	return texture;
+}
+
+void GLRenderBackend::DestroyTexture(uint32_t texture) {
+	if (texture >= m_Textures.size())
+		return;
+	// A texture still uploading has no name yet
+	bool uploading = false;
+	for (auto& upload : m_Uploads) {
+		if (upload.second.texture == texture) {
+			upload.second.texture = RENDER_NONE;
+			uploading = true;
+		}
+	}
+	if (!m_Textures[texture] && !uploading)
+		return;
+	glDeleteTextures(1, &m_Textures[texture]);
+	m_Textures[texture] = 0;
+	m_FreeTextures.push_back(texture);
+}
+
+void GLRenderBackend::StartUploadThread(std::function<void()> attach, std::function<void()> detach) {
+	m_UploadThread.Start(std::move(attach), std::move(detach));
+}
+
+uint32_t GLRenderBackend::WriteBufferAsync(uint32_t buffer, size_t offset, std::shared_ptr<const void> data, size_t size) {
+	uint32_t upload = m_NextUpload++;
+	if (!m_UploadThread.IsRunning()) {
+		WriteBuffer(buffer, offset, data.get(), size);
+		return upload;
+	}
+	Upload& pending = m_Uploads[upload];
+	pending.buffer = buffer;
+	pending.offset = offset;
+	m_UploadThread.UploadBuffer(upload, std::move(data), size);
+	return upload;
+}
+
+uint32_t GLRenderBackend::CreateTextureAsync(const TextureDesc& desc, std::shared_ptr<const void> data, uint32_t* upload) {
+	uint32_t id = m_NextUpload++;
+	if (upload)
+		*upload = id;
+	if (!m_UploadThread.IsRunning()) {
+		TextureDesc immediate = desc;
+		immediate.data = data.get();
+		return CreateTexture(immediate);
+	}
+	uint32_t texture = AllocateSlot(m_Textures, m_FreeTextures);
+	m_Textures[texture] = 0;
+	m_Uploads[id].texture = texture;
+	m_UploadThread.UploadTexture(id, desc, std::move(data));
+	return texture;
+}
+
+void GLRenderBackend::UpdateUploads() {
+	m_UploadThread.TakeFinished(m_FinishedUploads);
+	size_t pending = 0;
+	for (const GLUpload& finished : m_FinishedUploads) {
+		GLint status = GL_UNSIGNALED;
+		glGetSynciv(GLsync(finished.fence), GL_SYNC_STATUS, 1, nullptr, &status);
+		if (status != GL_SIGNALED) {
+			m_FinishedUploads[pending++] = finished;
+			continue;
+		}
+		glDeleteSync(GLsync(finished.fence));
+
+		// Lands where the target is now: a buffer may have been resized since
+		auto found = m_Uploads.find(finished.id);
+		Upload target = found != m_Uploads.end() ? found->second : Upload();
+		if (finished.texture) {
+			if (target.texture != RENDER_NONE)
+				m_Textures[target.texture] = finished.texture;
+			else
+				glDeleteTextures(1, &finished.texture);
+		} else {
+			if (target.buffer != RENDER_NONE && finished.size)
+				glCopyNamedBufferSubData(finished.staging, m_Buffers[target.buffer].name, 0, GLintptr(target.offset),
+					GLsizeiptr(finished.size));
+			glDeleteBuffers(1, &finished.staging);
+		}
+		if (found != m_Uploads.end())
+			m_Uploads.erase(found);
+	}
+	m_FinishedUploads.resize(pending);
+}
+
+bool GLRenderBackend::CompileStage(ShaderStage& stage) {
+	auto start = std::chrono::steady_clock::now();
+	ShaderSource source;
+	bool read = PreprocessShader(stage.path, stage.defines, source);
+	auto preprocessed = std::chrono::steady_clock::now();
+	m_ShaderStats.readSeconds += std::chrono::duration<double>(preprocessed - start).count();
+	if (!read)
+		return false;
+	stage.files = source.files;
+	stage.shader = GLShader::BeginCompile(stage.type, source.text.data(), source.text.size());
+	m_ShaderStats.issueSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - preprocessed).count();
+	m_ShaderStats.stages++;
+	m_ShaderStats.files += uint32_t(source.files.size());
+	m_ShaderStats.bytes += source.bytes;
+	return true;
+}
+
+const GLRenderBackend::ShaderStage* GLRenderBackend::GetStage(uint32_t type, const std::string& path,
+	const std::vector<std::string>& defines, std::string& key) {
+	std::vector<std::string> sorted = defines;
+	std::sort(sorted.begin(), sorted.end());
+	sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+	key = std::to_string(type) + "|" + path;
+	for (const std::string& define : sorted)
+		key += "|" + define;
+
+	auto found = m_ShaderStages.find(key);
+	if (found != m_ShaderStages.end())
+		return &found->second;
+	ShaderStage stage;
+	stage.type = type;
+	stage.path = path;
+	stage.defines = sorted;
+	if (!CompileStage(stage))
+		return nullptr;
+	return &(m_ShaderStages[key] = std::move(stage));
+}
+
+bool GLRenderBackend::BeginPipeline(Pipeline& pipeline) {
+	const PipelineDesc& desc = pipeline.desc;
+	const ShaderStage* vertex = GetStage(GL_VERTEX_SHADER, desc.vertexShader, desc.defines, pipeline.vertexStage);
+	const ShaderStage* fragment = vertex ? GetStage(GL_FRAGMENT_SHADER, desc.fragmentShader, desc.defines, pipeline.fragmentStage) : nullptr;
+	if (!fragment) {
+		std::cerr << "Failed to create pipeline: " << desc.vertexShader << ", " << desc.fragmentShader << std::endl;
+		return false;
+	}
+	auto start = std::chrono::steady_clock::now();
+	pipeline.building = GLShader();
+	pipeline.building.BeginLink(vertex->shader, fragment->shader);
+	pipeline.pending = true;
+	m_ShaderStats.issueSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return true;
+}
+
+void GLRenderBackend::PollPipeline(Pipeline& pipeline) {
+	if (!pipeline.pending || !pipeline.building.IsReady())
+		return;
+	pipeline.pending = false;
+	auto start = std::chrono::steady_clock::now();
+	bool built = pipeline.building.Finish();
+	m_ShaderStats.waitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (!built) {
+		for (const std::string* key : { &pipeline.vertexStage, &pipeline.fragmentStage }) {
+			const ShaderStage& stage = m_ShaderStages[*key];
+			if (!GLShader::IsCompiled(stage.shader))
+				std::cerr << "Error compiling shader: " << AnnotateShaderLog(GLShader::GetShaderLog(stage.shader), stage.files) << std::endl;
+		}
+		std::cerr << "Failed to build pipeline" << (pipeline.vao ? ", keeping the current one: " : ": ")
+			<< pipeline.desc.vertexShader << ", " << pipeline.desc.fragmentShader << std::endl;
+		return;
+	}
+
+	// The attribute and uniform locations may have moved in the new program
+	if (pipeline.vao) {
+		pipeline.shader.Destroy();
+		glDeleteVertexArrays(1, &pipeline.vao);
+	}
+	pipeline.shader = pipeline.building;
+	pipeline.building = GLShader();
+	pipeline.uniforms.clear();
+
+	// The vertex format lives in the VAO, buffers are attached when drawing
+	glCreateVertexArrays(1, &pipeline.vao);
+	GLuint program = pipeline.shader.GetProgram();
+	for (const VertexAttribute& attribute : pipeline.desc.attributes) {
+		GLint location = attribute.name ? glGetAttribLocation(program, attribute.name) : GLint(attribute.location);
+		if (location < 0)
+			continue;
+		glVertexArrayAttribFormat(pipeline.vao, GLuint(location), GLint(attribute.components), GetAttributeType(attribute.type),
+			attribute.normalized ? GL_TRUE : GL_FALSE, attribute.offset);
+		glVertexArrayAttribBinding(pipeline.vao, GLuint(location), 0);
+		glEnableVertexArrayAttrib(pipeline.vao, GLuint(location));
+	}
+}
+
+uint32_t GLRenderBackend::CreatePipeline(const PipelineDesc& desc) {
+	uint32_t pipeline = AllocateSlot(m_Pipelines, m_FreePipelines);
+	Pipeline& slot = m_Pipelines[pipeline];
+	slot.desc = desc;
+	slot.vertexStride = desc.vertexStride;
+	slot.depthTest = desc.depthTest;
+	slot.cullFace = desc.cullFace;
+	slot.blend = desc.blend;
+	if (!BeginPipeline(slot)) {
+		slot = Pipeline();
+		m_FreePipelines.push_back(pipeline);
+		return RENDER_NONE;
+	}
+	slot.alive = true;
+	return pipeline;
+}
+
+std::vector<std::string> GLRenderBackend::GetPipelineFiles(uint32_t pipeline) const {
+	std::vector<std::string> files;
+	if (pipeline >= m_Pipelines.size() || !m_Pipelines[pipeline].alive)
+		return files;
+	for (const std::string* key : { &m_Pipelines[pipeline].vertexStage, &m_Pipelines[pipeline].fragmentStage }) {
+		auto stage = m_ShaderStages.find(*key);
+		if (stage == m_ShaderStages.end())
+			continue;
+		for (const std::string& file : stage->second.files)
+			if (std::find(files.begin(), files.end(), file) == files.end())
+				files.push_back(file);
+	}
+	return files;
+}
+
+size_t GLRenderBackend::ReloadShaderFile(const std::string& path) {
+	std::vector<std::string> changed;
+	for (auto& entry : m_ShaderStages) {
+		ShaderStage& stage = entry.second;
+		if (std::find(stage.files.begin(), stage.files.end(), path) == stage.files.end())
+			continue;
+		ShaderStage rebuilt = stage;
+		if (!CompileStage(rebuilt)) {
+			std::cerr << "Keeping the current " << stage.path << std::endl;
+			continue;
+		}
+		// The programs linked with the old shader keep working until they
+		// are replaced
+		glDeleteShader(stage.shader);
+		stage = std::move(rebuilt);
+		changed.push_back(entry.first);
+	}
+
+	size_t rebuilt = 0;
+	auto isChanged = [&changed](const std::string& key) { return std::find(changed.begin(), changed.end(), key) != changed.end(); };
+	for (Pipeline& slot : m_Pipelines) {
+		if (!slot.alive || (!isChanged(slot.vertexStage) && !isChanged(slot.fragmentStage)))
+			continue;
+		// A build still in progress used the old stages
+		if (slot.pending)
+			slot.building.Destroy();
+		slot.pending = false;
+		if (BeginPipeline(slot))
+			rebuilt++;
+	}
+	return rebuilt;
+}
+
+void GLRenderBackend::DestroyPipeline(uint32_t pipeline) {
+	if (pipeline >= m_Pipelines.size() || !m_Pipelines[pipeline].alive)
+		return;
+	Pipeline& slot = m_Pipelines[pipeline];
+	if (slot.pending)
+		slot.building.Destroy();
+	if (slot.vao) {
+		slot.shader.Destroy();
+		glDeleteVertexArrays(1, &slot.vao);
+	}
+	slot = Pipeline();
+	m_FreePipelines.push_back(pipeline);
+}
+
+int32_t GLRenderBackend::GetUniformLocation(Pipeline& pipeline, const char* name) {
+	auto found = pipeline.uniforms.find(name);
+	if (found != pipeline.uniforms.end())
+		return found->second;
+	int32_t location = glGetUniformLocation(pipeline.shader.GetProgram(), name);
+	pipeline.uniforms[name] = location;
+	return location;
+}
+
+void GLRenderBackend::Submit(const CommandList& commands) {
+	const uint8_t* data = commands.GetData();
+	Pipeline* pipeline = nullptr;
+	GLuint program = 0;
+	auto buffer = [this](uint32_t handle) { return handle < m_Buffers.size() ? m_Buffers[handle].name : 0u; };
+
+	for (const Command& command : commands.GetCommands()) {
+		switch (command.type) {
+		case COMMAND_CLEAR:
+			glClearColor(command.value.x, command.value.y, command.value.z, 1);
+			glClearDepth(command.value.w);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			break;
+		case COMMAND_BIND_PIPELINE:
+			pipeline = command.handle < m_Pipelines.size() && m_Pipelines[command.handle].alive ? &m_Pipelines[command.handle] : nullptr;
+			if (pipeline)
+				PollPipeline(*pipeline);
+			// Nothing is drawn until the first build is done
+			if (pipeline && !pipeline->vao)
+				pipeline = nullptr;
+			if (!pipeline)
+				break;
+			program = pipeline->shader.GetProgram();
+			glUseProgram(program);
+			glBindVertexArray(pipeline->vao);
+			SetEnabled(GL_DEPTH_TEST, pipeline->depthTest);
+			SetEnabled(GL_CULL_FACE, pipeline->cullFace);
+			SetEnabled(GL_BLEND, pipeline->blend);
+			if (pipeline->blend)
+				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			break;
+		case COMMAND_BIND_VERTEX_BUFFER:
+			if (pipeline)
+				glVertexArrayVertexBuffer(pipeline->vao, 0, buffer(command.handle), GLintptr(command.offset), GLsizei(pipeline->vertexStride));
+			break;
+		case COMMAND_BIND_INDEX_BUFFER:
+			if (pipeline)
+				glVertexArrayElementBuffer(pipeline->vao, buffer(command.handle));
+			break;
+		case COMMAND_BIND_TEXTURE:
+			glBindTextureUnit(command.args[0], command.handle < m_Textures.size() ? m_Textures[command.handle] : 0);
+			break;
+		case COMMAND_BIND_STORAGE_BUFFER:
+			if (command.size)
+				glBindBufferRange(GL_SHADER_STORAGE_BUFFER, command.args[0], buffer(command.handle), GLintptr(command.offset),
+					GLsizeiptr(command.size));
+			else
+				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, command.args[0], buffer(command.handle));
+			break;
+		case COMMAND_BIND_INDIRECT_BUFFER:
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer(command.handle));
+			break;
+		case COMMAND_UPDATE_BUFFER:
+			if (command.handle < m_Buffers.size()) {
+				glNamedBufferData(m_Buffers[command.handle].name, GLsizeiptr(command.size), data + command.offset, GL_STREAM_DRAW);
+				m_Buffers[command.handle].size = command.size;
+			}
+			break;
+		case COMMAND_SET_UNIFORM_FLOAT:
+			if (pipeline)
+				glProgramUniform1f(program, GetUniformLocation(*pipeline, command.name), command.value.x);
+			break;
+		case COMMAND_SET_UNIFORM_INT:
+			if (pipeline)
+				glProgramUniform1i(program, GetUniformLocation(*pipeline, command.name), GLint(command.args[0]));
+			break;
+		case COMMAND_SET_UNIFORM_UINT:
+			if (pipeline)
+				glProgramUniform1ui(program, GetUniformLocation(*pipeline, command.name), command.args[0]);
+			break;
+		case COMMAND_SET_UNIFORM_VEC3:
+			if (pipeline)
+				glProgramUniform3f(program, GetUniformLocation(*pipeline, command.name), command.value.x, command.value.y, command.value.z);
+			break;
+		case COMMAND_DRAW_INDEXED:
+			if (pipeline)
+				glDrawElementsBaseVertex(GL_TRIANGLES, GLsizei(command.args[0]), GL_UNSIGNED_INT,
+					(void*)(size_t(command.args[1]) * sizeof(uint32_t)), GLint(command.args[2]));
+			break;
+		case COMMAND_MULTI_DRAW_INDEXED_INDIRECT:
+			if (pipeline)
+				glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)command.offset, GLsizei(command.args[0]), 0);
+			break;
+		}
+	}
+	glBindVertexArray(0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+uint32_t GLRenderBackend::InsertFence() {
+	uint32_t fence = AllocateSlot(m_Fences, m_FreeFences);
+	m_Fences[fence] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	return fence;
+}
+
+void GLRenderBackend::WaitFence(uint32_t fence) {
+	if (fence >= m_Fences.size() || !m_Fences[fence])
+		return;
+	GLsync sync = GLsync(m_Fences[fence]);
+	// The first wait flushes the commands so the fence is reached
+	GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+	for (;;) {
+		GLenum result = glClientWaitSync(sync, flags, 1000000000);
+		if (result != GL_TIMEOUT_EXPIRED)
+			break;
+		flags = 0;
+	}
+	glDeleteSync(sync);
+	m_Fences[fence] = nullptr;
+	m_FreeFences.push_back(fence);
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "GLShader.h"
+#include "GLUploadThread.h"
+#include "RenderBackend.h"
+
+// Shader loading on the render thread so far, reported at startup.
+struct ShaderLoadStats {
+	uint32_t stages = 0;
+	// Read and preprocessed, includes counted once per stage.
+	uint32_t files = 0;
+	size_t bytes = 0;
+	double readSeconds = 0;
+	// Issuing the compiles and links.
+	double issueSeconds = 0;
+	// Blocked in GLShader::Finish(), the builds not done in the
+	// background.
+	double waitSeconds = 0;
+};
+
+// RenderBackend over OpenGL 4.5 direct state access: objects are created and
+// edited by name (glCreate*, glNamed*, glTexture*) without touching the
+// bindings, and each pipeline owns a VAO holding its vertex format that the
+// vertex and index buffers are attached to at draw time. Asynchronous uploads
+// go through a GLUploadThread once StartUploadThread() is called.
+class GLRenderBackend : public RenderBackend
+{
+private:
+	struct Buffer
+	{
+		uint32_t name = 0;
+		uint32_t flags = 0;
+		size_t size = 0;
+		void* mapped = nullptr;
+	};
+
+	// What an upload not done yet fills, RENDER_NONE if it was destroyed
+	// meanwhile.
+	struct Upload
+	{
+		uint32_t buffer = RENDER_NONE;
+		size_t offset = 0;
+		uint32_t texture = RENDER_NONE;
+	};
+
+	// Shader compiled from a file for one define set, shared by the
+	// pipelines of that permutation.
+	struct ShaderStage
+	{
+		uint32_t shader = 0;
+		uint32_t type = 0;
+		std::string path;
+		std::vector<std::string> defines;
+		// The preprocessed source read them, see ShaderSource.
+		std::vector<std::string> files;
+	};
+
+	// Built asynchronously: `building` is linked in the background and
+	// replaces `shader` once done (see PollPipeline()), the current program
+	// drawing meanwhile. vao is 0 until the first build is done.
+	struct Pipeline
+	{
+		// Kept to build it again, see ReloadShaderFile().
+		PipelineDesc desc;
+		bool alive = false;
+		GLShader shader;
+		GLShader building;
+		bool pending = false;
+		// Keys of its stages in m_ShaderStages.
+		std::string vertexStage;
+		std::string fragmentStage;
+		uint32_t vao = 0;
+		uint32_t vertexStride = 0;
+		bool depthTest = true;
+		bool cullFace = true;
+		bool blend = false;
+		// Uniform locations by name pointer, filled on first use.
+		std::unordered_map<const char*, int32_t> uniforms;
+	};
+
+	std::vector<Buffer> m_Buffers;
+	std::vector<uint32_t> m_Textures;
+	std::vector<Pipeline> m_Pipelines;
+	// By stage type, path and sorted defines; only the permutations some
+	// pipeline asked for are compiled.
+	std::map<std::string, ShaderStage> m_ShaderStages;
+	ShaderLoadStats m_ShaderStats;
+	// GLsync objects.
+	std::vector<void*> m_Fences;
+	// Released slots, reused by the next creations.
+	std::vector<uint32_t> m_FreeBuffers;
+	std::vector<uint32_t> m_FreeTextures;
+	std::vector<uint32_t> m_FreePipelines;
+	std::vector<uint32_t> m_FreeFences;
+	size_t m_StorageBufferAlignment = 256;
+	GLUploadThread m_UploadThread;
+	std::unordered_map<uint32_t, Upload> m_Uploads;
+	// Finished on the upload thread, the GPU may still be copying.
+	std::vector<GLUpload> m_FinishedUploads;
+	uint32_t m_NextUpload = 1;
+
+	int32_t GetUniformLocation(Pipeline& pipeline, const char* name);
+	bool CompileStage(ShaderStage& stage);
+	// Issues the stage's compile on first use; null if its files cannot be
+	// read.
+	const ShaderStage* GetStage(uint32_t type, const std::string& path, const std::vector<std::string>& defines,
+		std::string& key);
+	// Issues the link of the pipeline's program from its desc.
+	bool BeginPipeline(Pipeline& pipeline);
+	// Finishes the build in progress if the driver is done with it.
+	void PollPipeline(Pipeline& pipeline);
+
+public:
+	// Needs a current OpenGL 4.5 context with ARB_shader_draw_parameters,
+	// false otherwise; sets the state shared by every pipeline (sRGB
+	// framebuffer, scissor test).
+	bool Create();
+	// Deletes every object still alive, after stopping the upload thread.
+	void Destroy();
+	// See GLUploadThread::Start(); the context made current by `attach` must
+	// share its objects with the render one.
+	void StartUploadThread(std::function<void()> attach, std::function<void()> detach);
+	// Creates a texture in the current context, its texels read from
+	// desc.data or, with `unpackBuffer`, from the start of the bound pixel
+	// unpack buffer.
+	static uint32_t CreateTextureName(const TextureDesc& desc, bool unpackBuffer = false);
+	inline const ShaderLoadStats& GetShaderLoadStats() const { return m_ShaderStats; }
+
+	uint32_t CreateBuffer(size_t size, const void* data, uint32_t flags = 0) override;
+	void WriteBuffer(uint32_t buffer, size_t offset, const void* data, size_t size) override;
+	void CopyBuffer(uint32_t source, size_t sourceOffset, uint32_t destination, size_t destinationOffset, size_t size) override;
+	void ResizeBuffer(uint32_t buffer, size_t size, size_t keep) override;
+	void DestroyBuffer(uint32_t buffer) override;
+	void* GetMappedPointer(uint32_t buffer) const override;
+	inline size_t GetStorageBufferAlignment() const override { return m_StorageBufferAlignment; }
+
+	uint32_t CreateTexture(const TextureDesc& desc) override;
+	void DestroyTexture(uint32_t texture) override;
+
+	uint32_t CreatePipeline(const PipelineDesc& desc) override;
+	std::vector<std::string> GetPipelineFiles(uint32_t pipeline) const override;
+	size_t ReloadShaderFile(const std::string& path) override;
+	void DestroyPipeline(uint32_t pipeline) override;
+
+	uint32_t WriteBufferAsync(uint32_t buffer, size_t offset, std::shared_ptr<const void> data, size_t size) override;
+	uint32_t CreateTextureAsync(const TextureDesc& desc, std::shared_ptr<const void> data, uint32_t* upload = nullptr) override;
+	inline bool IsUploadDone(uint32_t upload) const override { return m_Uploads.find(upload) == m_Uploads.end(); }
+	void UpdateUploads() override;
+
+	void Submit(const CommandList& commands) override;
+
+	uint32_t InsertFence() override;
+	void WaitFence(uint32_t fence) override;
+};
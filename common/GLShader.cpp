@@ -1,131 +1,118 @@
 //#include "stdafx.h"
 #include "GLShader.h"
+#include "MappedFile.h"
+#include "ShaderPreprocessor.h"
 #define GLEW_STATIC
 #include "GL/glew.h"
 
-#include <fstream>
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 
-bool ValidateShader(GLuint shader) {
-    GLint compiled;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
-
-    if (!compiled) {
-        GLint infoLen = 0;
-        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLen);
-
-        if (infoLen > 1) {
-            char* infoLog = new char[infoLen + 1];
-            glGetShaderInfoLog(shader, infoLen, nullptr, infoLog);
-            std::cout << "Error compiling shader: " << infoLog << std::endl;
-            delete[] infoLog;
-        }
+// Prints the log of a shader that did not compile and deletes it.
+bool ValidateShader(GLuint shader, const char* filename) {
+    if (GLShader::IsCompiled(shader))
+        return true;
+    std::cout << "Error compiling shader: " << AnnotateShaderLog(GLShader::GetShaderLog(shader), { filename }) << std::endl;
+    glDeleteShader(shader);
+    return false;
+}
 
-        // Delete the shader object since it's unusable
-        glDeleteShader(shader);
-        return false;
+uint32_t GLShader::LoadShader(uint32_t type, const char* filename)
+{
+    // Compiled straight from the mapping, its length given to glShaderSource
+    MappedFile file;
+    if (!file.Open(filename)) {
+        std::cerr << "Failed to open shader file: " << filename << std::endl;
+        return 0;
     }
-
-    return true;
+    GLuint shader = BeginCompile(type, file.Size() ? file.Data() : "", file.Size());
+    return ValidateShader(shader, filename) ? shader : 0;
 }
 
+bool GLShader::LoadVertexShader(const char* filename)
+{
+    m_VertexShader = LoadShader(GL_VERTEX_SHADER, filename);
+    return m_VertexShader != 0;
+}
 
-bool GLShader::LoadVertexShader(const char* filename) {
-    // Print the file path for debugging
-    std::cout << "Loading vertex shader from: " << filename << std::endl;
-
-    // Open the file
-    std::ifstream fin(filename, std::ios::in | std::ios::binary);
-    if (!fin) {
-        std::cerr << "Failed to open vertex shader file: " << filename << std::endl;
-        return false;
-    }
-
-    // Calculate the length of the file
-    fin.seekg(0, std::ios::end);
-    std::streamoff length = fin.tellg();
-    if (length == -1) {
-        std::cerr << "Failed to calculate length of vertex shader file: " << filename << std::endl;
-        fin.close();
-        return false;
-    }
-    fin.seekg(0, std::ios::beg);
-
-    // Read the file content into a buffer
-    char* buffer = new char[static_cast<size_t>(length) + 1];
-    fin.read(buffer, length);
-    if (!fin) {
-        std::cerr << "Failed to read vertex shader file: " << filename << std::endl;
-        delete[] buffer;
-        fin.close();
-        return false;
-    }
-    buffer[length] = '\0';
+bool GLShader::LoadGeometryShader(const char* filename)
+{
+    m_GeometryShader = LoadShader(GL_GEOMETRY_SHADER, filename);
+    return m_GeometryShader != 0;
+}
 
-    // Close the file
-    fin.close();
+bool GLShader::LoadFragmentShader(const char* filename)
+{
+    m_FragmentShader = LoadShader(GL_FRAGMENT_SHADER, filename);
+    return m_FragmentShader != 0;
+}
 
-    // Create the shader object
-    m_VertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(m_VertexShader, 1, &buffer, nullptr);
+uint32_t GLShader::BeginCompile(uint32_t type, const char* source, size_t length)
+{
+    GLuint shader = glCreateShader(type);
+    GLint sourceLength = GLint(length);
+    glShaderSource(shader, 1, &source, &sourceLength);
+    glCompileShader(shader);
+    return shader;
+}
 
-    // Compile the shader
-    glCompileShader(m_VertexShader);
+bool GLShader::IsCompiled(uint32_t shader)
+{
+    GLint compiled = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    return compiled != 0;
+}
 
-    // Clean up the buffer
-    delete[] buffer;
+std::string GLShader::GetShaderLog(uint32_t shader)
+{
+    GLint infoLen = 0;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLen);
+    std::string log(size_t(std::max(infoLen, 1)), '\0');
+    glGetShaderInfoLog(shader, infoLen, nullptr, &log[0]);
+    log.resize(std::strlen(log.c_str()));
+    return log;
+}
 
-    // Validate the shader
-    return ValidateShader(m_VertexShader);
+void GLShader::BeginLink(uint32_t vertexShader, uint32_t fragmentShader)
+{
+    m_VertexShader = vertexShader;
+    m_FragmentShader = fragmentShader;
+    m_SharedShaders = true;
+    m_Program = glCreateProgram();
+    glAttachShader(m_Program, m_VertexShader);
+    glAttachShader(m_Program, m_FragmentShader);
+    glLinkProgram(m_Program);
 }
 
-bool GLShader::LoadGeometryShader(const char* filename)
+bool GLShader::IsReady() const
 {
-    // Load the file into memory
-    std::ifstream fin(filename, std::ios::in | std::ios::binary);
-    fin.seekg(0, std::ios::end);
-    uint32_t length = (uint32_t)fin.tellg();
-    fin.seekg(0, std::ios::beg);
-    char* buffer = nullptr;
-    buffer = new char[length + 1];
-    buffer[length] = '\0';
-    fin.read(buffer, length);
-
-    // Create the shader object
-    m_GeometryShader = glCreateShader(GL_GEOMETRY_SHADER);
-    glShaderSource(m_GeometryShader, 1, &buffer, nullptr);
-    // Compile it
-    glCompileShader(m_GeometryShader);
-    // Clean up
-    delete[] buffer;
-    fin.close(); // Not mandatory here
-
-    // Validate the shader compilation status
-    return ValidateShader(m_GeometryShader);
+    if (!GLEW_KHR_parallel_shader_compile)
+        return true;
+    GLint done = 0;
+    glGetProgramiv(m_Program, GL_COMPLETION_STATUS_KHR, &done);
+    return done != 0;
 }
 
-bool GLShader::LoadFragmentShader(const char* filename)
+bool GLShader::Finish()
 {
-    std::ifstream fin(filename, std::ios::in | std::ios::binary);
-    fin.seekg(0, std::ios::end);
-    uint32_t length = (uint32_t)fin.tellg();
-    fin.seekg(0, std::ios::beg);
-    char* buffer = nullptr;
-    buffer = new char[length + 1];
-    buffer[length] = '\0';
-    fin.read(buffer, length);
-
-    // Create the shader object
-    m_FragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(m_FragmentShader, 1, &buffer, nullptr);
-    // Compile it
-    glCompileShader(m_FragmentShader);
-    // Clean up
-    delete[] buffer;
-    fin.close(); // Not mandatory here
-
-    // Validate the shader compilation status
-    return ValidateShader(m_FragmentShader);
+    int32_t linked = 0;
+    glGetProgramiv(m_Program, GL_LINK_STATUS, &linked);
+    if (linked)
+        return true;
+
+    int32_t infoLen = 0;
+    glGetProgramiv(m_Program, GL_INFO_LOG_LENGTH, &infoLen);
+    if (infoLen > 1)
+    {
+        char* infoLog = new char[infoLen + 1];
+        glGetProgramInfoLog(m_Program, infoLen, NULL, infoLog);
+        std::cout << "Program link error: " << infoLog << std::endl;
+        delete[] infoLog;
+    }
+    glDeleteProgram(m_Program);
+    m_Program = 0;
+    return false;
 }
 
 bool GLShader::Create()
@@ -166,8 +153,10 @@ void GLShader::Destroy()
     glDetachShader(m_Program, m_VertexShader);
     glDetachShader(m_Program, m_FragmentShader);
     glDetachShader(m_Program, m_GeometryShader);
+    glDeleteProgram(m_Program);
+    if (m_SharedShaders)
+        return;
     glDeleteShader(m_GeometryShader);
     glDeleteShader(m_VertexShader);
     glDeleteShader(m_FragmentShader);
-    glDeleteProgram(m_Program);
 }
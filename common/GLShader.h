@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <string>
 
 class GLShader
 {
@@ -9,11 +11,14 @@ private:
 	uint32_t m_VertexShader;
 	uint32_t m_GeometryShader;
 	uint32_t m_FragmentShader;
+	// Stages owned by the caller, see Link().
+	bool m_SharedShaders;
 
-	bool CompileShader(uint32_t type);
+	// Returns 0 if the file cannot be read or does not compile.
+	static uint32_t LoadShader(uint32_t type, const char* filename);
 public:
 	GLShader() : m_Program(0), m_VertexShader(0),
-		m_GeometryShader(0), m_FragmentShader(0) {
+		m_GeometryShader(0), m_FragmentShader(0), m_SharedShaders(false) {
 
 	}
 	~GLShader() {}
@@ -23,5 +28,21 @@ public:
 	bool LoadGeometryShader(const char* filename);
 	bool LoadFragmentShader(const char* filename);
 	bool Create();
+	// Asynchronous build of many programs: every compile and link is issued
+	// up front and only checked once done, so the driver may run them in
+	// parallel (KHR_parallel_shader_compile) instead of one after the other.
+	// Returns the shader name, compiling from `length` bytes of GLSL.
+	static uint32_t BeginCompile(uint32_t type, const char* source, size_t length);
+	static bool IsCompiled(uint32_t shader);
+	static std::string GetShaderLog(uint32_t shader);
+	// Links stages from BeginCompile(), shared with other programs: Destroy()
+	// leaves them to the caller.
+	void BeginLink(uint32_t vertexShader, uint32_t fragmentShader);
+	// Whether Finish() returns without waiting; always true without the
+	// extension.
+	bool IsReady() const;
+	// Checks the link, printing the program log; on failure the program is
+	// deleted. The stages that did not compile say why in GetShaderLog().
+	bool Finish();
 	void Destroy();
 };
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include "GLUploadThread.h"
+#include "GLRenderBackend.h"
+#define GLEW_STATIC
+#include "GL/glew.h"
+
+#include <algorithm>
+#include <cstring>
+
+void GLUploadThread::Start(std::function<void()> attach, std::function<void()> detach) {
+	Stop();
+	m_Attach = std::move(attach);
+	m_Detach = std::move(detach);
+	m_Stopping = false;
+	m_Thread = std::thread(&GLUploadThread::Run, this);
+}
+
+void GLUploadThread::Stop() {
+	if (!m_Thread.joinable())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stopping = true;
+		m_Requests.clear();
+	}
+	m_Wake.notify_one();
+	m_Thread.join();
+}
+
+void GLUploadThread::Push(Request request) {
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Requests.push_back(std::move(request));
+	}
+	m_Wake.notify_one();
+}
+
+void GLUploadThread::UploadTexture(uint32_t id, const TextureDesc& desc, std::shared_ptr<const void> data) {
+	Request request;
+	request.id = id;
+	request.texture = true;
+	request.desc = desc;
+	request.desc.data = nullptr;
+	request.data = std::move(data);
+	request.size = size_t(desc.width) * size_t(desc.height) * 4;
+	Push(std::move(request));
+}
+
+void GLUploadThread::UploadBuffer(uint32_t id, std::shared_ptr<const void> data, size_t size) {
+	Request request;
+	request.id = id;
+	request.data = std::move(data);
+	request.size = size;
+	Push(std::move(request));
+}
+
+void GLUploadThread::TakeFinished(std::vector<GLUpload>& uploads) {
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	uploads.insert(uploads.end(), m_Finished.begin(), m_Finished.end());
+	m_Finished.clear();
+}
+
+void GLUploadThread::Run() {
+	m_Attach();
+	for (;;) {
+		Request request;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_Wake.wait(lock, [this]() { return m_Stopping || !m_Requests.empty(); });
+			if (m_Stopping)
+				break;
+			request = std::move(m_Requests.front());
+			m_Requests.pop_front();
+		}
+
+		// Staging memory written by the CPU, read by the GPU copies below
+		GLuint staging = 0;
+		glCreateBuffers(1, &staging);
+		glNamedBufferStorage(staging, GLsizeiptr(std::max<size_t>(request.size, 1)), nullptr, GL_MAP_WRITE_BIT);
+		if (request.size) {
+			void* mapped = glMapNamedBufferRange(staging, 0, GLsizeiptr(request.size), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+			if (mapped) {
+				std::memcpy(mapped, request.data.get(), request.size);
+				glUnmapNamedBuffer(staging);
+			}
+		}
+		request.data.reset();
+
+		GLUpload upload;
+		upload.id = request.id;
+		upload.size = request.size;
+		if (request.texture) {
+			// Sourced from the bound unpack buffer; the staging buffer is
+			// released once the copy is done
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging);
+			upload.texture = GLRenderBackend::CreateTextureName(request.desc, true);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			glDeleteBuffers(1, &staging);
+		} else {
+			upload.staging = staging;
+		}
+		upload.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		// The render context only sees the fence signal once this context's
+		// commands are on their way
+		glFlush();
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Finished.push_back(upload);
+	}
+	m_Detach();
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "RenderBackend.h"
+
+// Upload finished on the upload thread: `fence` (a GLsync) signals once the
+// GPU is done with its copies. Either a texture created with its contents,
+// or a staging buffer holding the data to copy where it belongs.
+struct GLUpload {
+	uint32_t id = 0;
+	uint32_t texture = 0;
+	uint32_t staging = 0;
+	size_t size = 0;
+	void* fence = nullptr;
+};
+
+// Thread owning a second OpenGL context that shares its objects with the
+// render one. The data of each request is copied into a staging buffer
+// through a mapping (a pixel unpack buffer for textures), the texture is
+// created from it, and a fence is inserted and flushed so the render
+// context can poll it. The render thread never waits for this one.
+class GLUploadThread
+{
+private:
+	struct Request
+	{
+		uint32_t id = 0;
+		bool texture = false;
+		TextureDesc desc;
+		std::shared_ptr<const void> data;
+		size_t size = 0;
+	};
+
+	std::thread m_Thread;
+	std::mutex m_Mutex;
+	std::condition_variable m_Wake;
+	std::deque<Request> m_Requests;
+	std::vector<GLUpload> m_Finished;
+	bool m_Stopping = false;
+	std::function<void()> m_Attach;
+	std::function<void()> m_Detach;
+
+	void Run();
+	void Push(Request request);
+
+public:
+	~GLUploadThread() { Stop(); }
+
+	// `attach` runs first on the thread and must make the shared context
+	// current there, `detach` releases it before the thread exits.
+	void Start(std::function<void()> attach, std::function<void()> detach);
+	// Drops the requests not started yet; the finished uploads are still
+	// returned by TakeFinished().
+	void Stop();
+	inline bool IsRunning() const { return m_Thread.joinable(); }
+
+	// `data` holds width * height RGBA8 texels (desc.data is ignored).
+	void UploadTexture(uint32_t id, const TextureDesc& desc, std::shared_ptr<const void> data);
+	void UploadBuffer(uint32_t id, std::shared_ptr<const void> data, size_t size);
+	// Appends the uploads finished since the last call.
+	void TakeFinished(std::vector<GLUpload>& uploads);
+};
@@ -0,0 +1,18 @@
+#include "ImageFile.h"
+
+#include <fstream>
+#include <iostream>
+
+bool SavePpm(const std::string& path, int width, int height, const std::vector<uint8_t>& rgb) {
+    std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Failed to open " << path << " for writing" << std::endl;
+        return false;
+    }
+    out << "P6\n" << width << " " << height << "\n255\n";
+    out.write(reinterpret_cast<const char*>(rgb.data()), std::streamsize(rgb.size()));
+    out.close();
+    if (!out)
+        std::cerr << "Failed to write " << path << std::endl;
+    return bool(out);
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Writes RGB8 pixels, row-major from the top row, as a binary PPM file.
+bool SavePpm(const std::string& path, int width, int height, const std::vector<uint8_t>& rgb);
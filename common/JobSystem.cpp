@@ -0,0 +1,244 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+// System and queue of the current thread.
+struct ThreadSlot
+{
+	const JobSystem* system = nullptr;
+	size_t index = 0;
+};
+thread_local ThreadSlot t_Slot;
+
+// Attempts at finding work before a worker goes to sleep.
+const int IDLE_SPINS = 64;
+
+} // namespace
+
+void JobSystem::Start(unsigned threads) {
+	Stop();
+	unsigned count = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+	m_Stopping = false;
+	for (unsigned i = 0; i < count; i++)
+		m_Queues.emplace_back(new Queue());
+	t_Slot.system = this;
+	t_Slot.index = 0;
+	for (unsigned i = 1; i < count; i++)
+		m_Workers.emplace_back(&JobSystem::WorkerLoop, this, size_t(i));
+}
+
+void JobSystem::Stop() {
+	if (m_Queues.empty())
+		return;
+	while (TryRun(GetThreadIndex(), true)) {
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_SleepMutex);
+		m_Stopping = true;
+	}
+	m_Wake.notify_all();
+	for (std::thread& worker : m_Workers)
+		worker.join();
+	m_Workers.clear();
+	m_Queues.clear();
+	if (t_Slot.system == this)
+		t_Slot = ThreadSlot();
+}
+
+size_t JobSystem::GetThreadIndex() const {
+	return t_Slot.system == this ? t_Slot.index : 0;
+}
+
+void JobSystem::Push(Entry entry, bool background) {
+	Queue& queue = background ? m_Background : *m_Queues[GetThreadIndex()];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.entries.push_back(std::move(entry));
+	}
+	// A worker going to sleep counts itself before checking m_Queued, so
+	// one of the two sides always sees the other
+	m_Queued++;
+	if (m_Sleeping > 0) {
+		std::lock_guard<std::mutex> lock(m_SleepMutex);
+		m_Wake.notify_one();
+	}
+}
+
+bool JobSystem::TryRun(size_t thread, bool background) {
+	Entry entry;
+	bool found = false;
+	bool stolen = false;
+	{
+		// Own queue, newest first
+		Queue& queue = *m_Queues[thread];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.entries.empty()) {
+			entry = std::move(queue.entries.back());
+			queue.entries.pop_back();
+			found = true;
+		}
+	}
+	for (size_t k = 1; !found && k < m_Queues.size(); k++) {
+		// Other queues, oldest first
+		Queue& victim = *m_Queues[(thread + k) % m_Queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.entries.empty()) {
+			entry = std::move(victim.entries.front());
+			victim.entries.pop_front();
+			found = stolen = true;
+		}
+	}
+	if (!found && background) {
+		std::lock_guard<std::mutex> lock(m_Background.mutex);
+		if (!m_Background.entries.empty()) {
+			entry = std::move(m_Background.entries.front());
+			m_Background.entries.pop_front();
+			found = true;
+		}
+	}
+	if (!found)
+		return false;
+	m_Queued--;
+
+	auto start = std::chrono::steady_clock::now();
+	entry.job();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	{
+		Queue& queue = *m_Queues[thread];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.stats.jobs++;
+		queue.stats.steals += stolen ? 1 : 0;
+		queue.stats.busySeconds += seconds;
+	}
+	Finish(entry.counter);
+	return true;
+}
+
+void JobSystem::Finish(JobCounter* counter) {
+	if (!counter)
+		return;
+	size_t pending = counter->m_Pending.load(std::memory_order_relaxed);
+	while (pending > 1)
+		if (counter->m_Pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel))
+			return;
+
+	// Possibly the last job: decrement under the lock, which Wait() and
+	// RunAfter() take too, then never touch the counter again
+	std::vector<std::pair<Job, JobCounter*>> continuations;
+	{
+		std::lock_guard<std::mutex> lock(counter->m_Mutex);
+		if (counter->m_Pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			continuations.swap(counter->m_Continuations);
+	}
+	for (auto& continuation : continuations)
+		Push({ std::move(continuation.first), continuation.second });
+}
+
+void JobSystem::WorkerLoop(size_t thread) {
+	t_Slot.system = this;
+	t_Slot.index = thread;
+	for (;;) {
+		bool ran = false;
+		for (int spin = 0; spin < IDLE_SPINS && !ran; spin++) {
+			ran = TryRun(thread, true);
+			if (!ran)
+				std::this_thread::yield();
+		}
+		if (ran)
+			continue;
+		if (m_Stopping && m_Queued == 0)
+			break;
+		m_Sleeping++;
+		{
+			std::unique_lock<std::mutex> lock(m_SleepMutex);
+			m_Wake.wait(lock, [this]() { return m_Queued > 0 || m_Stopping; });
+		}
+		m_Sleeping--;
+	}
+}
+
+void JobSystem::Run(Job job, JobCounter* counter) {
+	if (counter)
+		counter->m_Pending++;
+	if (m_Queues.empty()) {
+		// Not started: run it right away
+		job();
+		Finish(counter);
+		return;
+	}
+	Push({ std::move(job), counter });
+}
+
+void JobSystem::RunBackground(Job job, JobCounter* counter) {
+	if (counter)
+		counter->m_Pending++;
+	if (m_Queues.size() <= 1) {
+		job();
+		Finish(counter);
+		return;
+	}
+	Push({ std::move(job), counter }, true);
+}
+
+void JobSystem::RunAfter(JobCounter& dependency, Job job, JobCounter* counter) {
+	if (counter)
+		counter->m_Pending++;
+	{
+		std::lock_guard<std::mutex> lock(dependency.m_Mutex);
+		if (dependency.m_Pending.load(std::memory_order_acquire) != 0) {
+			dependency.m_Continuations.emplace_back(std::move(job), counter);
+			return;
+		}
+	}
+	if (m_Queues.empty()) {
+		job();
+		Finish(counter);
+		return;
+	}
+	Push({ std::move(job), counter });
+}
+
+void JobSystem::Wait(JobCounter& counter) {
+	while (!counter.IsDone()) {
+		if (m_Queues.empty() || !TryRun(GetThreadIndex(), false))
+			std::this_thread::yield();
+	}
+	// The last Finish() may still hold the lock
+	std::lock_guard<std::mutex> lock(counter.m_Mutex);
+}
+
+void JobSystem::ParallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body) {
+	grain = std::max<size_t>(grain, 1);
+	if (count <= grain || m_Queues.size() <= 1) {
+		if (count)
+			body(0, count);
+		return;
+	}
+	JobCounter counter;
+	for (size_t begin = grain; begin < count; begin += grain) {
+		size_t end = std::min(count, begin + grain);
+		Run([&body, begin, end]() { body(begin, end); }, &counter);
+	}
+	// The first range on this thread, the others are stolen meanwhile
+	body(0, grain);
+	Wait(counter);
+}
+
+std::vector<JobThreadStats> JobSystem::GetStats() const {
+	std::vector<JobThreadStats> stats;
+	for (const std::unique_ptr<Queue>& queue : m_Queues) {
+		std::lock_guard<std::mutex> lock(queue->mutex);
+		stats.push_back(queue->stats);
+	}
+	return stats;
+}
+
+void JobSystem::ResetStats() {
+	for (std::unique_ptr<Queue>& queue : m_Queues) {
+		std::lock_guard<std::mutex> lock(queue->mutex);
+		queue->stats = JobThreadStats();
+	}
+}
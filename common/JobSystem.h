@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+
+// Number of unfinished jobs of a group, given to JobSystem::Run(). Jobs can
+// also be made to wait for a counter: they are queued once it reaches zero.
+// A counter must outlive its jobs and the jobs depending on it.
+class JobCounter
+{
+private:
+	friend class JobSystem;
+
+	std::atomic<size_t> m_Pending{ 0 };
+	// Jobs to queue when m_Pending reaches zero.
+	std::mutex m_Mutex;
+	std::vector<std::pair<std::function<void()>, JobCounter*>> m_Continuations;
+
+public:
+	inline bool IsDone() const { return m_Pending.load(std::memory_order_acquire) == 0; }
+};
+
+// Per-thread activity since the last ResetStats().
+struct JobThreadStats {
+	size_t jobs = 0;
+	// Jobs taken from another thread's queue.
+	size_t steals = 0;
+	double busySeconds = 0;
+};
+
+// Pool of worker threads running small jobs. Each thread owns a queue: jobs
+// run from a thread go to its own queue, which it empties newest first
+// (cache-warm, nested work first), while idle threads steal the oldest jobs
+// of the others (the largest remaining pieces). Threads outside the system
+// queue into thread 0's queue. Waiting on a counter runs queued jobs in the
+// meantime, so jobs may wait on other jobs without deadlocking. Idle workers
+// sleep until something is queued. Background jobs go to a separate queue
+// that only the workers take from, once the others are empty.
+class JobSystem
+{
+private:
+	typedef std::function<void()> Job;
+
+	struct Entry
+	{
+		Job job;
+		JobCounter* counter;
+	};
+
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Entry> entries;
+		JobThreadStats stats;
+	};
+
+	std::vector<std::unique_ptr<Queue>> m_Queues;
+	Queue m_Background;
+	std::vector<std::thread> m_Workers;
+	std::atomic<size_t> m_Queued{ 0 };
+	std::atomic<size_t> m_Sleeping{ 0 };
+	std::atomic<bool> m_Stopping{ false };
+	std::mutex m_SleepMutex;
+	std::condition_variable m_Wake;
+
+	size_t GetThreadIndex() const;
+	void Push(Entry entry, bool background = false);
+	bool TryRun(size_t thread, bool background);
+	void Finish(JobCounter* counter);
+	void WorkerLoop(size_t thread);
+
+public:
+	JobSystem() {}
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+	~JobSystem() { Stop(); }
+
+	// Starts threads - 1 workers (0 = one thread per hardware thread), the
+	// calling thread being thread 0.
+	void Start(unsigned threads = 0);
+	// Runs the remaining jobs, then joins the workers.
+	void Stop();
+
+	// Queues `job`; `counter`, if any, counts it until it has returned.
+	void Run(Job job, JobCounter* counter = nullptr);
+	// Queues a long job (loading) that Wait() and ParallelFor() never pick
+	// up, so they are not held by it; it runs inline without workers.
+	void RunBackground(Job job, JobCounter* counter = nullptr);
+	// Queues `job` once `dependency` is done.
+	void RunAfter(JobCounter& dependency, Job job, JobCounter* counter = nullptr);
+	// Runs queued jobs until `counter` is done; the counter can be destroyed
+	// once this returns.
+	void Wait(JobCounter& counter);
+	// Calls body(begin, end) over [0, count) in ranges of `grain` items run
+	// as jobs, and waits for them.
+	void ParallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body);
+
+	inline unsigned GetThreadCount() const { return unsigned(m_Queues.size()); }
+	// One entry per thread, thread 0 first.
+	std::vector<JobThreadStats> GetStats() const;
+	void ResetStats();
+};
@@ -0,0 +1,72 @@
+#include "LinearArena.h"
+
+#include <new>
+
+LinearArena::~LinearArena() {
+	for (char* block : m_Blocks)
+		::operator delete(block);
+	for (Large& large : m_Large)
+		::operator delete(large.data);
+}
+
+void LinearArena::NextBlock() {
+	size_t next = m_Blocks.empty() ? 0 : m_Block + 1;
+	if (next == m_Blocks.size()) {
+		m_Blocks.push_back(static_cast<char*>(::operator new(m_BlockSize)));
+		m_Capacity += m_BlockSize;
+	}
+	m_Block = next;
+	m_Offset = 0;
+}
+
+void* LinearArena::Allocate(size_t size, size_t alignment) {
+	if (size > m_BlockSize) {
+		Large large;
+		large.data = static_cast<char*>(::operator new(size));
+		large.size = size;
+		m_Large.push_back(large);
+		m_Capacity += size;
+		return large.data;
+	}
+	// The blocks are aligned for any type, their padding is at most
+	// alignment - 1 bytes
+	if (!m_Blocks.empty()) {
+		size_t offset = (m_Offset + alignment - 1) & ~(alignment - 1);
+		if (offset + size <= m_BlockSize) {
+			m_Offset = offset + size;
+			return m_Blocks[m_Block] + offset;
+		}
+	}
+	NextBlock();
+	m_Offset = size;
+	return m_Blocks[m_Block];
+}
+
+void LinearArena::Deallocate(void* data, size_t size) {
+	if (size <= m_BlockSize)
+		return;
+	// Usually one of the last ones; the slot stays so the markers still
+	// count the allocations before them
+	for (size_t i = m_Large.size(); i-- > 0;) {
+		if (m_Large[i].data == data) {
+			::operator delete(m_Large[i].data);
+			m_Capacity -= m_Large[i].size;
+			m_Large[i].data = nullptr;
+			m_Large[i].size = 0;
+			return;
+		}
+	}
+}
+
+void LinearArena::Rewind(const Marker& marker) {
+	for (size_t i = marker.large; i < m_Large.size(); i++) {
+		::operator delete(m_Large[i].data);
+		m_Capacity -= m_Large[i].size;
+	}
+	if (marker.large < m_Large.size())
+		m_Large.resize(marker.large);
+	if (marker.block > m_Block || (marker.block == m_Block && marker.offset >= m_Offset))
+		return;
+	m_Block = marker.block;
+	m_Offset = marker.offset;
+}
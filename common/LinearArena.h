@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bump allocator for temporaries that die together, like the scratch data of
+// a mesh import: memory is carved out of large blocks, deallocating does
+// nothing, and Rewind() releases everything allocated after a marker at once.
+// The blocks are kept for the next allocations until the arena is destroyed,
+// so the phases of a load reuse the same memory instead of going back to the
+// heap for every node and small array. Allocations larger than a block go to
+// the heap on their own and are freed when deallocated, so growing or
+// short-lived big arrays cost what they would without the arena. Not thread
+// safe: one arena per load job.
+class LinearArena
+{
+public:
+	struct Marker
+	{
+		size_t block = 0;
+		size_t offset = 0;
+		size_t large = 0;
+	};
+
+private:
+	// Allocation larger than a block.
+	struct Large
+	{
+		char* data = nullptr;
+		size_t size = 0;
+	};
+
+	// Blocks of m_BlockSize bytes; the ones before m_Block are full, the
+	// ones after it are free.
+	std::vector<char*> m_Blocks;
+	std::vector<Large> m_Large;
+	size_t m_Block = 0;
+	size_t m_Offset = 0;
+	size_t m_BlockSize;
+	size_t m_Capacity = 0;
+
+	void NextBlock();
+
+public:
+	// Blocks of the default size are mapped on their own by the C heap, so
+	// they do not pin the memory freed around them.
+	explicit LinearArena(size_t blockSize = 128 << 10) : m_BlockSize(blockSize) {}
+	~LinearArena();
+	LinearArena(const LinearArena&) = delete;
+	LinearArena& operator=(const LinearArena&) = delete;
+
+	void* Allocate(size_t size, size_t alignment);
+	// Only gives back allocations larger than a block, the others wait for
+	// a rewind.
+	void Deallocate(void* data, size_t size);
+	inline Marker GetMarker() const { return { m_Block, m_Offset, m_Large.size() }; }
+	// Everything allocated since `marker` was taken is released.
+	void Rewind(const Marker& marker);
+	inline void Reset() { Rewind(Marker()); }
+
+	// Bytes held in blocks, used or not, and in large allocations.
+	inline size_t GetCapacity() const { return m_Capacity; }
+	inline size_t GetBlockCount() const { return m_Blocks.size(); }
+};
+
+// Rewinds the arena to where it was on construction.
+class ArenaScope
+{
+private:
+	LinearArena& m_Arena;
+	LinearArena::Marker m_Marker;
+
+public:
+	explicit ArenaScope(LinearArena& arena) : m_Arena(arena), m_Marker(arena.GetMarker()) {}
+	~ArenaScope() { m_Arena.Rewind(m_Marker); }
+	ArenaScope(const ArenaScope&) = delete;
+	ArenaScope& operator=(const ArenaScope&) = delete;
+};
+
+// Standard allocator drawing from a LinearArena, for containers that do not
+// outlive it; converts implicitly from the arena:
+//   ArenaVector<uint32_t> remap(count, arena);
+template <typename T>
+class ArenaAllocator
+{
+private:
+	LinearArena* m_Arena;
+
+	template <typename U>
+	friend class ArenaAllocator;
+
+public:
+	typedef T value_type;
+
+	ArenaAllocator(LinearArena& arena) : m_Arena(&arena) {}
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : m_Arena(other.m_Arena) {}
+
+	inline T* allocate(size_t count) { return static_cast<T*>(m_Arena->Allocate(count * sizeof(T), alignof(T))); }
+	inline void deallocate(T* data, size_t count) { m_Arena->Deallocate(data, count * sizeof(T)); }
+
+	template <typename U>
+	inline bool operator==(const ArenaAllocator<U>& other) const { return m_Arena == other.m_Arena; }
+	template <typename U>
+	inline bool operator!=(const ArenaAllocator<U>& other) const { return m_Arena != other.m_Arena; }
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
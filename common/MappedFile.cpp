@@ -0,0 +1,97 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string& filename) {
+    Close();
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        return false;
+    }
+    m_File = file;
+    m_Size = static_cast<size_t>(size.QuadPart);
+    if (m_Size == 0)
+        return true;  // empty files cannot be mapped
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        Close();
+        return false;
+    }
+    m_Mapping = mapping;
+    m_Data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!m_Data) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::Close() {
+    if (m_Data)
+        UnmapViewOfFile(m_Data);
+    if (m_Mapping)
+        CloseHandle(m_Mapping);
+    if (m_File)
+        CloseHandle(m_File);
+    m_Data = nullptr;
+    m_Mapping = nullptr;
+    m_File = nullptr;
+    m_Size = 0;
+}
+
+#else
+
+bool MappedFile::Open(const std::string& filename) {
+    Close();
+    int file = open(filename.c_str(), O_RDONLY);
+    if (file < 0)
+        return false;
+    struct stat info;
+    if (fstat(file, &info) != 0) {
+        close(file);
+        return false;
+    }
+    m_File = file;
+    m_Size = static_cast<size_t>(info.st_size);
+    if (m_Size == 0)
+        return true;  // empty files cannot be mapped
+
+    void* data = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, file, 0);
+    if (data == MAP_FAILED) {
+        Close();
+        return false;
+    }
+    // The parsers read front to back; let the kernel read ahead aggressively.
+    madvise(data, m_Size, MADV_SEQUENTIAL);
+    m_Data = static_cast<const char*>(data);
+    return true;
+}
+
+void MappedFile::Close() {
+    if (m_Data)
+        munmap(const_cast<char*>(m_Data), m_Size);
+    if (m_File >= 0)
+        close(m_File);
+    m_Data = nullptr;
+    m_File = -1;
+    m_Size = 0;
+}
+
+#endif
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Struct for 3D vertex
+struct Vertex3 {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texCoords;
+};
+
+// Range of Mesh::indices drawn for one level of detail. `error` is the
+// geometric deviation from level 0, in mesh units.
+struct MeshLod {
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    float error;
+};
+
+// Small cluster of triangles of level 0, contiguous in Mesh::indices, with
+// the bounds used to cull it (see Meshlets.h).
+struct Meshlet {
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    glm::vec3 center;       // bounding sphere
+    float radius;
+    glm::vec3 coneAxis;     // average facing direction
+    float coneCutoff;       // sine of the normal cone half-angle, >= 1: never backfacing
+};
+
+// Indexed triangle list as uploaded to the GPU.
+struct Mesh {
+    std::vector<Vertex3> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<MeshLod> lods; // empty: a single level using all indices
+    std::vector<Meshlet> meshlets;
+};
@@ -0,0 +1,220 @@
+#include "MeshCache.h"
+
+#include <cstring>
+#include <fstream>
+#include <utility>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+namespace {
+
+const char MESH_CACHE_MAGIC[8] = { 'O', 'B', 'J', 'C', 'A', 'C', 'H', 'E' };
+// Bump whenever the layout below or the meaning of the stored data changes.
+const uint32_t MESH_CACHE_VERSION = 6;
+
+struct MeshCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t options;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+};
+
+template <typename T>
+void Write(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void WriteVector(std::ofstream& out, const std::vector<T>& values) {
+    uint64_t count = values.size();
+    Write(out, count);
+    if (count)
+        out.write(reinterpret_cast<const char*>(values.data()), std::streamsize(count * sizeof(T)));
+}
+
+void WriteString(std::ofstream& out, const std::string& value) {
+    uint32_t length = uint32_t(value.size());
+    Write(out, length);
+    out.write(value.data(), length);
+}
+
+template <typename T>
+bool Read(std::ifstream& in, T& value) {
+    return bool(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+template <typename T>
+bool ReadVector(std::ifstream& in, std::vector<T>& values) {
+    uint64_t count;
+    if (!Read(in, count) || count > (uint64_t(1) << 40) / sizeof(T))
+        return false;
+    values.resize(size_t(count));
+    return count == 0 || bool(in.read(reinterpret_cast<char*>(values.data()), std::streamsize(count * sizeof(T))));
+}
+
+bool ReadString(std::ifstream& in, std::string& value) {
+    uint32_t length;
+    if (!Read(in, length) || length > (1u << 16))
+        return false;
+    value.resize(length);
+    return length == 0 || bool(in.read(&value[0], length));
+}
+
+// Only the material fields the renderers use are stored.
+void WriteMaterial(std::ofstream& out, const tinyobj::material_t& material) {
+    WriteString(out, material.name);
+    WriteString(out, material.diffuse_texname);
+    out.write(reinterpret_cast<const char*>(material.ambient), sizeof(material.ambient));
+    out.write(reinterpret_cast<const char*>(material.diffuse), sizeof(material.diffuse));
+    out.write(reinterpret_cast<const char*>(material.specular), sizeof(material.specular));
+    out.write(reinterpret_cast<const char*>(material.transmittance), sizeof(material.transmittance));
+    out.write(reinterpret_cast<const char*>(material.emission), sizeof(material.emission));
+    Write(out, material.shininess);
+    Write(out, material.ior);
+    Write(out, material.dissolve);
+    Write(out, material.illum);
+}
+
+bool ReadMaterial(std::ifstream& in, tinyobj::material_t& material) {
+    material = tinyobj::material_t();
+    return ReadString(in, material.name) && ReadString(in, material.diffuse_texname) &&
+        in.read(reinterpret_cast<char*>(material.ambient), sizeof(material.ambient)) &&
+        in.read(reinterpret_cast<char*>(material.diffuse), sizeof(material.diffuse)) &&
+        in.read(reinterpret_cast<char*>(material.specular), sizeof(material.specular)) &&
+        in.read(reinterpret_cast<char*>(material.transmittance), sizeof(material.transmittance)) &&
+        in.read(reinterpret_cast<char*>(material.emission), sizeof(material.emission)) &&
+        Read(in, material.shininess) && Read(in, material.ior) &&
+        Read(in, material.dissolve) && Read(in, material.illum);
+}
+
+void WriteDependencies(std::ofstream& out, const std::vector<MeshCacheDependency>& dependencies) {
+    uint32_t count = uint32_t(dependencies.size());
+    Write(out, count);
+    for (const MeshCacheDependency& dependency : dependencies) {
+        WriteString(out, dependency.path);
+        Write(out, dependency.size);
+        Write(out, dependency.time);
+    }
+}
+
+bool ReadDependencies(std::ifstream& in, std::vector<MeshCacheDependency>& dependencies) {
+    uint32_t count;
+    if (!Read(in, count) || count > (1u << 16))
+        return false;
+    dependencies.resize(count);
+    for (MeshCacheDependency& dependency : dependencies)
+        if (!ReadString(in, dependency.path) || !Read(in, dependency.size) || !Read(in, dependency.time))
+            return false;
+    return true;
+}
+
+// Size and last write time at the file system's resolution: nanoseconds, or
+// 100 ns on Windows, so files saved twice in a second still differ
+bool GetFileVersion(const std::string& path, uint64_t& size, int64_t& time) {
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &info))
+        return false;
+    size = (uint64_t(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+    time = int64_t((uint64_t(info.ftLastWriteTime.dwHighDateTime) << 32) | info.ftLastWriteTime.dwLowDateTime);
+#else
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+        return false;
+    size = uint64_t(info.st_size);
+#ifdef __APPLE__
+    time = int64_t(info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+    time = int64_t(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+#endif
+    return true;
+}
+
+} // namespace
+
+bool GetMeshCacheKey(const std::string& sourcePath, uint32_t options, MeshCacheKey& key) {
+    if (!GetFileVersion(sourcePath, key.sourceSize, key.sourceTime))
+        return false;
+    key.options = options;
+    return true;
+}
+
+MeshCacheDependency GetMeshCacheDependency(const std::string& path) {
+    MeshCacheDependency dependency;
+    dependency.path = path;
+    if (!GetFileVersion(path, dependency.size, dependency.time)) {
+        dependency.size = 0;
+        dependency.time = -1;
+    }
+    return dependency;
+}
+
+bool LoadMeshCache(const std::string& cachePath, const MeshCacheKey& key, MeshCacheData& data) {
+    std::ifstream in(cachePath, std::ios::in | std::ios::binary);
+    if (!in)
+        return false;
+
+    MeshCacheHeader header;
+    if (!Read(in, header) || std::memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != MESH_CACHE_VERSION || header.options != key.options ||
+        header.sourceSize != key.sourceSize || header.sourceTime != key.sourceTime)
+        return false;
+
+    // Read aside, `data` is left untouched unless the whole entry is valid
+    MeshCacheData loaded;
+    if (!ReadVector(in, loaded.mesh.vertices) || !ReadVector(in, loaded.mesh.indices) ||
+        !ReadVector(in, loaded.mesh.lods) || !ReadVector(in, loaded.mesh.meshlets) || !ReadMaterial(in, loaded.material) ||
+        !ReadDependencies(in, loaded.dependencies) || !Read(in, loaded.sourceVertexCount) ||
+        !Read(in, loaded.statsBefore) || !Read(in, loaded.statsAfter))
+        return false;
+
+    for (const MeshCacheDependency& dependency : loaded.dependencies) {
+        MeshCacheDependency current = GetMeshCacheDependency(dependency.path);
+        if (current.size != dependency.size || current.time != dependency.time)
+            return false;
+    }
+    for (uint32_t index : loaded.mesh.indices)
+        if (index >= loaded.mesh.vertices.size())
+            return false;
+    for (const MeshLod& lod : loaded.mesh.lods)
+        if (uint64_t(lod.indexOffset) + lod.indexCount > loaded.mesh.indices.size())
+            return false;
+    for (const Meshlet& meshlet : loaded.mesh.meshlets)
+        if (uint64_t(meshlet.indexOffset) + meshlet.indexCount > loaded.mesh.indices.size())
+            return false;
+    data = std::move(loaded);
+    return true;
+}
+
+bool SaveMeshCache(const std::string& cachePath, const MeshCacheKey& key, const MeshCacheData& data) {
+    std::ofstream out(cachePath, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+
+    MeshCacheHeader header;
+    std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+    header.version = MESH_CACHE_VERSION;
+    header.options = key.options;
+    header.sourceSize = key.sourceSize;
+    header.sourceTime = key.sourceTime;
+    Write(out, header);
+
+    WriteVector(out, data.mesh.vertices);
+    WriteVector(out, data.mesh.indices);
+    WriteVector(out, data.mesh.lods);
+    WriteVector(out, data.mesh.meshlets);
+    WriteMaterial(out, data.material);
+    WriteDependencies(out, data.dependencies);
+    Write(out, data.sourceVertexCount);
+    Write(out, data.statsBefore);
+    Write(out, data.statsAfter);
+    return bool(out);
+}
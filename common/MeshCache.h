@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Mesh.h"
+#include "MeshOptimizer.h"
+#include "tiny_obj_loader.h"
+
+// Binary cache of imported meshes, written next to the source file so the
+// OBJ parse and mesh processing only run when the source or the import
+// options change.
+
+// Identifies the source file version and the import options a cache entry
+// was built with; an entry is only used when its key matches exactly.
+struct MeshCacheKey {
+    uint64_t sourceSize = 0;
+    int64_t sourceTime = 0;
+    uint32_t options = 0;
+};
+
+// Another file the cached data was built from, like the .mtl files of the
+// source, with its size and modification time when it was read. A missing
+// file has a time of -1, so the entry is rebuilt if it appears.
+struct MeshCacheDependency {
+    std::string path;
+    uint64_t size = 0;
+    int64_t time = -1;
+};
+
+struct MeshCacheData {
+    Mesh mesh;
+    tinyobj::material_t material;
+    // Checked again when the entry is loaded
+    std::vector<MeshCacheDependency> dependencies;
+    uint32_t sourceVertexCount = 0;     // face vertices before welding
+    VertexCacheStats statsBefore;       // file order
+    VertexCacheStats statsAfter;        // after OptimizeVertexCache/OptimizeVertexFetch
+};
+
+bool GetMeshCacheKey(const std::string& sourcePath, uint32_t options, MeshCacheKey& key);
+MeshCacheDependency GetMeshCacheDependency(const std::string& path);
+bool LoadMeshCache(const std::string& cachePath, const MeshCacheKey& key, MeshCacheData& data);
+bool SaveMeshCache(const std::string& cachePath, const MeshCacheKey& key, const MeshCacheData& data);
@@ -0,0 +1,233 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount,
+    unsigned cacheSize) {
+    VertexCacheStats stats;
+    if (indices.empty() || vertexCount == 0)
+        return stats;
+
+    // FIFO cache: a vertex is a hit while fewer than `cacheSize` misses
+    // happened since it was inserted.
+    std::vector<size_t> insertedAt(vertexCount, 0);
+    size_t misses = 0;
+    for (uint32_t index : indices) {
+        if (insertedAt[index] == 0 || misses - insertedAt[index] >= cacheSize) {
+            misses++;
+            insertedAt[index] = misses;
+        }
+    }
+    stats.acmr = float(misses) / float(indices.size() / 3);
+    stats.atvr = float(misses) / float(vertexCount);
+    return stats;
+}
+
+namespace {
+
+struct VertexHash {
+    size_t operator()(const Vertex3& v) const {
+        // FNV-1a over the raw bytes, matching the bitwise equality below.
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&v);
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < sizeof(Vertex3); i++)
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        return size_t(hash);
+    }
+};
+
+struct VertexEqual {
+    bool operator()(const Vertex3& a, const Vertex3& b) const {
+        return std::memcmp(&a, &b, sizeof(Vertex3)) == 0;
+    }
+};
+
+} // namespace
+
+void WeldVertices(Mesh& mesh, LinearArena* scratch) {
+    LinearArena local;
+    LinearArena& arena = scratch ? *scratch : local;
+    ArenaScope scope(arena);
+    // One node per unique vertex, all from the arena. The key is looked up
+    // first: emplace() makes a node before finding a duplicate, and the arena
+    // only gets it back on the rewind
+    std::unordered_map<Vertex3, uint32_t, VertexHash, VertexEqual, ArenaAllocator<std::pair<const Vertex3, uint32_t>>> unique(
+        mesh.vertices.size(), VertexHash(), VertexEqual(), arena);
+    std::vector<Vertex3> vertices;
+    vertices.reserve(mesh.vertices.size());
+    ArenaVector<uint32_t> remap(mesh.vertices.size(), arena);
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        auto found = unique.find(mesh.vertices[i]);
+        if (found == unique.end()) {
+            found = unique.emplace(mesh.vertices[i], uint32_t(vertices.size())).first;
+            vertices.push_back(mesh.vertices[i]);
+        }
+        remap[i] = found->second;
+    }
+    for (uint32_t& index : mesh.indices)
+        index = remap[index];
+    mesh.vertices.swap(vertices);
+}
+
+void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, unsigned cacheSize,
+    std::vector<size_t>* clusters, LinearArena* scratch) {
+    const size_t triangleCount = indices.size() / 3;
+    if (clusters)
+        clusters->assign(1, 0);
+    if (triangleCount == 0)
+        return;
+
+    LinearArena local;
+    LinearArena& arena = scratch ? *scratch : local;
+    ArenaScope scope(arena);
+
+    // Vertex -> triangles adjacency (CSR layout).
+    ArenaVector<uint32_t> live(vertexCount, 0, arena);
+    for (uint32_t index : indices)
+        live[index]++;
+    ArenaVector<size_t> offsets(vertexCount + 1, 0, arena);
+    for (size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + live[v];
+    ArenaVector<uint32_t> adjacency(indices.size(), arena);
+    {
+        ArenaVector<size_t> fill(offsets.begin(), offsets.end() - 1, arena);
+        for (size_t t = 0; t < triangleCount; t++)
+            for (size_t k = 0; k < 3; k++)
+                adjacency[fill[indices[3 * t + k]]++] = uint32_t(t);
+    }
+
+    ArenaVector<size_t> cacheTime(vertexCount, 0, arena);
+    ArenaVector<bool> emitted(triangleCount, false, arena);
+    ArenaVector<uint32_t> deadEnd(arena);
+    ArenaVector<uint32_t> candidates(arena);
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    size_t time = cacheSize + 1;
+    size_t cursor = 0;
+    long fanning = 0;
+    while (fanning >= 0) {
+        // Emit every remaining triangle around the fanning vertex.
+        candidates.clear();
+        for (size_t a = offsets[size_t(fanning)]; a < offsets[size_t(fanning) + 1]; a++) {
+            uint32_t t = adjacency[a];
+            if (emitted[t])
+                continue;
+            for (size_t k = 0; k < 3; k++) {
+                uint32_t v = indices[3 * t + k];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - cacheTime[v] > cacheSize)
+                    cacheTime[v] = time++;
+            }
+            emitted[t] = true;
+        }
+
+        // Next fanning vertex: the candidate that is still in the cache and
+        // will stay there while its remaining triangles are emitted.
+        long next = -1;
+        size_t best = 0;
+        for (uint32_t v : candidates) {
+            if (live[v] == 0)
+                continue;
+            size_t priority = 0;
+            if (time - cacheTime[v] + 2 * live[v] <= cacheSize)
+                priority = time - cacheTime[v];
+            if (priority > best || next < 0) {
+                best = priority;
+                next = long(v);
+            }
+        }
+
+        if (next >= 0 && time - cacheTime[size_t(next)] > cacheSize) {
+            // The cache is effectively flushed here, a free cluster boundary.
+            if (clusters && clusters->back() != output.size())
+                clusters->push_back(output.size());
+        } else if (next < 0) {
+            // Dead end: fall back to recently used vertices, then scan.
+            while (!deadEnd.empty() && next < 0) {
+                uint32_t v = deadEnd.back();
+                deadEnd.pop_back();
+                if (live[v] > 0)
+                    next = long(v);
+            }
+            while (next < 0 && cursor < vertexCount) {
+                if (live[cursor] > 0)
+                    next = long(cursor);
+                cursor++;
+            }
+            if (clusters && next >= 0 && clusters->back() != output.size())
+                clusters->push_back(output.size());
+        }
+        fanning = next;
+    }
+
+    indices.swap(output);
+}
+
+void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex3>& vertices,
+    const std::vector<size_t>& clusters) {
+    if (clusters.size() < 2 || indices.empty())
+        return;
+
+    glm::vec3 meshCentroid(0);
+    for (uint32_t index : indices)
+        meshCentroid += vertices[index].position;
+    meshCentroid /= float(indices.size());
+
+    struct Cluster {
+        size_t begin, end;
+        float sortKey;
+    };
+    std::vector<Cluster> sorted;
+    for (size_t c = 0; c < clusters.size(); c++) {
+        Cluster cluster;
+        cluster.begin = clusters[c];
+        cluster.end = c + 1 < clusters.size() ? clusters[c + 1] : indices.size();
+        glm::vec3 centroid(0), normal(0);
+        float totalArea = 0;
+        for (size_t i = cluster.begin; i < cluster.end; i += 3) {
+            const glm::vec3& p0 = vertices[indices[i + 0]].position;
+            const glm::vec3& p1 = vertices[indices[i + 1]].position;
+            const glm::vec3& p2 = vertices[indices[i + 2]].position;
+            glm::vec3 areaNormal = glm::cross(p1 - p0, p2 - p0);
+            float area = glm::length(areaNormal);
+            centroid += (p0 + p1 + p2) * (area / 3.f);
+            normal += areaNormal;
+            totalArea += area;
+        }
+        centroid = totalArea > 0 ? centroid / totalArea : vertices[indices[cluster.begin]].position;
+        float length = glm::length(normal);
+        // Clusters facing away from the centre occlude the inside: draw those first.
+        cluster.sortKey = length > 0 ? glm::dot(centroid - meshCentroid, normal / length) : 0;
+        sorted.push_back(cluster);
+    }
+
+    std::stable_sort(sorted.begin(), sorted.end(),
+        [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    for (const Cluster& cluster : sorted)
+        output.insert(output.end(), indices.begin() + long(cluster.begin), indices.begin() + long(cluster.end));
+    indices.swap(output);
+}
+
+void OptimizeVertexFetch(Mesh& mesh) {
+    const uint32_t UNUSED = ~0u;
+    std::vector<uint32_t> remap(mesh.vertices.size(), UNUSED);
+    std::vector<Vertex3> vertices;
+    vertices.reserve(mesh.vertices.size());
+    for (uint32_t& index : mesh.indices) {
+        if (remap[index] == UNUSED) {
+            remap[index] = uint32_t(vertices.size());
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    mesh.vertices.swap(vertices);
+}
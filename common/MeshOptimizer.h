@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "LinearArena.h"
+#include "Mesh.h"
+
+// Post-transform vertex cache statistics for a FIFO cache of `cacheSize`
+// entries. ACMR = cache misses per triangle (0.5 is the ideal for large
+// regular meshes, 3 means no reuse at all), ATVR = cache misses per vertex
+// (1 is ideal).
+struct VertexCacheStats {
+    float acmr = 0;
+    float atvr = 0;
+};
+
+VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount,
+    unsigned cacheSize = 16);
+
+// The temporaries of the functions below taking a `scratch` arena come from
+// it, rewound before they return; from a local arena when it is null.
+
+// Merges bit-identical vertices and rewrites the index buffer accordingly.
+void WeldVertices(Mesh& mesh, LinearArena* scratch = nullptr);
+
+// Reorders triangles for post-transform cache locality (Tipsify, Sander et
+// al. 2007). If `clusters` is given, it receives the index offsets where the
+// simulated cache was flushed or the algorithm restarted from a dead end;
+// reordering the clusters between those points barely affects the cache hit
+// rate, which is what OptimizeOverdraw() relies on.
+void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount,
+    unsigned cacheSize = 16, std::vector<size_t>* clusters = nullptr, LinearArena* scratch = nullptr);
+
+// Reorders the clusters produced by OptimizeVertexCache() so that triangles
+// likely to occlude others are drawn first, using a view-independent sort on
+// each cluster's position and orientation relative to the mesh centroid.
+void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex3>& vertices,
+    const std::vector<size_t>& clusters);
+
+// Reorders vertices in order of first use by the index buffer so vertex
+// fetches are sequential; unreferenced vertices are dropped.
+void OptimizeVertexFetch(Mesh& mesh);
@@ -0,0 +1,151 @@
+#include "MeshPool.h"
+#include "RenderBackend.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+// Gives `buffer` `size` bytes holding its first `used` bytes, creating it
+// the first time; the handle stays the same, so uploads still pending land
+// in the new storage.
+uint32_t GrowBuffer(RenderBackend& backend, uint32_t buffer, size_t used, size_t size) {
+	if (buffer == RENDER_NONE)
+		return backend.CreateBuffer(size, nullptr);
+	backend.ResizeBuffer(buffer, size, used);
+	return buffer;
+}
+
+} // namespace
+
+bool MeshPool::Create(RenderBackend& backend, uint32_t vertexStride, size_t vertexCapacity, size_t indexCapacity) {
+	m_Backend = &backend;
+	m_VertexStride = vertexStride;
+	m_VertexCount = m_IndexCount = 0;
+	m_VertexCapacity = m_IndexCapacity = 0;
+	Reserve(std::max<size_t>(vertexCapacity, 1), std::max<size_t>(indexCapacity, 1));
+	return m_VertexBuffer != RENDER_NONE && m_IndexBuffer != RENDER_NONE;
+}
+
+void MeshPool::Destroy() {
+	FreeRetired();
+	m_FreeVertices.clear();
+	m_FreeIndices.clear();
+	if (m_Backend) {
+		m_Backend->DestroyBuffer(m_VertexBuffer);
+		m_Backend->DestroyBuffer(m_IndexBuffer);
+	}
+	m_VertexBuffer = m_IndexBuffer = RENDER_NONE;
+	m_VertexCapacity = m_VertexCount = m_IndexCapacity = m_IndexCount = 0;
+}
+
+void MeshPool::Reserve(size_t vertexCount, size_t indexCount) {
+	if (vertexCount > m_VertexCapacity) {
+		size_t capacity = std::max(vertexCount, m_VertexCapacity * 2);
+		m_VertexBuffer = GrowBuffer(*m_Backend, m_VertexBuffer, m_VertexCount * m_VertexStride, capacity * m_VertexStride);
+		m_VertexCapacity = capacity;
+	}
+	if (indexCount > m_IndexCapacity) {
+		size_t capacity = std::max(indexCount, m_IndexCapacity * 2);
+		m_IndexBuffer = GrowBuffer(*m_Backend, m_IndexBuffer, m_IndexCount * sizeof(uint32_t), capacity * sizeof(uint32_t));
+		m_IndexCapacity = capacity;
+	}
+}
+
+// First fit: takes `count` items from the first span holding enough.
+bool MeshPool::TakeSpan(std::vector<Span>& spans, size_t count, size_t& offset) {
+	if (count == 0)
+		return false;
+	for (size_t i = 0; i < spans.size(); i++) {
+		if (spans[i].count < count)
+			continue;
+		offset = spans[i].offset;
+		spans[i].offset += count;
+		spans[i].count -= count;
+		if (spans[i].count == 0)
+			spans.erase(spans.begin() + i);
+		return true;
+	}
+	return false;
+}
+
+// Merges the items into the spans next to them; a span reaching the end of
+// the used items `used` shrinks it instead.
+void MeshPool::FreeSpan(std::vector<Span>& spans, size_t& used, size_t offset, size_t count) {
+	if (count == 0)
+		return;
+	auto next = std::lower_bound(spans.begin(), spans.end(), offset,
+		[](const Span& span, size_t offset) { return span.offset < offset; });
+	if (next != spans.begin() && std::prev(next)->offset + std::prev(next)->count == offset) {
+		next = std::prev(next);
+		next->count += count;
+	} else {
+		next = spans.insert(next, { offset, count });
+	}
+	auto after = std::next(next);
+	if (after != spans.end() && next->offset + next->count == after->offset) {
+		next->count += after->count;
+		spans.erase(after);
+	}
+	if (next->offset + next->count == used) {
+		used = next->offset;
+		spans.erase(next);
+	}
+}
+
+// Waits for the fences of the removed meshes and frees their space. They
+// were removed at least a frame ago, when the mesh replacing them was
+// added, so the GPU is normally done with them already.
+void MeshPool::FreeRetired() {
+	for (const Retired& retired : m_Retired) {
+		m_Backend->WaitFence(retired.fence);
+		FreeSpan(m_FreeVertices, m_VertexCount, size_t(retired.range.baseVertex), retired.range.vertexCount);
+		FreeSpan(m_FreeIndices, m_IndexCount, retired.range.firstIndex, retired.range.indexCount);
+	}
+	m_Retired.clear();
+}
+
+MeshRange MeshPool::Allocate(size_t vertexCount, size_t indexCount) {
+	FreeRetired();
+	size_t baseVertex, firstIndex;
+	if (!TakeSpan(m_FreeVertices, vertexCount, baseVertex)) {
+		Reserve(m_VertexCount + vertexCount, 0);
+		baseVertex = m_VertexCount;
+		m_VertexCount += vertexCount;
+	}
+	if (!TakeSpan(m_FreeIndices, indexCount, firstIndex)) {
+		Reserve(0, m_IndexCount + indexCount);
+		firstIndex = m_IndexCount;
+		m_IndexCount += indexCount;
+	}
+
+	MeshRange range;
+	range.baseVertex = int32_t(baseVertex);
+	range.firstIndex = uint32_t(firstIndex);
+	range.vertexCount = uint32_t(vertexCount);
+	range.indexCount = uint32_t(indexCount);
+	return range;
+}
+
+void MeshPool::Remove(const MeshRange& range) {
+	if (range.vertexCount == 0 && range.indexCount == 0)
+		return;
+	m_Retired.push_back({ range, m_Backend->InsertFence() });
+}
+
+MeshRange MeshPool::Add(const void* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount) {
+	MeshRange range = Allocate(vertexCount, indexCount);
+	m_Backend->WriteBuffer(m_VertexBuffer, size_t(range.baseVertex) * m_VertexStride, vertices, vertexCount * m_VertexStride);
+	m_Backend->WriteBuffer(m_IndexBuffer, range.firstIndex * sizeof(uint32_t), indices, indexCount * sizeof(uint32_t));
+	return range;
+}
+
+MeshRange MeshPool::AddAsync(std::shared_ptr<const void> vertices, size_t vertexCount, std::shared_ptr<const void> indices,
+	size_t indexCount, uint32_t uploads[2]) {
+	MeshRange range = Allocate(vertexCount, indexCount);
+	uploads[0] = m_Backend->WriteBufferAsync(m_VertexBuffer, size_t(range.baseVertex) * m_VertexStride, std::move(vertices),
+		vertexCount * m_VertexStride);
+	uploads[1] = m_Backend->WriteBufferAsync(m_IndexBuffer, range.firstIndex * sizeof(uint32_t), std::move(indices),
+		indexCount * sizeof(uint32_t));
+	return range;
+}
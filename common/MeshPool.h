@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "RenderDevice.h"
+
+class RenderBackend;
+
+// Where a mesh landed in a MeshPool, in the units of
+// DrawElementsIndirectCommand (baseVertex, firstIndex).
+struct MeshRange {
+	int32_t baseVertex = 0;
+	uint32_t firstIndex = 0;
+	uint32_t vertexCount = 0;
+	uint32_t indexCount = 0;
+};
+
+// One large vertex buffer and one large index buffer shared by every mesh of
+// a given vertex format, drawn with a pipeline of that format. Meshes are
+// added with Add() or AddAsync(), in the first free space large enough or
+// appended; the buffers grow by doubling (copied on the GPU) and keep their
+// handles. A mesh given back with Remove() is fenced, its space is free once
+// the GPU is done with the commands submitted before.
+class MeshPool
+{
+private:
+	// Free vertices or indices, sorted by offset and never adjacent.
+	struct Span
+	{
+		size_t offset;
+		size_t count;
+	};
+
+	struct Retired
+	{
+		MeshRange range;
+		uint32_t fence;
+	};
+
+	RenderBackend* m_Backend = nullptr;
+	uint32_t m_VertexBuffer = RENDER_NONE;
+	uint32_t m_IndexBuffer = RENDER_NONE;
+	uint32_t m_VertexStride = 0;
+	size_t m_VertexCapacity = 0;
+	size_t m_VertexCount = 0;
+	size_t m_IndexCapacity = 0;
+	size_t m_IndexCount = 0;
+	std::vector<Span> m_FreeVertices;
+	std::vector<Span> m_FreeIndices;
+	std::vector<Retired> m_Retired;
+
+	static bool TakeSpan(std::vector<Span>& spans, size_t count, size_t& offset);
+	static void FreeSpan(std::vector<Span>& spans, size_t& used, size_t offset, size_t count);
+	void Reserve(size_t vertexCount, size_t indexCount);
+	void FreeRetired();
+	MeshRange Allocate(size_t vertexCount, size_t indexCount);
+
+public:
+	bool Create(RenderBackend& backend, uint32_t vertexStride, size_t vertexCapacity = 1 << 16, size_t indexCapacity = 1 << 18);
+	void Destroy();
+
+	// `vertices` holds vertexCount * vertexStride bytes. Indices are relative
+	// to the mesh, the returned baseVertex is applied at draw time.
+	MeshRange Add(const void* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount);
+	// Same through RenderBackend::WriteBufferAsync(), the data is kept alive
+	// until copied; the mesh can be drawn once both `uploads` are done.
+	MeshRange AddAsync(std::shared_ptr<const void> vertices, size_t vertexCount, std::shared_ptr<const void> indices,
+		size_t indexCount, uint32_t uploads[2]);
+	// Frees the range of a mesh no longer drawn from the next commands on;
+	// the space is reused by a later Add(), after waiting for the fence if
+	// the GPU may still read it.
+	void Remove(const MeshRange& range);
+
+	inline uint32_t GetVertexBuffer() const { return m_VertexBuffer; }
+	inline uint32_t GetIndexBuffer() const { return m_IndexBuffer; }
+	inline uint32_t GetVertexStride() const { return m_VertexStride; }
+	// End of the used vertices and indices, free space before it included.
+	inline size_t GetVertexCount() const { return m_VertexCount; }
+	inline size_t GetIndexCount() const { return m_IndexCount; }
+};
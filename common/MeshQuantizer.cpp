@@ -0,0 +1,98 @@
+#include "MeshQuantizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/packing.hpp>
+
+namespace {
+
+int16_t PackSnorm16(float value) {
+    return int16_t(std::lround(glm::clamp(value, -1.f, 1.f) * 32767.f));
+}
+
+float UnpackSnorm16(int16_t value) {
+    // Same conversion as GL >= 4.2 for normalized signed attributes.
+    return std::max(float(value) / 32767.f, -1.f);
+}
+
+glm::vec2 OctahedralEncode(const glm::vec3& n) {
+    glm::vec3 v = n / (std::abs(n.x) + std::abs(n.y) + std::abs(n.z));
+    glm::vec2 e(v.x, v.y);
+    if (v.z < 0) {
+        e.x = (1.f - std::abs(v.y)) * (v.x >= 0 ? 1.f : -1.f);
+        e.y = (1.f - std::abs(v.x)) * (v.y >= 0 ? 1.f : -1.f);
+    }
+    return e;
+}
+
+glm::vec3 OctahedralDecode(const glm::vec2& e) {
+    glm::vec3 n(e.x, e.y, 1.f - std::abs(e.x) - std::abs(e.y));
+    float t = std::max(-n.z, 0.f);
+    n.x += n.x >= 0 ? -t : t;
+    n.y += n.y >= 0 ? -t : t;
+    return glm::normalize(n);
+}
+
+} // namespace
+
+glm::vec3 DecodePosition(const QuantizedMesh& quantized, const PackedVertex3& vertex) {
+    glm::vec3 q(vertex.position[0], vertex.position[1], vertex.position[2]);
+    return quantized.positionOffset + quantized.positionScale * (q / 65535.f);
+}
+
+glm::vec3 DecodeNormal(const PackedVertex3& vertex) {
+    return OctahedralDecode(glm::vec2(UnpackSnorm16(vertex.normal[0]), UnpackSnorm16(vertex.normal[1])));
+}
+
+glm::vec2 DecodeTexCoords(const PackedVertex3& vertex) {
+    return glm::vec2(glm::unpackHalf1x16(vertex.texCoords[0]), glm::unpackHalf1x16(vertex.texCoords[1]));
+}
+
+void QuantizeMesh(const Mesh& mesh, QuantizedMesh& quantized, QuantizationError* error) {
+    glm::vec3 boundsMin(0), boundsMax(0);
+    if (!mesh.vertices.empty()) {
+        boundsMin = boundsMax = mesh.vertices[0].position;
+        for (const Vertex3& vertex : mesh.vertices) {
+            boundsMin = glm::min(boundsMin, vertex.position);
+            boundsMax = glm::max(boundsMax, vertex.position);
+        }
+    }
+    quantized.positionOffset = boundsMin;
+    quantized.positionScale = boundsMax - boundsMin;
+    quantized.vertices.resize(mesh.vertices.size());
+
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        const Vertex3& vertex = mesh.vertices[i];
+        PackedVertex3& packed = quantized.vertices[i];
+        for (int axis = 0; axis < 3; axis++) {
+            float extent = quantized.positionScale[axis];
+            float t = extent > 0 ? (vertex.position[axis] - boundsMin[axis]) / extent : 0;
+            packed.position[axis] = uint16_t(std::lround(glm::clamp(t, 0.f, 1.f) * 65535.f));
+        }
+        packed.position[3] = 0;
+
+        // Meshes without normals have zero vectors, encode those as +Z.
+        float length = glm::length(vertex.normal);
+        glm::vec2 octahedral = length > 0 ? OctahedralEncode(vertex.normal / length) : glm::vec2(0);
+        packed.normal[0] = PackSnorm16(octahedral.x);
+        packed.normal[1] = PackSnorm16(octahedral.y);
+
+        packed.texCoords[0] = glm::packHalf1x16(vertex.texCoords.x);
+        packed.texCoords[1] = glm::packHalf1x16(vertex.texCoords.y);
+
+        if (error) {
+            error->position = std::max(error->position, glm::length(DecodePosition(quantized, packed) - vertex.position));
+            if (length > 0) {
+                float cosine = glm::clamp(glm::dot(DecodeNormal(packed), vertex.normal / length), -1.f, 1.f);
+                error->normalDegrees = std::max(error->normalDegrees, glm::degrees(std::acos(cosine)));
+            }
+            glm::vec2 uvError = glm::abs(DecodeTexCoords(packed) - vertex.texCoords);
+            error->texCoords = std::max(error->texCoords, std::max(uvError.x, uvError.y));
+        }
+    }
+
+    if (error) {
+        float extent = std::max(quantized.positionScale.x, std::max(quantized.positionScale.y, quantized.positionScale.z));
+        error->positionRelative = extent > 0 ? error->position / extent : 0;
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Mesh.h"
+
+// Packed 16-byte counterpart of Vertex3 (32 bytes):
+// - position: 16-bit unorm per axis, relative to the mesh bounding box
+//   (decoded as positionOffset + positionScale * q), the 4th component pads
+//   the normal to a 4-byte boundary,
+// - normal: octahedral encoding in 2x16-bit snorm,
+// - texCoords: 2x half float.
+// Decoded by the QUANTIZED permutation of shaders/3d.vs.glsl.
+struct PackedVertex3 {
+    uint16_t position[4];
+    int16_t normal[2];
+    uint16_t texCoords[2];
+};
+
+struct QuantizedMesh {
+    std::vector<PackedVertex3> vertices;
+    glm::vec3 positionOffset = glm::vec3(0);
+    glm::vec3 positionScale = glm::vec3(0);
+};
+
+// Largest decode error over all vertices, measured by decoding the packed
+// data the same way the vertex shader does.
+struct QuantizationError {
+    float position = 0;         // in mesh units
+    float positionRelative = 0; // relative to the largest bounding box extent
+    float normalDegrees = 0;
+    float texCoords = 0;
+};
+
+void QuantizeMesh(const Mesh& mesh, QuantizedMesh& quantized, QuantizationError* error = nullptr);
+
+glm::vec3 DecodePosition(const QuantizedMesh& quantized, const PackedVertex3& vertex);
+glm::vec3 DecodeNormal(const PackedVertex3& vertex);
+glm::vec2 DecodeTexCoords(const PackedVertex3& vertex);
@@ -0,0 +1,401 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include "MeshOptimizer.h"
+
+namespace {
+
+enum VertexKind : uint8_t {
+    KIND_MANIFOLD,  // interior vertex, collapses onto any neighbour
+    KIND_BORDER,    // on an open border, collapses along the border
+    KIND_SEAM,      // two wedges along a seam, collapses along the seam
+    KIND_LOCKED,    // never collapsed
+};
+
+// Levels with fewer triangles are not worth a separate draw range.
+const size_t MIN_LOD_TRIANGLES = 64;
+// Extra weight of the planes keeping borders and seams in place.
+const double BORDER_WEIGHT = 10;
+const double SEAM_WEIGHT = 1;
+
+struct Quadric {
+    double a00 = 0, a11 = 0, a22 = 0, a01 = 0, a02 = 0, a12 = 0;
+    double b0 = 0, b1 = 0, b2 = 0, c = 0;
+    double w = 0;
+};
+
+void AddPlane(Quadric& q, const glm::dvec3& n, double d, double weight) {
+    q.a00 += weight * n.x * n.x;
+    q.a11 += weight * n.y * n.y;
+    q.a22 += weight * n.z * n.z;
+    q.a01 += weight * n.x * n.y;
+    q.a02 += weight * n.x * n.z;
+    q.a12 += weight * n.y * n.z;
+    q.b0 += weight * n.x * d;
+    q.b1 += weight * n.y * d;
+    q.b2 += weight * n.z * d;
+    q.c += weight * d * d;
+    q.w += weight;
+}
+
+void AddQuadric(Quadric& q, const Quadric& r) {
+    q.a00 += r.a00; q.a11 += r.a11; q.a22 += r.a22;
+    q.a01 += r.a01; q.a02 += r.a02; q.a12 += r.a12;
+    q.b0 += r.b0; q.b1 += r.b1; q.b2 += r.b2;
+    q.c += r.c;
+    q.w += r.w;
+}
+
+// Weighted mean squared distance of `p` to the planes of `q` (and `r`).
+double Evaluate(const Quadric& q, const Quadric& r, const glm::vec3& p) {
+    double x = p.x, y = p.y, z = p.z;
+    double e = (q.a00 + r.a00) * x * x + (q.a11 + r.a11) * y * y + (q.a22 + r.a22) * z * z +
+        2 * ((q.a01 + r.a01) * x * y + (q.a02 + r.a02) * x * z + (q.a12 + r.a12) * y * z) +
+        2 * ((q.b0 + r.b0) * x + (q.b1 + r.b1) * y + (q.b2 + r.b2) * z) + q.c + r.c;
+    double w = q.w + r.w;
+    return w > 0 ? std::max(e, 0.0) / w : 0;
+}
+
+struct PositionHash {
+    size_t operator()(const glm::vec3& p) const {
+        uint32_t bits[3];
+        std::memcpy(bits, &p, sizeof(bits));
+        return size_t(bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u);
+    }
+};
+
+struct PositionEqual {
+    bool operator()(const glm::vec3& a, const glm::vec3& b) const {
+        return std::memcmp(&a, &b, sizeof(glm::vec3)) == 0;
+    }
+};
+
+inline uint64_t EdgeKey(uint32_t a, uint32_t b) {
+    return (uint64_t(a) << 32) | b;
+}
+
+inline bool HasEdge(const ArenaVector<uint64_t>& edges, uint32_t a, uint32_t b) {
+    return std::binary_search(edges.begin(), edges.end(), EdgeKey(a, b));
+}
+
+// Open edges have no opposite half-edge in index space: borders and seams.
+// openNext/openPrev link each vertex to its open neighbours (~0u if none),
+// which is all that is needed for border and seam vertices, which have
+// exactly one of each.
+void FindOpenEdges(const std::vector<uint32_t>& indices, ArenaVector<uint64_t>& edges,
+    ArenaVector<uint32_t>& openNext, ArenaVector<uint32_t>& openPrev,
+    ArenaVector<uint8_t>* openOut, ArenaVector<uint8_t>* openIn) {
+    edges.clear();
+    edges.reserve(indices.size());
+    for (size_t i = 0; i < indices.size(); i += 3)
+        for (size_t k = 0; k < 3; k++)
+            edges.push_back(EdgeKey(indices[i + k], indices[i + (k + 1) % 3]));
+    std::sort(edges.begin(), edges.end());
+
+    std::fill(openNext.begin(), openNext.end(), ~0u);
+    std::fill(openPrev.begin(), openPrev.end(), ~0u);
+    for (uint64_t edge : edges) {
+        uint32_t a = uint32_t(edge >> 32), b = uint32_t(edge);
+        if (HasEdge(edges, b, a))
+            continue;
+        openNext[a] = b;
+        openPrev[b] = a;
+        if (openOut) {
+            (*openOut)[a] = uint8_t(std::min((*openOut)[a] + 1, 255));
+            (*openIn)[b] = uint8_t(std::min((*openIn)[b] + 1, 255));
+        }
+    }
+}
+
+struct Collapse {
+    uint32_t v, u;      // v moves onto u
+    uint32_t v2, u2;    // other seam wedge, ~0u otherwise
+    double error;
+};
+
+} // namespace
+
+float SimplifyMesh(const std::vector<uint32_t>& indices, const std::vector<Vertex3>& vertices,
+    size_t targetIndexCount, float targetError, std::vector<uint32_t>& destination, LinearArena* scratch) {
+    destination = indices;
+    const size_t vertexCount = vertices.size();
+    if (indices.size() <= targetIndexCount || vertexCount == 0)
+        return 0;
+    LinearArena local;
+    LinearArena& arena = scratch ? *scratch : local;
+    ArenaScope scope(arena);
+
+    // Vertices sharing a position form a ring of wedges; positionOf[] is the
+    // first vertex of the ring and indexes the per-position data below.
+    ArenaVector<uint32_t> positionOf(vertexCount, arena), wedgeNext(vertexCount, arena);
+    ArenaVector<uint32_t> wedgeCount(vertexCount, 0, arena);
+    {
+        // The nodes are only needed to find the rings; looked up before
+        // emplace(), which would make a node for every wedge
+        ArenaScope positionsScope(arena);
+        std::unordered_map<glm::vec3, uint32_t, PositionHash, PositionEqual, ArenaAllocator<std::pair<const glm::vec3, uint32_t>>>
+            positions(vertexCount, PositionHash(), PositionEqual(), arena);
+        for (uint32_t i = 0; i < vertexCount; i++) {
+            auto found = positions.find(vertices[i].position);
+            bool inserted = found == positions.end();
+            if (inserted)
+                found = positions.emplace(vertices[i].position, i).first;
+            uint32_t first = found->second;
+            positionOf[i] = first;
+            wedgeNext[i] = i;
+            if (!inserted) {
+                wedgeNext[i] = wedgeNext[first];
+                wedgeNext[first] = i;
+            }
+            wedgeCount[first]++;
+        }
+    }
+
+    // Classify vertices from the open edges of the input.
+    ArenaVector<uint64_t> edges(arena), positionEdges(arena);
+    ArenaVector<uint32_t> openNext(vertexCount, arena), openPrev(vertexCount, arena);
+    ArenaVector<uint8_t> openOut(vertexCount, 0, arena), openIn(vertexCount, 0, arena);
+    FindOpenEdges(indices, edges, openNext, openPrev, &openOut, &openIn);
+    positionEdges.reserve(edges.size());
+    for (uint64_t edge : edges)
+        positionEdges.push_back(EdgeKey(positionOf[uint32_t(edge >> 32)], positionOf[uint32_t(edge)]));
+    std::sort(positionEdges.begin(), positionEdges.end());
+    auto isBorderEdge = [&](uint32_t a, uint32_t b) {
+        return !HasEdge(positionEdges, positionOf[b], positionOf[a]);
+    };
+
+    ArenaVector<uint8_t> kind(vertexCount, KIND_LOCKED, arena);
+    for (uint32_t i = 0; i < vertexCount; i++) {
+        uint32_t first = positionOf[i];
+        if (first != i)
+            continue;
+        VertexKind k = KIND_LOCKED;
+        if (wedgeCount[first] == 1) {
+            if (openOut[i] == 0 && openIn[i] == 0)
+                k = KIND_MANIFOLD;
+            else if (openOut[i] == 1 && openIn[i] == 1 &&
+                isBorderEdge(i, openNext[i]) && isBorderEdge(openPrev[i], i))
+                k = KIND_BORDER;
+        } else if (wedgeCount[first] == 2) {
+            uint32_t other = wedgeNext[i];
+            bool seam = true;
+            for (uint32_t w : { i, other })
+                seam = seam && openOut[w] == 1 && openIn[w] == 1 &&
+                    !isBorderEdge(w, openNext[w]) && !isBorderEdge(openPrev[w], w);
+            if (seam)
+                k = KIND_SEAM;
+        }
+        uint32_t w = i;
+        do {
+            kind[w] = uint8_t(k);
+            w = wedgeNext[w];
+        } while (w != i);
+    }
+
+    // Quadrics per position: triangle planes weighted by area, plus planes
+    // perpendicular to the surface along borders and seams.
+    ArenaVector<Quadric> quadrics(vertexCount, arena);
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        glm::dvec3 p0 = vertices[indices[i + 0]].position;
+        glm::dvec3 p1 = vertices[indices[i + 1]].position;
+        glm::dvec3 p2 = vertices[indices[i + 2]].position;
+        glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        double length = glm::length(normal);
+        if (length == 0)
+            continue;
+        normal /= length;
+        for (size_t k = 0; k < 3; k++)
+            AddPlane(quadrics[positionOf[indices[i + k]]], normal, -glm::dot(normal, p0), length * 0.5);
+
+        for (size_t k = 0; k < 3; k++) {
+            uint32_t a = indices[i + k], b = indices[i + (k + 1) % 3];
+            if (openNext[a] != b)
+                continue;
+            glm::dvec3 pa = vertices[a].position, pb = vertices[b].position;
+            glm::dvec3 edge = pb - pa;
+            glm::dvec3 side = glm::cross(edge, normal);
+            double sideLength = glm::length(side);
+            if (sideLength == 0)
+                continue;
+            side /= sideLength;
+            double weight = glm::dot(edge, edge) * (isBorderEdge(a, b) ? BORDER_WEIGHT : SEAM_WEIGHT);
+            AddPlane(quadrics[positionOf[a]], side, -glm::dot(side, pa), weight);
+            AddPlane(quadrics[positionOf[b]], side, -glm::dot(side, pa), weight);
+        }
+    }
+
+    // Finds the wedge of the other side of a seam that has to follow v -> u.
+    auto seamPair = [&](uint32_t v, uint32_t u, uint32_t& v2, uint32_t& u2) {
+        v2 = wedgeNext[v];
+        u2 = ~0u;
+        if (openNext[v2] != ~0u && positionOf[openNext[v2]] == positionOf[u])
+            u2 = openNext[v2];
+        else if (openPrev[v2] != ~0u && positionOf[openPrev[v2]] == positionOf[u])
+            u2 = openPrev[v2];
+        return u2 != ~0u;
+    };
+
+    auto canCollapse = [&](uint32_t v, uint32_t u, Collapse& collapse) {
+        collapse.v = v;
+        collapse.u = u;
+        collapse.v2 = collapse.u2 = ~0u;
+        bool open = openNext[v] == u || openPrev[v] == u;
+        switch (kind[v]) {
+        case KIND_MANIFOLD:
+            return true;
+        case KIND_BORDER:
+            return open && (kind[u] == KIND_BORDER || kind[u] == KIND_LOCKED);
+        case KIND_SEAM:
+            return open && (kind[u] == KIND_SEAM || kind[u] == KIND_LOCKED) &&
+                seamPair(v, u, collapse.v2, collapse.u2);
+        default:
+            return false;
+        }
+    };
+
+    const double targetErrorSquared = double(targetError) * double(targetError);
+    const size_t targetTriangles = targetIndexCount / 3;
+    double maxErrorSquared = 0;
+    ArenaVector<Collapse> candidates(arena);
+    ArenaVector<uint32_t> collapseTo(vertexCount, arena);
+    ArenaVector<uint8_t> touched(vertexCount, arena);
+    ArenaVector<size_t> adjacencyOffsets(vertexCount + 1, arena);
+    ArenaVector<uint32_t> adjacency(arena);
+
+    bool firstPass = true;
+    while (destination.size() > targetIndexCount) {
+        // Open edges move as borders and seams get simplified.
+        if (!firstPass)
+            FindOpenEdges(destination, edges, openNext, openPrev, nullptr, nullptr);
+        firstPass = false;
+        const size_t triangleCount = destination.size() / 3;
+
+        // Position -> triangles adjacency (CSR layout), for the flip test.
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (uint32_t index : destination)
+            adjacencyOffsets[positionOf[index] + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        adjacency.resize(destination.size());
+        {
+            ArenaScope passScope(arena);
+            ArenaVector<size_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1, arena);
+            for (size_t i = 0; i < destination.size(); i++)
+                adjacency[fill[positionOf[destination[i]]]++] = uint32_t(i / 3);
+        }
+
+        candidates.clear();
+        for (size_t i = 0; i < destination.size(); i += 3) {
+            for (size_t k = 0; k < 3; k++) {
+                uint32_t a = destination[i + k], b = destination[i + (k + 1) % 3];
+                if (positionOf[a] == positionOf[b])
+                    continue;
+                Collapse collapse;
+                if (canCollapse(a, b, collapse)) {
+                    collapse.error = Evaluate(quadrics[positionOf[a]], quadrics[positionOf[b]], vertices[b].position);
+                    candidates.push_back(collapse);
+                }
+                if (canCollapse(b, a, collapse)) {
+                    collapse.error = Evaluate(quadrics[positionOf[b]], quadrics[positionOf[a]], vertices[a].position);
+                    candidates.push_back(collapse);
+                }
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(),
+            [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+        for (uint32_t i = 0; i < vertexCount; i++)
+            collapseTo[i] = i;
+        std::fill(touched.begin(), touched.end(), 0);
+        size_t remaining = triangleCount;
+        size_t applied = 0;
+
+        for (const Collapse& collapse : candidates) {
+            if (collapse.error > targetErrorSquared || remaining <= targetTriangles)
+                break;
+            uint32_t pv = positionOf[collapse.v], pu = positionOf[collapse.u];
+            if (touched[pv] || touched[pu])
+                continue;
+
+            // Reject collapses that flip a remaining triangle around v.
+            const glm::vec3& target = vertices[collapse.u].position;
+            bool flips = false;
+            for (size_t a = adjacencyOffsets[pv]; a < adjacencyOffsets[pv + 1] && !flips; a++) {
+                const uint32_t* triangle = &destination[3 * size_t(adjacency[a])];
+                glm::vec3 p[3], q[3];
+                bool degenerate = false;
+                for (size_t k = 0; k < 3; k++) {
+                    p[k] = q[k] = vertices[triangle[k]].position;
+                    if (positionOf[triangle[k]] == pu)
+                        degenerate = true;
+                    if (positionOf[triangle[k]] == pv)
+                        q[k] = target;
+                }
+                if (degenerate)
+                    continue;
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+                flips = glm::dot(before, after) <= 0;
+            }
+            if (flips)
+                continue;
+
+            collapseTo[collapse.v] = collapse.u;
+            if (collapse.v2 != ~0u)
+                collapseTo[collapse.v2] = collapse.u2;
+            AddQuadric(quadrics[pu], quadrics[pv]);
+            maxErrorSquared = std::max(maxErrorSquared, collapse.error);
+            applied++;
+            remaining -= kind[collapse.v] == KIND_BORDER ? 1 : 2;
+
+            // Collapses in the same pass must not share triangles.
+            touched[pu] = 1;
+            for (size_t a = adjacencyOffsets[pv]; a < adjacencyOffsets[pv + 1]; a++)
+                for (size_t k = 0; k < 3; k++)
+                    touched[positionOf[destination[3 * size_t(adjacency[a]) + k]]] = 1;
+        }
+        if (applied == 0)
+            break;
+
+        size_t write = 0;
+        for (size_t i = 0; i < destination.size(); i += 3) {
+            uint32_t a = collapseTo[destination[i + 0]];
+            uint32_t b = collapseTo[destination[i + 1]];
+            uint32_t c = collapseTo[destination[i + 2]];
+            if (positionOf[a] == positionOf[b] || positionOf[b] == positionOf[c] || positionOf[a] == positionOf[c])
+                continue;
+            destination[write++] = a;
+            destination[write++] = b;
+            destination[write++] = c;
+        }
+        destination.resize(write);
+    }
+
+    return float(std::sqrt(maxErrorSquared));
+}
+
+void BuildLodChain(Mesh& mesh, size_t maxLevels, float reduction, LinearArena* scratch) {
+    mesh.lods.clear();
+    mesh.lods.push_back({ 0, uint32_t(mesh.indices.size()), 0 });
+
+    std::vector<uint32_t> previous(mesh.indices);
+    std::vector<uint32_t> level;
+    float error = 0;
+    while (mesh.lods.size() < maxLevels) {
+        size_t target = size_t(float(previous.size() / 3) * reduction) * 3;
+        if (target < MIN_LOD_TRIANGLES * 3)
+            break;
+        // Each level starts from the previous one, errors add up.
+        error += SimplifyMesh(previous, mesh.vertices, target, FLT_MAX, level, scratch);
+        if (level.size() * 10 > previous.size() * 9)
+            break;
+        OptimizeVertexCache(level, mesh.vertices.size(), 16, nullptr, scratch);
+        mesh.lods.push_back({ uint32_t(mesh.indices.size()), uint32_t(level.size()), error });
+        mesh.indices.insert(mesh.indices.end(), level.begin(), level.end());
+        previous.swap(level);
+    }
+}
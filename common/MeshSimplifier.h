@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "LinearArena.h"
+#include "Mesh.h"
+
+// Edge-collapse simplification driven by quadric error metrics (Garland &
+// Heckbert 1997). Vertices are only moved onto existing vertices, so the
+// vertex buffer is shared by every level and only the index buffer changes.
+//
+// Vertices that share a position but not their normal or texture coordinates
+// (seams) are collapsed along the seam only, both sides at once, and open
+// borders only along the border, so simplified levels neither crack nor
+// smear attributes across seams. Anything more complex is left in place.
+//
+// Stops when `destination` has at most `targetIndexCount` indices or when
+// no collapse below `targetError` (in mesh units) is left. Returns the
+// largest error introduced, in mesh units. The temporaries come from
+// `scratch` when given, rewound before returning, from a local arena
+// otherwise.
+float SimplifyMesh(const std::vector<uint32_t>& indices, const std::vector<Vertex3>& vertices,
+    size_t targetIndexCount, float targetError, std::vector<uint32_t>& destination, LinearArena* scratch = nullptr);
+
+// Fills mesh.lods with up to `maxLevels` levels: level 0 is the current index
+// buffer, each following level has about `reduction` times the triangles of
+// the previous one and is appended to mesh.indices. Stops early when a mesh
+// cannot be reduced further. Every level reuses the `scratch` memory.
+void BuildLodChain(Mesh& mesh, size_t maxLevels = 8, float reduction = 0.5f, LinearArena* scratch = nullptr);
@@ -0,0 +1,323 @@
+#include "Meshlets.h"
+
+#include <algorithm>
+#include <cmath>
+#include "MeshOptimizer.h"
+#include "OcclusionBuffer.h"
+
+namespace {
+
+// Growth scoring: each new vertex costs 1, a triangle facing away from the
+// meshlet's average direction up to CONE_WEIGHT * 2.
+const float CONE_WEIGHT = 2.f;
+// Unassigned triangles looked at on each side in spatial order when a
+// meshlet has no neighbour left to grow into.
+const size_t NEAREST_WINDOW = 32;
+
+// Interleaves the low 10 bits of x, y and z.
+uint32_t MortonCode(uint32_t x, uint32_t y, uint32_t z) {
+    auto spread = [](uint32_t v) {
+        v &= 0x3FF;
+        v = (v | (v << 16)) & 0x030000FF;
+        v = (v | (v << 8)) & 0x0300F00F;
+        v = (v | (v << 4)) & 0x030C30C3;
+        v = (v | (v << 2)) & 0x09249249;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1) | (spread(z) << 2);
+}
+
+void ComputeBounds(const Mesh& mesh, Meshlet& meshlet) {
+    const uint32_t* indices = &mesh.indices[meshlet.indexOffset];
+    glm::vec3 boundsMin = mesh.vertices[indices[0]].position, boundsMax = boundsMin;
+    glm::vec3 normalSum(0);
+    for (uint32_t i = 0; i < meshlet.indexCount; i += 3) {
+        const glm::vec3& p0 = mesh.vertices[indices[i + 0]].position;
+        const glm::vec3& p1 = mesh.vertices[indices[i + 1]].position;
+        const glm::vec3& p2 = mesh.vertices[indices[i + 2]].position;
+        boundsMin = glm::min(boundsMin, glm::min(p0, glm::min(p1, p2)));
+        boundsMax = glm::max(boundsMax, glm::max(p0, glm::max(p1, p2)));
+        normalSum += glm::cross(p1 - p0, p2 - p0);
+    }
+    meshlet.center = (boundsMin + boundsMax) * 0.5f;
+    meshlet.radius = 0;
+    for (uint32_t i = 0; i < meshlet.indexCount; i++)
+        meshlet.radius = std::max(meshlet.radius, glm::length(mesh.vertices[indices[i]].position - meshlet.center));
+
+    // The cone only helps while every triangle faces less than 90 degrees
+    // away from the axis.
+    meshlet.coneAxis = glm::vec3(0, 0, 1);
+    meshlet.coneCutoff = 2;
+    float length = glm::length(normalSum);
+    if (length == 0)
+        return;
+    meshlet.coneAxis = normalSum / length;
+    float minDot = 1;
+    for (uint32_t i = 0; i < meshlet.indexCount; i += 3) {
+        const glm::vec3& p0 = mesh.vertices[indices[i + 0]].position;
+        const glm::vec3& p1 = mesh.vertices[indices[i + 1]].position;
+        const glm::vec3& p2 = mesh.vertices[indices[i + 2]].position;
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float area = glm::length(normal);
+        if (area > 0)
+            minDot = std::min(minDot, glm::dot(meshlet.coneAxis, normal / area));
+    }
+    if (minDot > 0)
+        meshlet.coneCutoff = std::sqrt(1 - minDot * minDot);
+}
+
+} // namespace
+
+void BuildMeshlets(Mesh& mesh, size_t maxTriangles, LinearArena* scratch) {
+    mesh.meshlets.clear();
+    const size_t indexCount = mesh.lods.empty() ? mesh.indices.size() : mesh.lods[0].indexCount;
+    const size_t triangleCount = indexCount / 3;
+    const size_t vertexCount = mesh.vertices.size();
+    if (triangleCount == 0)
+        return;
+    LinearArena local;
+    LinearArena& arena = scratch ? *scratch : local;
+    ArenaScope scope(arena);
+
+    ArenaVector<glm::vec3> normals(triangleCount, arena), centroids(triangleCount, arena);
+    glm::vec3 boundsMin = mesh.vertices[mesh.indices[0]].position, boundsMax = boundsMin;
+    for (size_t t = 0; t < triangleCount; t++) {
+        const glm::vec3& p0 = mesh.vertices[mesh.indices[3 * t + 0]].position;
+        const glm::vec3& p1 = mesh.vertices[mesh.indices[3 * t + 1]].position;
+        const glm::vec3& p2 = mesh.vertices[mesh.indices[3 * t + 2]].position;
+        normals[t] = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(normals[t]);
+        if (length > 0)
+            normals[t] /= length;
+        centroids[t] = (p0 + p1 + p2) / 3.f;
+        boundsMin = glm::min(boundsMin, centroids[t]);
+        boundsMax = glm::max(boundsMax, centroids[t]);
+    }
+
+    // Vertices split along normal or UV seams share a position; growing
+    // over positions keeps the meshlets from stopping at the seams.
+    ArenaVector<uint32_t> positionOf(vertexCount, arena);
+    {
+        ArenaVector<uint32_t> sorted(vertexCount, arena);
+        for (uint32_t v = 0; v < vertexCount; v++)
+            sorted[v] = v;
+        auto less = [&mesh](uint32_t a, uint32_t b) {
+            const glm::vec3& pa = mesh.vertices[a].position;
+            const glm::vec3& pb = mesh.vertices[b].position;
+            return pa.x != pb.x ? pa.x < pb.x : pa.y != pb.y ? pa.y < pb.y : pa.z < pb.z;
+        };
+        std::sort(sorted.begin(), sorted.end(), less);
+        for (size_t i = 0; i < vertexCount; i++)
+            positionOf[sorted[i]] = i > 0 && !less(sorted[i - 1], sorted[i]) ? positionOf[sorted[i - 1]] : sorted[i];
+    }
+
+    // Position -> triangles adjacency (CSR layout).
+    ArenaVector<size_t> offsets(vertexCount + 1, 0, arena);
+    for (size_t i = 0; i < indexCount; i++)
+        offsets[positionOf[mesh.indices[i]] + 1]++;
+    for (size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] += offsets[v];
+    ArenaVector<uint32_t> adjacency(indexCount, arena);
+    {
+        ArenaVector<size_t> fill(offsets.begin(), offsets.end() - 1, arena);
+        for (size_t i = 0; i < indexCount; i++)
+            adjacency[fill[positionOf[mesh.indices[i]]]++] = uint32_t(i / 3);
+    }
+
+    // Triangles in Morton order of their centroids: meshlets are started in
+    // that order, and one that runs out of neighbours (a small disconnected
+    // part) continues with a nearby unassigned triangle found through it.
+    ArenaVector<uint32_t> order(triangleCount, arena), rank(triangleCount, arena);
+    {
+        ArenaVector<uint32_t> codes(triangleCount, arena);
+        glm::vec3 extent = boundsMax - boundsMin;
+        float scale = 1023.f / std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-20f));
+        for (size_t t = 0; t < triangleCount; t++) {
+            glm::vec3 cell = (centroids[t] - boundsMin) * scale;
+            codes[t] = MortonCode(uint32_t(cell.x), uint32_t(cell.y), uint32_t(cell.z));
+            order[t] = uint32_t(t);
+        }
+        std::sort(order.begin(), order.end(), [&codes](uint32_t a, uint32_t b) {
+            return codes[a] != codes[b] ? codes[a] < codes[b] : a < b;
+        });
+        for (size_t i = 0; i < triangleCount; i++)
+            rank[order[i]] = uint32_t(i);
+    }
+
+    ArenaVector<bool> assigned(triangleCount, false, arena);
+    // Id (+1) of the last meshlet that used a vertex / queued a triangle.
+    ArenaVector<uint32_t> vertexStamp(vertexCount, 0, arena), frontierStamp(triangleCount, 0, arena);
+    ArenaVector<uint32_t> frontier(arena), members(arena);
+    members.reserve(maxTriangles);
+    ArenaVector<uint32_t> output(arena);
+    output.reserve(indexCount);
+    ArenaVector<uint32_t> vertexLocal(vertexCount, ~0u, arena), localVertices(arena);
+    localVertices.reserve(3 * maxTriangles);
+    std::vector<uint32_t> meshletIndices;
+    size_t cursor = 0;
+
+    while (true) {
+        while (cursor < triangleCount && assigned[order[cursor]])
+            cursor++;
+        if (cursor == triangleCount)
+            break;
+        const uint32_t stamp = uint32_t(mesh.meshlets.size() + 1);
+        frontier.clear();
+        members.clear();
+        glm::vec3 normalSum(0);
+
+        uint32_t next = order[cursor];
+        while (true) {
+            assigned[next] = true;
+            members.push_back(next);
+            normalSum += normals[next];
+            for (size_t k = 0; k < 3; k++) {
+                uint32_t v = mesh.indices[3 * size_t(next) + k];
+                vertexStamp[v] = stamp;
+                uint32_t position = positionOf[v];
+                for (size_t a = offsets[position]; a < offsets[position + 1]; a++) {
+                    uint32_t t = adjacency[a];
+                    if (!assigned[t] && frontierStamp[t] != stamp) {
+                        frontierStamp[t] = stamp;
+                        frontier.push_back(t);
+                    }
+                }
+            }
+            if (members.size() >= maxTriangles)
+                break;
+
+            // Next triangle: fewest new vertices, closest to the average normal.
+            float length = glm::length(normalSum);
+            glm::vec3 axis = length > 0 ? normalSum / length : glm::vec3(0);
+            float bestScore = 0;
+            size_t best = frontier.size();
+            for (size_t f = 0; f < frontier.size(); f++) {
+                uint32_t t = frontier[f];
+                if (assigned[t])
+                    continue;
+                float score = CONE_WEIGHT * (1 - glm::dot(axis, normals[t]));
+                for (size_t k = 0; k < 3; k++)
+                    score += vertexStamp[mesh.indices[3 * size_t(t) + k]] == stamp ? 0.f : 1.f;
+                if (best == frontier.size() || score < bestScore) {
+                    bestScore = score;
+                    best = f;
+                }
+            }
+            if (best < frontier.size()) {
+                next = frontier[best];
+                frontier[best] = frontier.back();
+                frontier.pop_back();
+                continue;
+            }
+
+            // No neighbour left: the unassigned triangle nearest to the
+            // meshlet's last one among those close to it in Morton order,
+            // not facing away from the meshlet so its cone stays usable
+            const glm::vec3& from = centroids[next];
+            size_t nearest = triangleCount;
+            float nearestDistance = 0;
+            size_t first = rank[next] > NEAREST_WINDOW ? rank[next] - NEAREST_WINDOW : 0;
+            size_t last = std::min(triangleCount, size_t(rank[next]) + NEAREST_WINDOW + 1);
+            for (size_t i = first; i < last; i++) {
+                uint32_t t = order[i];
+                if (assigned[t] || glm::dot(axis, normals[t]) < 0)
+                    continue;
+                glm::vec3 offset = centroids[t] - from;
+                float distance = glm::dot(offset, offset);
+                if (nearest == triangleCount || distance < nearestDistance) {
+                    nearest = t;
+                    nearestDistance = distance;
+                }
+            }
+            if (nearest == triangleCount)
+                break;
+            next = uint32_t(nearest);
+        }
+
+        // Growth order is not cache friendly, reorder each meshlet on its
+        // own local vertices.
+        meshletIndices.clear();
+        localVertices.clear();
+        for (uint32_t t : members) {
+            for (size_t k = 0; k < 3; k++) {
+                uint32_t v = mesh.indices[3 * size_t(t) + k];
+                if (vertexLocal[v] == ~0u) {
+                    vertexLocal[v] = uint32_t(localVertices.size());
+                    localVertices.push_back(v);
+                }
+                meshletIndices.push_back(vertexLocal[v]);
+            }
+        }
+        OptimizeVertexCache(meshletIndices, localVertices.size(), 16, nullptr, &arena);
+
+        Meshlet meshlet;
+        meshlet.indexOffset = uint32_t(output.size());
+        meshlet.indexCount = uint32_t(meshletIndices.size());
+        for (uint32_t index : meshletIndices)
+            output.push_back(localVertices[index]);
+        for (uint32_t v : localVertices)
+            vertexLocal[v] = ~0u;
+        mesh.meshlets.push_back(meshlet);
+    }
+
+    std::copy(output.begin(), output.end(), mesh.indices.begin());
+    for (Meshlet& meshlet : mesh.meshlets)
+        ComputeBounds(mesh, meshlet);
+}
+
+size_t CullMeshlets(const std::vector<Meshlet>& meshlets, const glm::mat4& transformWithProjection,
+    const glm::vec3& eye, std::vector<DrawElementsIndirectCommand>& commands,
+    const OcclusionBuffer* occlusion, float occlusionMargin, size_t* occluded) {
+    // Frustum planes in object space (Gribb & Hartmann), normalized so the
+    // sphere test works in object space units.
+    const glm::mat4& m = transformWithProjection;
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++)
+        rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+    glm::vec4 planes[6] = {
+        rows[3] + rows[0], rows[3] - rows[0],
+        rows[3] + rows[1], rows[3] - rows[1],
+        rows[3] + rows[2], rows[3] - rows[2],
+    };
+    for (glm::vec4& plane : planes)
+        plane /= glm::length(glm::vec3(plane));
+
+    // Commands already in the vector belong to other objects, with their
+    // pool offsets applied, and are never merged into
+    const size_t firstCommand = commands.size();
+    size_t visible = 0;
+    for (const Meshlet& meshlet : meshlets) {
+        bool inside = true;
+        for (const glm::vec4& plane : planes)
+            inside = inside && glm::dot(glm::vec3(plane), meshlet.center) + plane.w >= -meshlet.radius;
+        if (!inside)
+            continue;
+
+        // Every triangle faces away if the eye sees the whole sphere from
+        // behind all the normals of the cone.
+        if (meshlet.coneCutoff < 1) {
+            glm::vec3 toCenter = meshlet.center - eye;
+            if (glm::dot(meshlet.coneAxis, toCenter) >=
+                glm::length(toCenter) * meshlet.coneCutoff + meshlet.radius * (1 + meshlet.coneCutoff))
+                continue;
+        }
+
+        if (occlusion) {
+            glm::vec3 extent(meshlet.radius + occlusionMargin);
+            if (!occlusion->IsVisible(meshlet.center - extent, meshlet.center + extent, transformWithProjection)) {
+                if (occluded)
+                    (*occluded)++;
+                continue;
+            }
+        }
+
+        visible++;
+        if (commands.size() > firstCommand && commands.back().firstIndex + commands.back().count == meshlet.indexOffset) {
+            commands.back().count += meshlet.indexCount;
+        } else {
+            DrawElementsIndirectCommand command = { meshlet.indexCount, 1, meshlet.indexOffset, 0, 0 };
+            commands.push_back(command);
+        }
+    }
+    return visible;
+}
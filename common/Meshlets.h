@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "LinearArena.h"
+#include "Mesh.h"
+
+class OcclusionBuffer;
+
+// Same layout as the commands read by glMultiDrawElementsIndirect.
+struct DrawElementsIndirectCommand {
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    uint32_t baseInstance;
+};
+
+// Splits mesh.indices (level 0, before any LOD is appended) into meshlets of
+// at most `maxTriangles` triangles, grown over shared positions (across
+// normal and UV seams) while keeping their facing direction coherent, and
+// continued with nearby triangles facing the same way when a part runs out.
+// Reorders the triangles so that each meshlet is a contiguous index range. Fills mesh.meshlets. The temporaries
+// come from `scratch` when given, rewound before returning.
+void BuildMeshlets(Mesh& mesh, size_t maxTriangles = 64, LinearArena* scratch = nullptr);
+
+// CPU culling pass: appends a draw command for every meshlet that intersects
+// the view frustum and is not entirely backfacing. `transformWithProjection`
+// is the object to clip space matrix and `eye` the camera position in object
+// space. Consecutive visible meshlets are merged into one command, never
+// into the commands `commands` held before the call. Returns the number of
+// meshlets kept.
+//
+// With an `occlusion` buffer, the remaining meshlets are also tested against
+// it, their bounds grown by `occlusionMargin` (object space) to absorb the
+// error of simplified occluders; `occluded` is incremented for each one rejected.
+size_t CullMeshlets(const std::vector<Meshlet>& meshlets, const glm::mat4& transformWithProjection,
+    const glm::vec3& eye, std::vector<DrawElementsIndirectCommand>& commands,
+    const OcclusionBuffer* occlusion = nullptr, float occlusionMargin = 0, size_t* occluded = nullptr);
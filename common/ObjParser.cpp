@@ -0,0 +1,930 @@
+#include "ObjParser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <set>
+#include <string>
+#include <thread>
+#include "MappedFile.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OBJPARSER_SSE2 1
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+using tinyobj::real_t;
+
+namespace {
+
+// Everything the line parser extracts from a range of the file. Vertex data is
+// final and face indices are already zero-based; relative (negative) indices
+// are counted from the start of the range, flagged in `relative` and resolved
+// once the number of vertices in the preceding ranges is known.
+struct ObjCommand {
+    enum Type { MtlLib, UseMtl, Group, Object, Smoothing };
+    Type type;
+    size_t face;        // number of faces of the chunk parsed before this command
+    size_t line;        // chunk-local line number
+    std::string arg;
+    unsigned int smoothing = 0;
+    bool emptyName = false;
+};
+
+struct ObjMessage {
+    size_t line;
+    std::string text;   // completed with the global line number when merged
+};
+
+struct ObjChunk {
+    std::vector<real_t> v, vn, vt, vc;
+    std::vector<int> indices;           // (v, vt, vn) per face vertex
+    std::vector<unsigned int> faceSizes;
+    std::vector<unsigned char> relative; // per face vertex: RELATIVE_* bits
+    std::vector<size_t> faceLines;
+    std::vector<ObjCommand> commands;
+    std::vector<ObjMessage> warnings;
+    bool allColors = true;
+    bool warnedUnsupported = false;
+    bool failed = false;
+    ObjMessage error;
+    size_t lines = 0;
+};
+
+const unsigned char RELATIVE_V = 1;
+const unsigned char RELATIVE_VT = 2;
+const unsigned char RELATIVE_VN = 4;
+
+inline bool IsSpace(char c) { return c == ' ' || c == '\t'; }
+inline bool IsDigit(char c) { return static_cast<unsigned int>(c - '0') < 10u; }
+inline bool IsBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+inline const char* SkipBlanks(const char* p, const char* e) {
+    while (p < e && IsSpace(*p)) p++;
+    return p;
+}
+
+inline const char* TokenEnd(const char* p, const char* e) {
+    while (p < e && !IsBlank(*p)) p++;
+    return p;
+}
+
+inline const char* IndexEnd(const char* p, const char* e) {
+    while (p < e && !IsBlank(*p) && *p != '/') p++;
+    return p;
+}
+
+inline const char* FindNewline(const char* p, const char* e) {
+#ifdef OBJPARSER_SSE2
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (e - p >= 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+        if (mask) {
+#ifdef _MSC_VER
+            unsigned long bit;
+            _BitScanForward(&bit, static_cast<unsigned long>(mask));
+            return p + bit;
+#else
+            return p + __builtin_ctz(static_cast<unsigned int>(mask));
+#endif
+        }
+        p += 16;
+    }
+#endif
+    const void* hit = std::memchr(p, '\n', static_cast<size_t>(e - p));
+    return hit ? static_cast<const char*>(hit) : e;
+}
+
+// Same behaviour as atoi() on a token that starts at a non-space character.
+inline int ParseIndex(const char* p, const char* e) {
+    bool negative = false;
+    if (p < e && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    int value = 0;
+    while (p < e && IsDigit(*p))
+        value = value * 10 + (*p++ - '0');
+    return negative ? -value : value;
+}
+
+// Port of tinyobj's tryParseDouble, used for anything the fast path rejects
+// (exponents, long mantissas, leading dots) so both readers agree on odd input.
+bool ParseDoubleSlow(const char* s, const char* e, double* result) {
+    if (s >= e) return false;
+
+    double mantissa = 0.0;
+    int exponent = 0;
+    char sign = '+';
+    char expSign = '+';
+    const char* curr = s;
+    int read = 0;
+    bool leadingDot = false;
+
+    if (*curr == '+' || *curr == '-') {
+        sign = *curr++;
+        if (curr != e && *curr == '.') leadingDot = true;
+    } else if (*curr == '.') {
+        leadingDot = true;
+    } else if (!IsDigit(*curr)) {
+        return false;
+    }
+
+    if (!leadingDot) {
+        while (curr != e && IsDigit(*curr)) {
+            mantissa = mantissa * 10 + (*curr++ - '0');
+            read++;
+        }
+        if (read == 0) return false;
+    }
+
+    if (curr != e) {
+        bool parseExponent = false;
+        if (*curr == '.') {
+            static const double powLut[] = { 1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001 };
+            curr++;
+            read = 1;
+            while (curr != e && IsDigit(*curr)) {
+                mantissa += (*curr - '0') * (read < 8 ? powLut[read] : std::pow(10.0, -read));
+                read++;
+                curr++;
+            }
+            parseExponent = curr != e && (*curr == 'e' || *curr == 'E');
+        } else {
+            parseExponent = *curr == 'e' || *curr == 'E';
+        }
+
+        if (parseExponent) {
+            curr++;
+            if (curr != e && (*curr == '+' || *curr == '-')) {
+                expSign = *curr++;
+            } else if (curr == e || !IsDigit(*curr)) {
+                return false;
+            }
+            read = 0;
+            while (curr != e && IsDigit(*curr)) {
+                if (exponent > 2147483647 / 10) return false;
+                exponent = exponent * 10 + (*curr++ - '0');
+                read++;
+            }
+            if (read == 0) return false;
+            if (expSign == '-') exponent = -exponent;
+        }
+    }
+
+    *result = (sign == '+' ? 1 : -1) *
+        (exponent ? std::ldexp(mantissa * std::pow(5.0, exponent), exponent) : mantissa);
+    return true;
+}
+
+// Fast path for the fixed-precision decimals exporters write ("-12.345678"):
+// the digits are accumulated as one integer and scaled by an exact power of
+// ten, which is a single correctly rounded division.
+inline bool ParseDouble(const char* s, const char* e, double* result) {
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+    };
+    const char* p = s;
+    bool negative = false;
+    if (p < e && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    uint64_t mantissa = 0;
+    int digits = 0;
+    const char* digitsBegin = p;
+    while (p < e && IsDigit(*p)) {
+        mantissa = mantissa * 10 + uint64_t(*p++ - '0');
+        digits++;
+    }
+    int fraction = 0;
+    if (digits > 0 && p < e && *p == '.') {
+        p++;
+        while (p < e && IsDigit(*p)) {
+            mantissa = mantissa * 10 + uint64_t(*p++ - '0');
+            fraction++;
+        }
+        digits += fraction;
+    }
+    if (digits == 0 || digits > 15 || (p < e && (*p == 'e' || *p == 'E')) || p == digitsBegin)
+        return ParseDoubleSlow(s, e, result);
+    double value = double(mantissa) / pow10[fraction];
+    *result = negative ? -value : value;
+    return true;
+}
+
+inline real_t ParseReal(const char** token, const char* e, double defaultValue) {
+    const char* p = SkipBlanks(*token, e);
+    const char* end = TokenEnd(p, e);
+    double value = defaultValue;
+    ParseDouble(p, end, &value);
+    *token = end;
+    return static_cast<real_t>(value);
+}
+
+inline bool ParseReal(const char** token, const char* e, real_t* out) {
+    const char* p = SkipBlanks(*token, e);
+    const char* end = TokenEnd(p, e);
+    double value;
+    bool ok = ParseDouble(p, end, &value);
+    if (ok) *out = static_cast<real_t>(value);
+    *token = end;
+    return ok;
+}
+
+const char* const ZERO_INDEX_WARNING =
+    "A zero value index found (will have a value of -1 for normal and tex indices. Line ";
+const char* const FACE_ERROR =
+    "Failed to parse `f' line (e.g. a zero value for vertex index or invalid relative vertex index). Line ";
+
+// Converts one OBJ index to zero-based. `count` is the number of elements of
+// that kind parsed so far in the chunk.
+inline bool FixIndex(ObjChunk& chunk, int raw, int count, bool allowZero, size_t line, int* out,
+    unsigned char* relative, unsigned char bit) {
+    if (raw > 0) {
+        *out = raw - 1;
+        return true;
+    }
+    if (raw == 0) {
+        chunk.warnings.push_back({ line, ZERO_INDEX_WARNING });
+        *out = -1;
+        return allowZero;
+    }
+    // Relative to the end of the chunk so far; MergeChunks() adds the number
+    // of elements in the preceding chunks.
+    *out = count + raw;
+    *relative |= bit;
+    return true;
+}
+
+// Parses "i", "i/j", "i//k" or "i/j/k" and appends the (v, vt, vn) triple.
+bool ParseTriple(ObjChunk& chunk, const char** token, const char* e, size_t line) {
+    const char* p = *token;
+    int vCount = int(chunk.v.size() / 3);
+    int vnCount = int(chunk.vn.size() / 3);
+    int vtCount = int(chunk.vt.size() / 2);
+    int vi = -1, vti = -1, vni = -1;
+    unsigned char relative = 0;
+
+    if (!FixIndex(chunk, ParseIndex(p, e), vCount, false, line, &vi, &relative, RELATIVE_V))
+        return false;
+    chunk.indices.push_back(vi);
+    p = IndexEnd(p, e);
+    if (p < e && *p == '/') {
+        p++;
+        if (p < e && *p == '/') {
+            p++;
+            chunk.indices.push_back(-1);
+            if (!FixIndex(chunk, ParseIndex(p, e), vnCount, true, line, &vni, &relative, RELATIVE_VN))
+                return false;
+            chunk.indices.push_back(vni);
+            chunk.relative.push_back(relative);
+            *token = IndexEnd(p, e);
+            return true;
+        }
+        if (!FixIndex(chunk, ParseIndex(p, e), vtCount, true, line, &vti, &relative, RELATIVE_VT))
+            return false;
+        chunk.indices.push_back(vti);
+        p = IndexEnd(p, e);
+        if (p < e && *p == '/') {
+            p++;
+            if (!FixIndex(chunk, ParseIndex(p, e), vnCount, true, line, &vni, &relative, RELATIVE_VN))
+                return false;
+            chunk.indices.push_back(vni);
+            chunk.relative.push_back(relative);
+            *token = IndexEnd(p, e);
+            return true;
+        }
+        chunk.indices.push_back(-1);
+        chunk.relative.push_back(relative);
+        *token = p;
+        return true;
+    }
+    chunk.relative.push_back(relative);
+    chunk.indices.push_back(-1);
+    chunk.indices.push_back(-1);
+    *token = p;
+    return true;
+}
+
+void ParseChunk(const char* begin, const char* end, ObjChunk& chunk) {
+    const char* p = begin;
+    while (p < end) {
+        const char* lineEnd = FindNewline(p, end);
+        const char* next = lineEnd < end ? lineEnd + 1 : end;
+        const size_t line = ++chunk.lines;
+        const char* e = lineEnd;
+        if (e > p && e[-1] == '\r') e--;
+        const char* token = SkipBlanks(p, e);
+        p = next;
+
+        if (token == e || *token == '#')
+            continue;
+        const size_t length = size_t(e - token);
+        const char c0 = token[0];
+        const char c1 = length > 1 ? token[1] : '\0';
+        const char c2 = length > 2 ? token[2] : '\0';
+
+        if (c0 == 'v' && IsSpace(c1)) {
+            token += 2;
+            real_t x = ParseReal(&token, e, 0.0);
+            real_t y = ParseReal(&token, e, 0.0);
+            real_t z = ParseReal(&token, e, 0.0);
+            real_t r, g, b;
+            bool hasColor = ParseReal(&token, e, &r) && ParseReal(&token, e, &g) && ParseReal(&token, e, &b);
+            if (!hasColor) r = g = b = 1;
+            chunk.allColors &= hasColor;
+            chunk.v.push_back(x);
+            chunk.v.push_back(y);
+            chunk.v.push_back(z);
+            chunk.vc.push_back(r);
+            chunk.vc.push_back(g);
+            chunk.vc.push_back(b);
+            continue;
+        }
+
+        if (c0 == 'v' && c1 == 'n' && IsSpace(c2)) {
+            token += 3;
+            chunk.vn.push_back(ParseReal(&token, e, 0.0));
+            chunk.vn.push_back(ParseReal(&token, e, 0.0));
+            chunk.vn.push_back(ParseReal(&token, e, 0.0));
+            continue;
+        }
+
+        if (c0 == 'v' && c1 == 't' && IsSpace(c2)) {
+            token += 3;
+            chunk.vt.push_back(ParseReal(&token, e, 0.0));
+            chunk.vt.push_back(ParseReal(&token, e, 0.0));
+            continue;
+        }
+
+        if (c0 == 'f' && IsSpace(c1)) {
+            token = SkipBlanks(token + 2, e);
+            size_t first = chunk.indices.size();
+            while (token < e) {
+                if (!ParseTriple(chunk, &token, e, line)) {
+                    chunk.failed = true;
+                    chunk.error = { line, FACE_ERROR };
+                    return;
+                }
+                while (token < e && IsBlank(*token)) token++;
+            }
+            chunk.faceSizes.push_back(unsigned((chunk.indices.size() - first) / 3));
+            chunk.faceLines.push_back(line);
+            continue;
+        }
+
+        if (length >= 6 && std::strncmp(token, "usemtl", 6) == 0) {
+            const char* name = SkipBlanks(token + 6, e);
+            chunk.commands.push_back({ ObjCommand::UseMtl, chunk.faceSizes.size(), line,
+                std::string(name, TokenEnd(name, e)) });
+            continue;
+        }
+
+        if (length >= 7 && std::strncmp(token, "mtllib", 6) == 0 && IsSpace(token[6])) {
+            chunk.commands.push_back({ ObjCommand::MtlLib, chunk.faceSizes.size(), line,
+                std::string(token + 7, e) });
+            continue;
+        }
+
+        if (c0 == 'g' && IsSpace(c1)) {
+            // names[0] is the 'g' itself; the rest are joined with a space.
+            std::string name;
+            bool empty = true;
+            const char* q = TokenEnd(token, e);
+            while (true) {
+                while (q < e && IsBlank(*q)) q++;
+                if (q >= e) break;
+                const char* qe = TokenEnd(q, e);
+                if (!empty) name += ' ';
+                name.append(q, qe);
+                empty = false;
+                q = qe;
+            }
+            ObjCommand command = { ObjCommand::Group, chunk.faceSizes.size(), line, name };
+            command.emptyName = empty;
+            chunk.commands.push_back(command);
+            continue;
+        }
+
+        if (c0 == 'o' && IsSpace(c1)) {
+            chunk.commands.push_back({ ObjCommand::Object, chunk.faceSizes.size(), line,
+                std::string(token + 2, e) });
+            continue;
+        }
+
+        if (c0 == 's' && IsSpace(c1)) {
+            token = SkipBlanks(token + 2, e);
+            if (token == e)
+                continue;
+            unsigned int id = 0;
+            if (!(e - token >= 3 && std::strncmp(token, "off", 3) == 0)) {
+                int value = ParseIndex(token, e);
+                id = value < 0 ? 0 : unsigned(value);
+            }
+            ObjCommand command = { ObjCommand::Smoothing, chunk.faceSizes.size(), line, std::string() };
+            command.smoothing = id;
+            chunk.commands.push_back(command);
+            continue;
+        }
+
+        if (((c0 == 'l' || c0 == 'p' || c0 == 't') && IsSpace(c1)) ||
+            (c0 == 'v' && c1 == 'w' && IsSpace(c2))) {
+            if (!chunk.warnedUnsupported) {
+                chunk.warnings.push_back({ line, "FastObjReader: l/p/t/vw statements are not supported and were skipped (first at line " });
+                chunk.warnedUnsupported = true;
+            }
+        }
+        // Ignore unknown command.
+    }
+}
+
+template <typename T>
+int PointInPolygon(int nvert, const T* vertx, const T* verty, T testx, T testy) {
+    int i, j, c = 0;
+    for (i = 0, j = nvert - 1; i < nvert; j = i++) {
+        if (((verty[i] > testy) != (verty[j] > testy)) &&
+            (testx < (vertx[j] - vertx[i]) * (testy - verty[i]) / (verty[j] - verty[i]) + vertx[i]))
+            c = !c;
+    }
+    return c;
+}
+
+struct FaceVertex {
+    int v, vt, vn;
+};
+
+// Builds shape_t data from the parsed faces with the exact semantics of
+// tinyobj's LoadObj/exportGroupsToShape. Faces are emitted as soon as they are
+// seen, which is equivalent because the material and name a face is exported
+// with can only change through a command that flushes it first.
+class ShapeBuilder {
+public:
+    ShapeBuilder(std::vector<tinyobj::shape_t>& shapes, std::vector<tinyobj::material_t>& materials,
+        std::vector<std::string>& materialPaths, const std::vector<real_t>& v, const std::string& mtlSearchPath,
+        bool triangulate, std::string& warn, std::string& err)
+        : m_Shapes(shapes), m_Materials(materials), m_MaterialPaths(materialPaths), m_V(v),
+        m_MtlSearchPath(mtlSearchPath), m_MtlReader(mtlSearchPath), m_Triangulate(triangulate), m_Warn(warn), m_Err(err) {}
+
+    void Command(const ObjCommand& command, size_t line) {
+        switch (command.type) {
+        case ObjCommand::MtlLib:
+            LoadMaterials(command.arg);
+            break;
+        case ObjCommand::UseMtl: {
+            int id = -1;
+            auto it = m_MaterialMap.find(command.arg);
+            if (it != m_MaterialMap.end())
+                id = it->second;
+            else
+                m_Warn += "material [ '" + command.arg + "' ] not found in .mtl\n";
+            if (id != m_Material) {
+                m_Pending = false;
+                m_Material = id;
+            }
+            break;
+        }
+        case ObjCommand::Group:
+            if (!m_Shape.mesh.indices.empty())
+                m_Shapes.push_back(m_Shape);
+            m_Shape = tinyobj::shape_t();
+            m_Pending = false;
+            if (command.emptyName) {
+                m_Warn += "Empty group name. line: " + std::to_string(line) + "\n";
+                m_Name = "";
+            } else {
+                m_Name = command.arg;
+            }
+            break;
+        case ObjCommand::Object:
+            if (!m_Shape.mesh.indices.empty())
+                m_Shapes.push_back(m_Shape);
+            m_Shape = tinyobj::shape_t();
+            m_Pending = false;
+            m_Name = command.arg;
+            break;
+        case ObjCommand::Smoothing:
+            m_Smoothing = command.smoothing;
+            break;
+        }
+    }
+
+    void Face(const FaceVertex* face, size_t count) {
+        m_Pending = true;
+        m_Shape.name = m_Name;
+        if (count < 3) {
+            m_Warn += "Degenerated face found\n.";
+            return;
+        }
+        if (!m_Triangulate || count == 3) {
+            for (size_t k = 0; k < count; k++)
+                Push(face[k]);
+            m_Shape.mesh.num_face_vertices.push_back(static_cast<unsigned char>(count));
+            m_Shape.mesh.material_ids.push_back(m_Material);
+            m_Shape.mesh.smoothing_group_ids.push_back(m_Smoothing);
+            return;
+        }
+        if (count == 4)
+            Quad(face);
+        else
+            Polygon(face, count);
+    }
+
+    void Finish() {
+        if (m_Pending || !m_Shape.mesh.indices.empty())
+            m_Shapes.push_back(m_Shape);
+    }
+
+private:
+    std::vector<tinyobj::shape_t>& m_Shapes;
+    std::vector<tinyobj::material_t>& m_Materials;
+    std::vector<std::string>& m_MaterialPaths;
+    const std::vector<real_t>& m_V;
+    std::string m_MtlSearchPath;
+    tinyobj::MaterialFileReader m_MtlReader;
+    std::map<std::string, int> m_MaterialMap;
+    std::set<std::string> m_MaterialFiles;
+    bool m_Triangulate;
+    std::string& m_Warn;
+    std::string& m_Err;
+    tinyobj::shape_t m_Shape;
+    std::string m_Name;
+    int m_Material = -1;
+    unsigned int m_Smoothing = 0;
+    bool m_Pending = false;
+
+    void LoadMaterials(const std::string& arg) {
+        // Same splitting as tinyobj's SplitString(arg, ' ', '\\').
+        std::vector<std::string> filenames;
+        std::string token;
+        bool escaping = false;
+        for (char ch : arg) {
+            if (escaping) {
+                escaping = false;
+            } else if (ch == '\\') {
+                escaping = true;
+                continue;
+            } else if (ch == ' ') {
+                if (!token.empty()) filenames.push_back(token);
+                token.clear();
+                continue;
+            }
+            token += ch;
+        }
+        filenames.push_back(token);
+
+        bool found = false;
+        for (const std::string& filename : filenames) {
+            if (m_MaterialFiles.count(filename)) {
+                found = true;
+                continue;
+            }
+            AddMaterialPaths(filename);
+            std::string warnMtl, errMtl;
+            bool ok = m_MtlReader(filename, &m_Materials, &m_MaterialMap, &warnMtl, &errMtl);
+            m_Warn += warnMtl;
+            m_Err += errMtl;
+            if (ok) {
+                found = true;
+                m_MaterialFiles.insert(filename);
+                break;
+            }
+        }
+        if (!found)
+            m_Warn += "Failed to load material file(s). Use default material.\n";
+    }
+
+    // Records the paths tinyobj::MaterialFileReader tries for `filename`:
+    // each directory of the search path, or the name itself without one.
+    void AddMaterialPaths(const std::string& filename) {
+        if (m_MtlSearchPath.empty()) {
+            m_MaterialPaths.push_back(filename);
+            return;
+        }
+#ifdef _WIN32
+        const char separator = ';';
+#else
+        const char separator = ':';
+#endif
+        size_t start = 0;
+        while (start < m_MtlSearchPath.size()) {
+            size_t end = m_MtlSearchPath.find(separator, start);
+            if (end == std::string::npos)
+                end = m_MtlSearchPath.size();
+            // Same joining as tinyobj's JoinPath()
+            std::string directory = m_MtlSearchPath.substr(start, end - start);
+            if (directory.empty())
+                m_MaterialPaths.push_back(filename);
+            else
+                m_MaterialPaths.push_back(directory.back() == '/' ? directory + filename : directory + "/" + filename);
+            start = end + 1;
+        }
+    }
+
+    void Push(const FaceVertex& fv) {
+        tinyobj::index_t idx;
+        idx.vertex_index = fv.v;
+        idx.normal_index = fv.vn;
+        idx.texcoord_index = fv.vt;
+        m_Shape.mesh.indices.push_back(idx);
+    }
+
+    void Triangle(const FaceVertex& a, const FaceVertex& b, const FaceVertex& c) {
+        Push(a);
+        Push(b);
+        Push(c);
+        m_Shape.mesh.num_face_vertices.push_back(3);
+        m_Shape.mesh.material_ids.push_back(m_Material);
+        m_Shape.mesh.smoothing_group_ids.push_back(m_Smoothing);
+    }
+
+    bool Valid(int vi) const {
+        return 3 * size_t(vi) + 2 < m_V.size();
+    }
+
+    void Quad(const FaceVertex* f) {
+        if (!Valid(f[0].v) || !Valid(f[1].v) || !Valid(f[2].v) || !Valid(f[3].v)) {
+            m_Warn += "Face with invalid vertex index found.\n";
+            return;
+        }
+        const real_t* v0 = &m_V[3 * size_t(f[0].v)];
+        const real_t* v1 = &m_V[3 * size_t(f[1].v)];
+        const real_t* v2 = &m_V[3 * size_t(f[2].v)];
+        const real_t* v3 = &m_V[3 * size_t(f[3].v)];
+        // Split along the shortest diagonal.
+        real_t e02x = v2[0] - v0[0], e02y = v2[1] - v0[1], e02z = v2[2] - v0[2];
+        real_t e13x = v3[0] - v1[0], e13y = v3[1] - v1[1], e13z = v3[2] - v1[2];
+        real_t sqr02 = e02x * e02x + e02y * e02y + e02z * e02z;
+        real_t sqr13 = e13x * e13x + e13y * e13y + e13z * e13z;
+        if (sqr02 < sqr13) {
+            Triangle(f[0], f[1], f[2]);
+            Triangle(f[0], f[2], f[3]);
+        } else {
+            Triangle(f[0], f[1], f[3]);
+            Triangle(f[1], f[2], f[3]);
+        }
+    }
+
+    // tinyobj's built-in ear clipping, kept step for step so n-gons produce
+    // the same triangles.
+    void Polygon(const FaceVertex* face, size_t npolys) {
+        size_t axes[2] = { 1, 2 };
+        for (size_t k = 0; k < npolys; ++k) {
+            int i0 = face[(k + 0) % npolys].v;
+            int i1 = face[(k + 1) % npolys].v;
+            int i2 = face[(k + 2) % npolys].v;
+            if (!Valid(i0) || !Valid(i1) || !Valid(i2))
+                continue;
+            const real_t* v0 = &m_V[3 * size_t(i0)];
+            const real_t* v1 = &m_V[3 * size_t(i1)];
+            const real_t* v2 = &m_V[3 * size_t(i2)];
+            real_t e0x = v1[0] - v0[0], e0y = v1[1] - v0[1], e0z = v1[2] - v0[2];
+            real_t e1x = v2[0] - v1[0], e1y = v2[1] - v1[1], e1z = v2[2] - v1[2];
+            real_t cx = std::fabs(e0y * e1z - e0z * e1y);
+            real_t cy = std::fabs(e0z * e1x - e0x * e1z);
+            real_t cz = std::fabs(e0x * e1y - e0y * e1x);
+            const real_t epsilon = std::numeric_limits<real_t>::epsilon();
+            if (cx > epsilon || cy > epsilon || cz > epsilon) {
+                if (!(cx > cy && cx > cz)) {
+                    axes[0] = 0;
+                    if (cz > cx && cz > cy)
+                        axes[1] = 1;
+                }
+                break;
+            }
+        }
+
+        std::vector<FaceVertex> remaining(face, face + npolys);
+        size_t guess = 0;
+        FaceVertex ind[3];
+        real_t vx[3];
+        real_t vy[3];
+        size_t remainingIterations = npolys;
+        size_t previousRemaining = remaining.size();
+
+        while (remaining.size() > 3 && remainingIterations > 0) {
+            npolys = remaining.size();
+            if (guess >= npolys)
+                guess -= npolys;
+            if (previousRemaining != npolys) {
+                previousRemaining = npolys;
+                remainingIterations = npolys;
+            } else {
+                remainingIterations--;
+            }
+
+            for (size_t k = 0; k < 3; k++) {
+                ind[k] = remaining[(guess + k) % npolys];
+                size_t vi = size_t(ind[k].v);
+                if (vi * 3 + axes[0] >= m_V.size() || vi * 3 + axes[1] >= m_V.size()) {
+                    vx[k] = 0;
+                    vy[k] = 0;
+                } else {
+                    vx[k] = m_V[vi * 3 + axes[0]];
+                    vy[k] = m_V[vi * 3 + axes[1]];
+                }
+            }
+
+            real_t e0x = vx[1] - vx[0];
+            real_t e0y = vy[1] - vy[0];
+            real_t e1x = vx[2] - vx[1];
+            real_t e1y = vy[2] - vy[1];
+            real_t cross = e0x * e1y - e0y * e1x;
+            real_t area = (vx[0] * vy[1] - vy[0] * vx[1]) * static_cast<real_t>(0.5);
+            if (cross * area < static_cast<real_t>(0.0)) {
+                guess += 1;
+                continue;
+            }
+
+            bool overlap = false;
+            for (size_t other = 3; other < npolys; ++other) {
+                size_t idx = (guess + other) % npolys;
+                size_t ovi = size_t(remaining[idx].v);
+                if (ovi * 3 + axes[0] >= m_V.size() || ovi * 3 + axes[1] >= m_V.size())
+                    continue;
+                real_t tx = m_V[ovi * 3 + axes[0]];
+                real_t ty = m_V[ovi * 3 + axes[1]];
+                if (PointInPolygon(3, vx, vy, tx, ty)) {
+                    overlap = true;
+                    break;
+                }
+            }
+            if (overlap) {
+                guess += 1;
+                continue;
+            }
+
+            Triangle(ind[0], ind[1], ind[2]);
+            remaining.erase(remaining.begin() + long((guess + 1) % npolys));
+        }
+
+        if (remaining.size() == 3)
+            Triangle(remaining[0], remaining[1], remaining[2]);
+    }
+};
+
+// Concatenates the chunks' vertex data, resolves chunk-relative indices with
+// the running (prefix-sum) vertex counts and replays faces and commands in
+// file order, so shapes that span chunk boundaries are merged naturally.
+bool MergeChunks(std::vector<ObjChunk>& chunks, const std::string& mtlSearchPath,
+    const tinyobj::ObjReaderConfig& config, tinyobj::attrib_t& attrib,
+    std::vector<tinyobj::shape_t>& shapes, std::vector<tinyobj::material_t>& materials,
+    std::vector<std::string>& materialPaths, std::string& warn, std::string& err) {
+    size_t vTotal = 0, vnTotal = 0, vtTotal = 0, lineBase = 0;
+    bool allColors = true;
+    for (ObjChunk& chunk : chunks) {
+        const int vBase = int(vTotal / 3), vnBase = int(vnTotal / 3), vtBase = int(vtTotal / 2);
+        // Faces are recorded up to a parse failure, so an invalid relative
+        // index always comes before the chunk's own error.
+        bool invalid = false;
+        for (size_t f = 0, slot = 0; f < chunk.faceSizes.size() && !invalid; f++) {
+            for (unsigned k = 0; k < chunk.faceSizes[f]; k++, slot++) {
+                const unsigned char relative = chunk.relative[slot];
+                if (!relative)
+                    continue;
+                int* fv = &chunk.indices[3 * slot];
+                if (relative & RELATIVE_V) fv[0] += vBase;
+                if (relative & RELATIVE_VT) fv[1] += vtBase;
+                if (relative & RELATIVE_VN) fv[2] += vnBase;
+                if (((relative & RELATIVE_V) && fv[0] < 0) || ((relative & RELATIVE_VT) && fv[1] < 0) ||
+                    ((relative & RELATIVE_VN) && fv[2] < 0)) {
+                    invalid = true;
+                    chunk.failed = true;
+                    chunk.error = { chunk.faceLines[f], FACE_ERROR };
+                }
+            }
+        }
+        for (const ObjMessage& message : chunk.warnings)
+            warn += message.text + std::to_string(lineBase + message.line) + ").\n";
+        if (chunk.failed) {
+            err += chunk.error.text + std::to_string(lineBase + chunk.error.line) + ").\n";
+            return false;
+        }
+        vTotal += chunk.v.size();
+        vnTotal += chunk.vn.size();
+        vtTotal += chunk.vt.size();
+        lineBase += chunk.lines;
+        allColors &= chunk.allColors;
+    }
+
+    attrib = tinyobj::attrib_t();
+    attrib.vertices.reserve(vTotal);
+    attrib.normals.reserve(vnTotal);
+    attrib.texcoords.reserve(vtTotal);
+    if (allColors || config.vertex_color)
+        attrib.colors.reserve(vTotal);
+    for (const ObjChunk& chunk : chunks) {
+        attrib.vertices.insert(attrib.vertices.end(), chunk.v.begin(), chunk.v.end());
+        attrib.normals.insert(attrib.normals.end(), chunk.vn.begin(), chunk.vn.end());
+        attrib.texcoords.insert(attrib.texcoords.end(), chunk.vt.begin(), chunk.vt.end());
+        if (allColors || config.vertex_color)
+            attrib.colors.insert(attrib.colors.end(), chunk.vc.begin(), chunk.vc.end());
+    }
+
+    shapes.clear();
+    materials.clear();
+    materialPaths.clear();
+    ShapeBuilder builder(shapes, materials, materialPaths, attrib.vertices, mtlSearchPath, config.triangulate, warn, err);
+    int greatestV = -1, greatestVn = -1, greatestVt = -1;
+    std::vector<FaceVertex> face;
+    lineBase = 0;
+    for (const ObjChunk& chunk : chunks) {
+        size_t command = 0;
+        size_t slot = 0;
+        for (size_t f = 0; f <= chunk.faceSizes.size(); f++) {
+            while (command < chunk.commands.size() && chunk.commands[command].face == f) {
+                builder.Command(chunk.commands[command], lineBase + chunk.commands[command].line);
+                command++;
+            }
+            if (f == chunk.faceSizes.size())
+                break;
+            face.resize(chunk.faceSizes[f]);
+            for (FaceVertex& fv : face) {
+                fv.v = chunk.indices[slot++];
+                fv.vt = chunk.indices[slot++];
+                fv.vn = chunk.indices[slot++];
+                greatestV = std::max(greatestV, fv.v);
+                greatestVt = std::max(greatestVt, fv.vt);
+                greatestVn = std::max(greatestVn, fv.vn);
+            }
+            builder.Face(face.data(), face.size());
+        }
+        lineBase += chunk.lines;
+    }
+
+    if (greatestV >= int(attrib.vertices.size() / 3))
+        warn += "Vertex indices out of bounds (line " + std::to_string(lineBase) + ".)\n\n";
+    if (greatestVn >= int(attrib.normals.size() / 3))
+        warn += "Vertex normal indices out of bounds (line " + std::to_string(lineBase) + ".)\n\n";
+    if (greatestVt >= int(attrib.texcoords.size() / 2))
+        warn += "Vertex texcoord indices out of bounds (line " + std::to_string(lineBase) + ".)\n\n";
+
+    builder.Finish();
+    return true;
+}
+
+} // namespace
+
+bool FastObjReader::ParseFromFile(const std::string& filename, const tinyobj::ObjReaderConfig& config) {
+    std::string mtlSearchPath = config.mtl_search_path;
+    if (mtlSearchPath.empty()) {
+        size_t pos = filename.find_last_of("/\\");
+        if (pos != std::string::npos)
+            mtlSearchPath = filename.substr(0, pos);
+    }
+
+    MappedFile file;
+    if (!file.Open(filename)) {
+        m_Valid = false;
+        m_Error = "Cannot open file [" + filename + "]\n";
+        return false;
+    }
+    return ParseFromBuffer(file.Data(), file.Size(), mtlSearchPath, config);
+}
+
+bool FastObjReader::ParseFromBuffer(const char* data, size_t size, const std::string& mtlSearchPath,
+    const tinyobj::ObjReaderConfig& config) {
+    auto start = std::chrono::steady_clock::now();
+    m_Warning.clear();
+    m_Error.clear();
+    m_Shapes.clear();
+    m_Materials.clear();
+    m_MaterialPaths.clear();
+    m_Attrib = tinyobj::attrib_t();
+
+    // Split at line boundaries into at most one chunk per thread, each at
+    // least m_MinChunkBytes.
+    unsigned threads = m_ThreadCount ? m_ThreadCount : std::max(1u, std::thread::hardware_concurrency());
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(threads, size / std::max<size_t>(m_MinChunkBytes, 1)));
+    std::vector<const char*> bounds(1, data);
+    for (size_t i = 1; i < chunkCount; i++) {
+        const char* split = std::max(bounds.back(), data + size * i / chunkCount);
+        split = FindNewline(split, data + size);
+        if (split == data + size)
+            break;
+        bounds.push_back(split + 1);
+    }
+    bounds.push_back(data + size);
+
+    std::vector<ObjChunk> chunks(bounds.size() - 1);
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < chunks.size(); i++)
+        workers.emplace_back(ParseChunk, bounds[i], bounds[i + 1], std::ref(chunks[i]));
+    ParseChunk(bounds[0], bounds[1], chunks[0]);
+    for (std::thread& worker : workers)
+        worker.join();
+    m_Valid = MergeChunks(chunks, mtlSearchPath, config, m_Attrib, m_Shapes, m_Materials, m_MaterialPaths, m_Warning, m_Error);
+
+    m_ChunkCount = chunks.size();
+    m_BytesParsed = size;
+    m_ParseSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return m_Valid;
+}
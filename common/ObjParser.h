@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "tiny_obj_loader.h"
+
+// Drop-in replacement for tinyobj::ObjReader.
+// The whole .obj file is memory-mapped and scanned line by line with a
+// vectorized newline search, numbers are parsed in place (no per-line string
+// copies, no istream). The result is the same attrib_t / shape_t / material_t
+// data tinyobj produces, triangulated the same way, so callers only have to
+// swap the reader type.
+//
+// Large files are split at line boundaries and parsed on several threads
+// into per-chunk buffers; relative indices and shape groups are fixed up when
+// the chunks are merged, so the result does not depend on the number of
+// threads.
+//
+// Not supported (skipped with a warning): 'l' and 'p' primitives, 't' tags and
+// 'vw' skin weights.
+class FastObjReader
+{
+private:
+	bool m_Valid = false;
+	tinyobj::attrib_t m_Attrib;
+	std::vector<tinyobj::shape_t> m_Shapes;
+	std::vector<tinyobj::material_t> m_Materials;
+	std::vector<std::string> m_MaterialPaths;
+	std::string m_Warning;
+	std::string m_Error;
+	unsigned m_ThreadCount = 0;
+	size_t m_MinChunkBytes = 1 << 20;
+	size_t m_ChunkCount = 0;
+	size_t m_BytesParsed = 0;
+	double m_ParseSeconds = 0;
+
+public:
+	// Maximum number of parsing threads, 0 = one per hardware thread.
+	inline void SetThreadCount(unsigned threads) { m_ThreadCount = threads; }
+	// Smallest range of the file given to a thread, so small meshes stay on
+	// the calling thread (1 MB by default).
+	inline void SetMinChunkBytes(size_t bytes) { m_MinChunkBytes = bytes; }
+
+	bool ParseFromFile(const std::string& filename,
+		const tinyobj::ObjReaderConfig& config = tinyobj::ObjReaderConfig());
+	// `data` does not need to be null-terminated. mtllib files are searched in
+	// `mtlSearchPath` (same rules as tinyobj::MaterialFileReader).
+	bool ParseFromBuffer(const char* data, size_t size, const std::string& mtlSearchPath,
+		const tinyobj::ObjReaderConfig& config = tinyobj::ObjReaderConfig());
+
+	inline bool Valid() const { return m_Valid; }
+	inline const tinyobj::attrib_t& GetAttrib() const { return m_Attrib; }
+	inline const std::vector<tinyobj::shape_t>& GetShapes() const { return m_Shapes; }
+	inline const std::vector<tinyobj::material_t>& GetMaterials() const { return m_Materials; }
+	// Every .mtl path the last parse looked for, found or not, for callers
+	// keeping track of the files the result depends on.
+	inline const std::vector<std::string>& GetMaterialPaths() const { return m_MaterialPaths; }
+	inline const std::string& Warning() const { return m_Warning; }
+	inline const std::string& Error() const { return m_Error; }
+
+	// Size of the last parsed .obj, the number of chunks it was split into and
+	// the time spent parsing it, for throughput reporting.
+	inline size_t BytesParsed() const { return m_BytesParsed; }
+	inline size_t ChunkCount() const { return m_ChunkCount; }
+	inline double ParseSeconds() const { return m_ParseSeconds; }
+	inline double ThroughputMBps() const {
+		return m_ParseSeconds > 0 ? double(m_BytesParsed) / (1024.0 * 1024.0) / m_ParseSeconds : 0;
+	}
+};
@@ -0,0 +1,348 @@
+#include "OcclusionBuffer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include "JobSystem.h"
+
+#if defined(__AVX2__)
+#define OCCLUSION_AVX2 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Clip space w below which a vertex is treated as behind the camera.
+const float NEAR_W = 1e-5f;
+// Subpixel precision of the snapped vertices: the edge functions are exact,
+// so no pixel falls between two triangles sharing an edge.
+const int64_t SUBPIXELS = 4;
+const int64_t HALF_PIXEL = SUBPIXELS / 2;
+// Occluders reaching further than this (in pixels) are skipped, which keeps
+// the edge functions inside a tile in 32 bits.
+const float GUARD_BAND = 65536.f;
+const int TILE_WIDTH = 32;
+const int TILE_HEIGHT = 8;
+const size_t TILE_PIXELS = size_t(TILE_WIDTH) * size_t(TILE_HEIGHT);
+// Fewer triangles per job than this are not worth another job.
+const size_t MIN_TRIANGLES_PER_THREAD = 4096;
+
+// Pixel spans: LANES pixels of a tile row tested at once. A pixel is inside
+// when its three edge functions are >= 0, so the sign bit of their OR is
+// set exactly for the pixels outside.
+#if defined(OCCLUSION_AVX2)
+const int LANES = 8;
+typedef __m256i Ints;
+typedef __m256 Floats;
+inline Ints LoadInts(const int32_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+inline Ints SetInts(int32_t value) { return _mm256_set1_epi32(value); }
+inline Ints AddInts(Ints a, Ints b) { return _mm256_add_epi32(a, b); }
+inline Ints OrInts(Ints a, Ints b) { return _mm256_or_si256(a, b); }
+inline Floats LoadFloats(const float* p) { return _mm256_loadu_ps(p); }
+inline Floats SetFloats(float value) { return _mm256_set1_ps(value); }
+inline Floats AddFloats(Floats a, Floats b) { return _mm256_add_ps(a, b); }
+inline void StoreFloats(float* p, Floats value) { _mm256_storeu_ps(p, value); }
+inline Floats DepthTest(Floats depth, Floats z, Ints edges) {
+	return _mm256_blendv_ps(_mm256_min_ps(depth, z), depth, _mm256_castsi256_ps(edges));
+}
+#elif defined(OCCLUSION_SSE2)
+const int LANES = 4;
+typedef __m128i Ints;
+typedef __m128 Floats;
+inline Ints LoadInts(const int32_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+inline Ints SetInts(int32_t value) { return _mm_set1_epi32(value); }
+inline Ints AddInts(Ints a, Ints b) { return _mm_add_epi32(a, b); }
+inline Ints OrInts(Ints a, Ints b) { return _mm_or_si128(a, b); }
+inline Floats LoadFloats(const float* p) { return _mm_loadu_ps(p); }
+inline Floats SetFloats(float value) { return _mm_set1_ps(value); }
+inline Floats AddFloats(Floats a, Floats b) { return _mm_add_ps(a, b); }
+inline void StoreFloats(float* p, Floats value) { _mm_storeu_ps(p, value); }
+inline Floats DepthTest(Floats depth, Floats z, Ints edges) {
+	__m128 outside = _mm_castsi128_ps(_mm_srai_epi32(edges, 31));
+	return _mm_or_ps(_mm_and_ps(outside, depth), _mm_andnot_ps(outside, _mm_min_ps(depth, z)));
+}
+#else
+const int LANES = 1;
+typedef int32_t Ints;
+typedef float Floats;
+inline Ints LoadInts(const int32_t* p) { return *p; }
+inline Ints SetInts(int32_t value) { return value; }
+inline Ints AddInts(Ints a, Ints b) { return a + b; }
+inline Ints OrInts(Ints a, Ints b) { return a | b; }
+inline Floats LoadFloats(const float* p) { return *p; }
+inline Floats SetFloats(float value) { return value; }
+inline Floats AddFloats(Floats a, Floats b) { return a + b; }
+inline void StoreFloats(float* p, Floats value) { *p = value; }
+inline Floats DepthTest(Floats depth, Floats z, Ints edges) { return edges < 0 ? depth : std::min(depth, z); }
+#endif
+
+inline int64_t FloorDiv(int64_t a, int64_t b) {
+	return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+} // namespace
+
+void OcclusionBuffer::Resize(int width, int height) {
+	m_Width = std::max(width, 1);
+	m_Height = std::max(height, 1);
+	m_TilesX = (m_Width + TILE_WIDTH - 1) / TILE_WIDTH;
+	m_TilesY = (m_Height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+	m_Tiles.assign(size_t(m_TilesX) * size_t(m_TilesY) * TILE_PIXELS, 1.f);
+	m_Bins.assign(size_t(m_TilesX) * size_t(m_TilesY), std::vector<uint32_t>());
+	m_Triangles.clear();
+	m_Levels.clear();
+	m_LevelSizes.clear();
+	int w = m_Width, h = m_Height;
+	while (true) {
+		m_LevelSizes.push_back(glm::ivec2(w, h));
+		m_Levels.push_back(std::vector<float>(size_t(w) * size_t(h), 1.f));
+		if (w == 1 && h == 1)
+			break;
+		w = (w + 1) / 2;
+		h = (h + 1) / 2;
+	}
+}
+
+void OcclusionBuffer::Clear() {
+	std::fill(m_Tiles.begin(), m_Tiles.end(), 1.f);
+	for (std::vector<uint32_t>& bin : m_Bins)
+		bin.clear();
+	for (std::vector<float>& level : m_Levels)
+		std::fill(level.begin(), level.end(), 1.f);
+	m_Triangles.clear();
+	m_Seconds = 0;
+}
+
+void OcclusionBuffer::AddOccluder(const glm::vec3* positions, size_t positionStride, const uint32_t* indices,
+	size_t indexCount, const glm::mat4& transformWithProjection) {
+	if (m_Bins.empty())
+		return;
+	auto start = std::chrono::steady_clock::now();
+	const float halfWidth = 0.5f * float(m_Width), halfHeight = 0.5f * float(m_Height);
+	const glm::mat4 matrix = transformWithProjection;
+
+	for (size_t i = 0; i + 2 < indexCount; i += 3) {
+		int64_t x[3], y[3];
+		float z[3];
+		bool clipped = false;
+		for (int k = 0; k < 3; k++) {
+			const glm::vec3& position = *reinterpret_cast<const glm::vec3*>(
+				reinterpret_cast<const char*>(positions) + size_t(indices[i + k]) * positionStride);
+			glm::vec4 clip = matrix[0] * position.x + matrix[1] * position.y + matrix[2] * position.z + matrix[3];
+			if (clip.w < NEAR_W || clip.z < -clip.w) {
+				clipped = true;
+				break;
+			}
+			float invW = 1 / clip.w;
+			float screenX = (clip.x * invW + 1) * halfWidth, screenY = (clip.y * invW + 1) * halfHeight;
+			if (std::abs(screenX) > GUARD_BAND || std::abs(screenY) > GUARD_BAND) {
+				clipped = true;
+				break;
+			}
+			x[k] = int64_t(std::floor(screenX * float(SUBPIXELS) + 0.5f));
+			y[k] = int64_t(std::floor(screenY * float(SUBPIXELS) + 0.5f));
+			z[k] = clip.z * invW;
+		}
+		if (clipped)
+			continue;
+
+		int64_t area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+		if (area <= 0)
+			continue;
+
+		// Pixel centers inside the bounding box.
+		Triangle triangle;
+		triangle.pixelMin[0] = int(std::max<int64_t>(FloorDiv(std::min(x[0], std::min(x[1], x[2])) - HALF_PIXEL + SUBPIXELS - 1, SUBPIXELS), 0));
+		triangle.pixelMax[0] = int(std::min<int64_t>(FloorDiv(std::max(x[0], std::max(x[1], x[2])) - HALF_PIXEL, SUBPIXELS), m_Width - 1));
+		triangle.pixelMin[1] = int(std::max<int64_t>(FloorDiv(std::min(y[0], std::min(y[1], y[2])) - HALF_PIXEL + SUBPIXELS - 1, SUBPIXELS), 0));
+		triangle.pixelMax[1] = int(std::min<int64_t>(FloorDiv(std::max(y[0], std::max(y[1], y[2])) - HALF_PIXEL, SUBPIXELS), m_Height - 1));
+		if (triangle.pixelMin[0] > triangle.pixelMax[0] || triangle.pixelMin[1] > triangle.pixelMax[1])
+			continue;
+
+		// Edge k is opposite to vertex k, its function is the barycentric
+		// weight of that vertex times the area.
+		double zA = 0, zB = 0, zC = 0;
+		for (int k = 0; k < 3; k++) {
+			int a = (k + 1) % 3, b = (k + 2) % 3;
+			triangle.edgeA[k] = int32_t(y[a] - y[b]);
+			triangle.edgeB[k] = int32_t(x[b] - x[a]);
+			triangle.edgeC[k] = -(int64_t(triangle.edgeA[k]) * x[a] + int64_t(triangle.edgeB[k]) * y[a]);
+			zA += double(triangle.edgeA[k]) * z[k];
+			zB += double(triangle.edgeB[k]) * z[k];
+			zC += double(triangle.edgeC[k]) * z[k];
+		}
+		triangle.zStepX = zA * double(SUBPIXELS) / double(area);
+		triangle.zStepY = zB * double(SUBPIXELS) / double(area);
+		triangle.z = (zA * double(HALF_PIXEL) + zB * double(HALF_PIXEL) + zC) / double(area);
+
+		uint32_t index = uint32_t(m_Triangles.size());
+		m_Triangles.push_back(triangle);
+		for (int ty = triangle.pixelMin[1] / TILE_HEIGHT; ty <= triangle.pixelMax[1] / TILE_HEIGHT; ty++)
+			for (int tx = triangle.pixelMin[0] / TILE_WIDTH; tx <= triangle.pixelMax[0] / TILE_WIDTH; tx++)
+				m_Bins[size_t(ty) * size_t(m_TilesX) + size_t(tx)].push_back(index);
+	}
+	m_Seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void OcclusionBuffer::RasterizeTile(size_t tile) {
+	float* depth = &m_Tiles[tile * TILE_PIXELS];
+	const int tileX = int(tile % size_t(m_TilesX)) * TILE_WIDTH, tileY = int(tile / size_t(m_TilesX)) * TILE_HEIGHT;
+
+	for (uint32_t index : m_Bins[tile]) {
+		const Triangle& triangle = m_Triangles[index];
+		int rowBegin = std::max(triangle.pixelMin[1] - tileY, 0);
+		int rowEnd = std::min(triangle.pixelMax[1] - tileY, TILE_HEIGHT - 1);
+		int columnBegin = std::max(triangle.pixelMin[0] - tileX, 0) / LANES * LANES;
+		int columnEnd = std::min(triangle.pixelMax[0] - tileX, TILE_WIDTH - 1);
+
+		// Edge functions at the first pixel drawn. An edge with the whole
+		// tile inside is dropped, one with the whole tile outside rejects
+		// the triangle; the others stay well within 32 bits over the tile.
+		int32_t edges[3], stepX[3], stepY[3];
+		bool outside = false;
+		for (int k = 0; k < 3; k++) {
+			int64_t dx = int64_t(triangle.edgeA[k]) * SUBPIXELS, dy = int64_t(triangle.edgeB[k]) * SUBPIXELS;
+			int64_t value = int64_t(triangle.edgeA[k]) * (int64_t(tileX) * SUBPIXELS + HALF_PIXEL) +
+				int64_t(triangle.edgeB[k]) * (int64_t(tileY) * SUBPIXELS + HALF_PIXEL) + triangle.edgeC[k];
+			int64_t minValue = value + std::min<int64_t>(dx * (TILE_WIDTH - 1), 0) + std::min<int64_t>(dy * (TILE_HEIGHT - 1), 0);
+			int64_t maxValue = value + std::max<int64_t>(dx * (TILE_WIDTH - 1), 0) + std::max<int64_t>(dy * (TILE_HEIGHT - 1), 0);
+			if (maxValue < 0) {
+				outside = true;
+				break;
+			}
+			if (minValue >= 0) {
+				edges[k] = stepX[k] = stepY[k] = 0;
+			} else {
+				edges[k] = int32_t(value + dx * columnBegin + dy * rowBegin);
+				stepX[k] = int32_t(dx);
+				stepY[k] = int32_t(dy);
+			}
+		}
+		if (outside)
+			continue;
+
+		int32_t laneEdges[3][LANES];
+		float laneZ[LANES];
+		for (int lane = 0; lane < LANES; lane++) {
+			for (int k = 0; k < 3; k++)
+				laneEdges[k][lane] = stepX[k] * lane;
+			laneZ[lane] = float(triangle.zStepX * lane);
+		}
+		const Ints laneOffsets[3] = { LoadInts(laneEdges[0]), LoadInts(laneEdges[1]), LoadInts(laneEdges[2]) };
+		const Ints spanSteps[3] = { SetInts(stepX[0] * LANES), SetInts(stepX[1] * LANES), SetInts(stepX[2] * LANES) };
+		const Floats laneZOffsets = LoadFloats(laneZ);
+		const Floats spanZStep = SetFloats(float(triangle.zStepX * LANES));
+		double rowZ = triangle.z + triangle.zStepX * (tileX + columnBegin) + triangle.zStepY * (tileY + rowBegin);
+
+		for (int row = rowBegin; row <= rowEnd; row++) {
+			Ints e0 = AddInts(SetInts(edges[0]), laneOffsets[0]);
+			Ints e1 = AddInts(SetInts(edges[1]), laneOffsets[1]);
+			Ints e2 = AddInts(SetInts(edges[2]), laneOffsets[2]);
+			Floats z = AddFloats(SetFloats(float(rowZ)), laneZOffsets);
+			float* span = depth + size_t(row) * TILE_WIDTH;
+			for (int column = columnBegin; column <= columnEnd; column += LANES) {
+				StoreFloats(span + column, DepthTest(LoadFloats(span + column), z, OrInts(OrInts(e0, e1), e2)));
+				e0 = AddInts(e0, spanSteps[0]);
+				e1 = AddInts(e1, spanSteps[1]);
+				e2 = AddInts(e2, spanSteps[2]);
+				z = AddFloats(z, spanZStep);
+			}
+			for (int k = 0; k < 3; k++)
+				edges[k] += stepY[k];
+			rowZ += triangle.zStepY;
+		}
+	}
+}
+
+void OcclusionBuffer::BuildPyramid() {
+	if (m_Levels.empty())
+		return;
+	auto start = std::chrono::steady_clock::now();
+
+	// Tiles are independent, each job takes the next one until none is left.
+	const size_t tileCount = m_Bins.size();
+	std::atomic<size_t> nextTile(0);
+	unsigned threads = m_Jobs ? m_Jobs->GetThreadCount() : 1;
+	if (m_ThreadCount)
+		threads = std::min(threads, m_ThreadCount);
+	size_t jobCount = std::max<size_t>(1, std::min<size_t>(threads, m_Triangles.size() / MIN_TRIANGLES_PER_THREAD));
+	auto rasterize = [this, tileCount, &nextTile](size_t, size_t) {
+		for (size_t tile = nextTile++; tile < tileCount; tile = nextTile++)
+			this->RasterizeTile(tile);
+	};
+	if (m_Jobs)
+		m_Jobs->ParallelFor(jobCount, 1, rasterize);
+	else
+		rasterize(0, 1);
+
+	// Resolve the tiles into the row-major level 0.
+	std::vector<float>& resolved = m_Levels[0];
+	for (int y = 0; y < m_Height; y++) {
+		const float* tileRow = &m_Tiles[size_t(y / TILE_HEIGHT) * size_t(m_TilesX) * TILE_PIXELS + size_t(y % TILE_HEIGHT) * TILE_WIDTH];
+		float* row = &resolved[size_t(y) * size_t(m_Width)];
+		for (int x = 0; x < m_Width; x += TILE_WIDTH) {
+			const float* span = tileRow + size_t(x / TILE_WIDTH) * TILE_PIXELS;
+			std::copy(span, span + std::min(TILE_WIDTH, m_Width - x), row + x);
+		}
+	}
+
+	for (size_t level = 1; level < m_Levels.size(); level++) {
+		const std::vector<float>& source = m_Levels[level - 1];
+		std::vector<float>& destination = m_Levels[level];
+		glm::ivec2 sourceSize = m_LevelSizes[level - 1], size = m_LevelSizes[level];
+		for (int y = 0; y < size.y; y++) {
+			int sy0 = 2 * y, sy1 = std::min(2 * y + 1, sourceSize.y - 1);
+			for (int x = 0; x < size.x; x++) {
+				int sx0 = 2 * x, sx1 = std::min(2 * x + 1, sourceSize.x - 1);
+				destination[size_t(y) * size_t(size.x) + size_t(x)] = std::max(
+					std::max(source[size_t(sy0) * size_t(sourceSize.x) + size_t(sx0)], source[size_t(sy0) * size_t(sourceSize.x) + size_t(sx1)]),
+					std::max(source[size_t(sy1) * size_t(sourceSize.x) + size_t(sx0)], source[size_t(sy1) * size_t(sourceSize.x) + size_t(sx1)]));
+			}
+		}
+	}
+	m_Seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool OcclusionBuffer::IsVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+	const glm::mat4& transformWithProjection) const {
+	if (m_Levels.empty())
+		return true;
+
+	// Screen rectangle and nearest depth of the box.
+	glm::vec2 rectMin(1e30f), rectMax(-1e30f);
+	float nearest = 1;
+	for (int corner = 0; corner < 8; corner++) {
+		glm::vec3 p((corner & 1) ? boundsMax.x : boundsMin.x, (corner & 2) ? boundsMax.y : boundsMin.y,
+			(corner & 4) ? boundsMax.z : boundsMin.z);
+		glm::vec4 clip = transformWithProjection * glm::vec4(p, 1);
+		if (clip.w < NEAR_W || clip.z < -clip.w)
+			return true;
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		rectMin = glm::min(rectMin, glm::vec2(ndc));
+		rectMax = glm::max(rectMax, glm::vec2(ndc));
+		nearest = std::min(nearest, ndc.z);
+	}
+	if (rectMax.x < -1 || rectMax.y < -1 || rectMin.x > 1 || rectMin.y > 1)
+		return false;
+
+	int x0 = std::max(int((rectMin.x + 1) * 0.5f * float(m_Width)), 0);
+	int x1 = std::min(int((rectMax.x + 1) * 0.5f * float(m_Width)), m_Width - 1);
+	int y0 = std::max(int((rectMin.y + 1) * 0.5f * float(m_Height)), 0);
+	int y1 = std::min(int((rectMax.y + 1) * 0.5f * float(m_Height)), m_Height - 1);
+
+	// Coarsest useful level: the rectangle covers at most 4x4 texels.
+	size_t level = 0;
+	while (level + 1 < m_Levels.size() && ((x1 >> level) - (x0 >> level) >= 4 || (y1 >> level) - (y0 >> level) >= 4))
+		level++;
+	const std::vector<float>& depth = m_Levels[level];
+	int width = m_LevelSizes[level].x;
+	for (int y = y0 >> level; y <= (y1 >> level); y++)
+		for (int x = x0 >> level; x <= (x1 >> level); x++)
+			if (depth[size_t(y) * size_t(width) + size_t(x)] >= nearest)
+				return true;
+	return false;
+}
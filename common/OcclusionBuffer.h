@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+class JobSystem;
+
+// Low resolution software depth buffer for CPU occlusion culling.
+// Occluder triangles are set up and binned into screen tiles as they are
+// added, then every tile is rasterized (depth only, nearest wins) with SIMD,
+// 8 pixels per step with AVX2 or 2x4 with SSE2, the tiles spread across
+// the jobs of a JobSystem. A hierarchical Z pyramid is built on top where each texel keeps
+// the farthest depth of the 2x2 texels below it. A box is occluded when its
+// nearest depth is behind every pyramid texel it covers, on a level where it
+// covers at most 4x4 texels.
+//
+// Depths are NDC z (-1 near, +1 far). Occluders crossing the near plane or
+// reaching far outside the screen are skipped, which is always safe; boxes
+// crossing the near plane are always visible.
+class OcclusionBuffer
+{
+private:
+	// Occluder triangle after setup: fixed point edge functions
+	// (A * x + B * y + C >= 0 inside, in subpixels) and depth plane.
+	struct Triangle
+	{
+		int32_t edgeA[3];
+		int32_t edgeB[3];
+		int64_t edgeC[3];
+		// Depth at the center of pixel (0, 0) and its step per pixel.
+		double z;
+		double zStepX;
+		double zStepY;
+		int pixelMin[2];
+		int pixelMax[2];
+	};
+
+	int m_Width = 0;
+	int m_Height = 0;
+	int m_TilesX = 0;
+	int m_TilesY = 0;
+	JobSystem* m_Jobs = nullptr;
+	unsigned m_ThreadCount = 0;
+	// Tiled depth, one contiguous block per tile.
+	std::vector<float> m_Tiles;
+	std::vector<Triangle> m_Triangles;
+	// Triangles touching each tile.
+	std::vector<std::vector<uint32_t>> m_Bins;
+	// Pyramid, level 0 is the resolved full resolution depth.
+	std::vector<std::vector<float>> m_Levels;
+	std::vector<glm::ivec2> m_LevelSizes;
+	double m_Seconds = 0;
+
+	void RasterizeTile(size_t tile);
+
+public:
+	void Resize(int width, int height);
+	// Rasterizes with the jobs of `jobs`, on the calling thread alone without.
+	inline void SetJobSystem(JobSystem* jobs) { m_Jobs = jobs; }
+	// Maximum number of rasterization jobs at once, 0 = one per thread of the
+	// job system.
+	inline void SetThreadCount(unsigned threads) { m_ThreadCount = threads; }
+	// Clears the depth to the far plane and drops the binned occluders.
+	void Clear();
+
+	// `transformWithProjection` maps the object space positions to clip
+	// space; positions are read every `positionStride` bytes, so they can be
+	// taken straight from a vertex array. Only triangles facing the camera
+	// (counter-clockwise) are kept. They are drawn by BuildPyramid().
+	void AddOccluder(const glm::vec3* positions, size_t positionStride, const uint32_t* indices,
+		size_t indexCount, const glm::mat4& transformWithProjection);
+	// Rasterizes the occluders and builds the pyramid; call before the queries.
+	void BuildPyramid();
+
+	// True if some part of the object space box may be visible.
+	bool IsVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& transformWithProjection) const;
+
+	inline int GetWidth() const { return m_Width; }
+	inline int GetHeight() const { return m_Height; }
+	// Row-major depth, valid after BuildPyramid().
+	inline const float* GetDepth() const { return m_Levels.empty() ? nullptr : m_Levels[0].data(); }
+	// Triangles that passed clipping and backface culling since Clear().
+	inline size_t GetTrianglesRasterized() const { return m_Triangles.size(); }
+	// Time spent in AddOccluder() and BuildPyramid() since Clear().
+	inline double GetRasterizeSeconds() const { return m_Seconds; }
+};
@@ -0,0 +1,312 @@
+#include "PathTracer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include "CpuTexture.h"
+#include "JobSystem.h"
+#include "ImageFile.h"
+
+namespace {
+
+const int TILE_SIZE = 16;
+const float PI = 3.14159265358979f;
+// Bounces after which paths may be terminated (Russian roulette).
+const int MIN_BOUNCES = 3;
+
+// Hash of the pixel and pass, the seed of a path (Wang hash).
+inline uint32_t Hash(uint32_t x) {
+	x = (x ^ 61u) ^ (x >> 16);
+	x *= 9u;
+	x ^= x >> 4;
+	x *= 0x27d4eb2du;
+	x ^= x >> 15;
+	return x;
+}
+
+// Uniform in [0, 1) (xorshift32).
+inline float Random(uint32_t& state) {
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return float(state >> 8) * (1.f / 16777216.f);
+}
+
+inline float Luminance(const glm::vec3& c) {
+	return 0.2126f * c.r + 0.7152f * c.g + 0.0722f * c.b;
+}
+
+// Direction at acos(cosTheta) from the unit normal `n`, turned by `phi` around it.
+inline glm::vec3 AroundNormal(const glm::vec3& n, float cosTheta, float phi) {
+	glm::vec3 tangent = std::fabs(n.x) > 0.5f ? glm::vec3(n.y, -n.x, 0) : glm::vec3(0, n.z, -n.y);
+	tangent = glm::normalize(tangent);
+	glm::vec3 bitangent = glm::cross(n, tangent);
+	float sinTheta = std::sqrt(std::max(0.f, 1 - cosTheta * cosTheta));
+	return tangent * (std::cos(phi) * sinTheta) + bitangent * (std::sin(phi) * sinTheta) + n * cosTheta;
+}
+
+// Surface point being shaded, all in world space.
+struct Surface {
+	glm::vec3 position;
+	glm::vec3 normal;         // shading normal, facing the incoming ray
+	glm::vec3 geometryNormal; // same side as `normal`
+	glm::vec3 albedo;
+	glm::vec3 specular;
+	float shininess;
+};
+
+// Lambert plus normalized Blinn-Phong.
+glm::vec3 Evaluate(const Surface& s, const glm::vec3& toEye, const glm::vec3& toLight) {
+	float cosLight = glm::dot(s.normal, toLight);
+	if (cosLight <= 0)
+		return glm::vec3(0);
+	glm::vec3 result = s.albedo * (1 / PI);
+	glm::vec3 h = glm::normalize(toEye + toLight);
+	float cosHalf = std::max(0.f, glm::dot(s.normal, h));
+	result += s.specular * ((s.shininess + 8) / (8 * PI) * std::pow(cosHalf, s.shininess));
+	return result;
+}
+
+// Density of the next directions drawn in PathTracer::Trace().
+float Pdf(const Surface& s, float diffuseProbability, const glm::vec3& toEye, const glm::vec3& toLight) {
+	float cosLight = glm::dot(s.normal, toLight);
+	if (cosLight <= 0)
+		return 0;
+	glm::vec3 h = glm::normalize(toEye + toLight);
+	float cosHalf = std::max(0.f, glm::dot(s.normal, h));
+	float halfPdf = (s.shininess + 1) / (2 * PI) * std::pow(cosHalf, s.shininess);
+	float specularPdf = halfPdf / (4 * std::max(1e-6f, glm::dot(toEye, h)));
+	return diffuseProbability * cosLight / PI + (1 - diffuseProbability) * specularPdf;
+}
+
+} // namespace
+
+void PathTracer::SetScene(const std::vector<PathTracerObject>& objects) {
+	m_Objects = objects;
+	m_Instances.clear();
+	m_NormalTransforms.clear();
+	for (const PathTracerObject& object : m_Objects) {
+		TlasInstance instance;
+		instance.blas = object.blas;
+		instance.transform = object.transform;
+		m_Instances.push_back(instance);
+		m_NormalTransforms.push_back(glm::transpose(glm::inverse(glm::mat3(object.transform))));
+	}
+	m_Tlas.Build(m_Instances);
+	Reset();
+}
+
+void PathTracer::SetCamera(const PathTracerCamera& camera) {
+	m_Camera = camera;
+	Reset();
+}
+
+void PathTracer::SetSettings(const PathTracerSettings& settings) {
+	m_Settings = settings;
+	Reset();
+}
+
+void PathTracer::Resize(int width, int height) {
+	m_Width = std::max(width, 1);
+	m_Height = std::max(height, 1);
+	m_TilesX = (m_Width + TILE_SIZE - 1) / TILE_SIZE;
+	m_TilesY = (m_Height + TILE_SIZE - 1) / TILE_SIZE;
+	m_Accumulation.assign(size_t(m_Width) * size_t(m_Height), glm::vec3(0));
+	Reset();
+}
+
+void PathTracer::Reset() {
+	std::fill(m_Accumulation.begin(), m_Accumulation.end(), glm::vec3(0));
+	m_Passes = 0;
+	m_TotalSeconds = 0;
+}
+
+glm::vec3 PathTracer::Trace(glm::vec3 origin, glm::vec3 direction, uint32_t& rng) const {
+	const glm::vec3 toSun = -glm::normalize(m_Settings.lightDirection);
+	glm::vec3 radiance(0), throughput(1);
+	for (int bounce = 0; bounce <= m_Settings.maxBounces; bounce++) {
+		TlasHit hit;
+		if (!m_Tlas.Intersect(origin, direction, hit)) {
+			radiance += throughput * (bounce == 0 ? m_Settings.backgroundColor : m_Settings.skyColor);
+			break;
+		}
+
+		// Interpolated attributes of the hit triangle.
+		const PathTracerObject& object = m_Objects[hit.instance];
+		const uint32_t* indices = object.indices + size_t(hit.hit.ref.triangle) * 3;
+		const Vertex3& v0 = object.vertices[indices[0]];
+		const Vertex3& v1 = object.vertices[indices[1]];
+		const Vertex3& v2 = object.vertices[indices[2]];
+		float b1 = hit.hit.barycentrics.x, b2 = hit.hit.barycentrics.y, b0 = 1 - b1 - b2;
+		const glm::mat3& normalTransform = m_NormalTransforms[hit.instance];
+		Surface s;
+		s.position = origin + direction * hit.hit.distance;
+		s.geometryNormal = glm::normalize(normalTransform * glm::cross(v1.position - v0.position, v2.position - v0.position));
+		s.normal = v0.normal * b0 + v1.normal * b1 + v2.normal * b2;
+		s.normal = glm::dot(s.normal, s.normal) > 0 ? glm::normalize(normalTransform * s.normal) : s.geometryNormal;
+		// Both sides are shaded.
+		if (glm::dot(s.geometryNormal, direction) > 0)
+			s.geometryNormal = -s.geometryNormal;
+		if (glm::dot(s.normal, s.geometryNormal) < 0)
+			s.normal = -s.normal;
+		const PathTracerMaterial& material = object.material;
+		s.albedo = material.diffuse;
+		if (material.texture) {
+			glm::vec2 texCoords = v0.texCoords * b0 + v1.texCoords * b1 + v2.texCoords * b2;
+			s.albedo *= glm::vec3(material.texture->Sample(glm::vec2(texCoords.x, -texCoords.y)));
+		}
+		s.specular = material.specular;
+		s.shininess = std::max(material.shininess, 0.f);
+		const glm::vec3 toEye = -direction;
+		const glm::vec3 offset = s.geometryNormal * (1e-4f * (1 + std::max(std::fabs(s.position.x), std::max(std::fabs(s.position.y), std::fabs(s.position.z)))));
+
+		// Direct light, unless something is in the way.
+		if (glm::dot(s.geometryNormal, toSun) > 0) {
+			glm::vec3 f = Evaluate(s, toEye, toSun);
+			if (f != glm::vec3(0)) {
+				TlasHit shadow;
+				if (!m_Tlas.Intersect(s.position + offset, toSun, shadow))
+					radiance += throughput * f * m_Settings.lightColor * glm::dot(s.normal, toSun);
+			}
+		}
+
+		// Next direction: diffuse or specular lobe, by their weight.
+		float diffuseWeight = Luminance(s.albedo), specularWeight = Luminance(s.specular);
+		if (diffuseWeight + specularWeight <= 0)
+			break;
+		float diffuseProbability = diffuseWeight / (diffuseWeight + specularWeight);
+		glm::vec3 next;
+		float u1 = Random(rng), u2 = Random(rng), u3 = Random(rng);
+		if (u1 < diffuseProbability) {
+			next = AroundNormal(s.normal, std::sqrt(u2), 2 * PI * u3);
+		} else {
+			glm::vec3 h = AroundNormal(s.normal, std::pow(u2, 1 / (s.shininess + 1)), 2 * PI * u3);
+			next = h * (2 * glm::dot(toEye, h)) - toEye;
+		}
+		if (glm::dot(next, s.geometryNormal) <= 0)
+			break;
+		float pdf = Pdf(s, diffuseProbability, toEye, next);
+		if (pdf <= 0)
+			break;
+		throughput *= Evaluate(s, toEye, next) * (glm::dot(s.normal, next) / pdf);
+
+		if (bounce + 1 >= MIN_BOUNCES) {
+			float survival = std::min(0.95f, std::max(throughput.r, std::max(throughput.g, throughput.b)));
+			if (Random(rng) >= survival)
+				break;
+			throughput /= survival;
+		}
+		origin = s.position + offset;
+		direction = next;
+	}
+	return radiance;
+}
+
+void PathTracer::RenderTile(size_t tile) {
+	int x0 = int(tile % size_t(m_TilesX)) * TILE_SIZE, y0 = int(tile / size_t(m_TilesX)) * TILE_SIZE;
+	int x1 = std::min(x0 + TILE_SIZE, m_Width), y1 = std::min(y0 + TILE_SIZE, m_Height);
+	for (int y = y0; y < y1; y++) {
+		for (int x = x0; x < x1; x++) {
+			uint32_t pixel = uint32_t(y) * uint32_t(m_Width) + uint32_t(x);
+			uint32_t rng = Hash(pixel ^ Hash(m_Passes + 1));
+			if (rng == 0)
+				rng = 1;
+			// Jittered inside the pixel for antialiasing.
+			float px = float(x) + Random(rng), py = float(y) + Random(rng);
+			glm::vec4 ndc(2 * px / float(m_Width) - 1, 1 - 2 * py / float(m_Height), 1, 1);
+			glm::vec4 farPoint = m_Camera.inverseViewProjection * ndc;
+			glm::vec3 direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - m_Camera.position);
+			glm::vec3 sample = Trace(m_Camera.position, direction, rng);
+			// NaNs are dropped and the rare very bright samples of the glossy
+			// lobes clamped, they would take very long to average out.
+			if (!(sample.x >= 0 && sample.y >= 0 && sample.z >= 0))
+				sample = glm::vec3(0);
+			m_Accumulation[pixel] += glm::min(sample, glm::vec3(16));
+		}
+	}
+}
+
+void PathTracer::RenderPass() {
+	if (m_Accumulation.empty())
+		return;
+	auto start = std::chrono::steady_clock::now();
+	const uint32_t tileCount = uint32_t(m_TilesX * m_TilesY);
+	unsigned threads = m_Jobs ? m_Jobs->GetThreadCount() : 1;
+	if (m_Settings.threadCount)
+		threads = std::min(threads, m_Settings.threadCount);
+	threads = std::max(1u, std::min(threads, tileCount));
+
+	// Remaining tiles of each job, packed as first << 32 | end. The owner
+	// takes tiles from the front, thieves take the back half.
+	std::unique_ptr<std::atomic<uint64_t>[]> runs(new std::atomic<uint64_t>[threads]);
+	for (unsigned i = 0; i < threads; i++) {
+		uint64_t first = uint64_t(tileCount) * i / threads, end = uint64_t(tileCount) * (i + 1) / threads;
+		runs[i].store(first << 32 | end);
+	}
+	std::atomic<size_t> steals(0);
+	auto work = [this, threads, &runs, &steals](unsigned self) {
+		while (true) {
+			uint64_t run = runs[self].load();
+			uint32_t first = uint32_t(run >> 32), end = uint32_t(run);
+			if (first < end) {
+				if (runs[self].compare_exchange_weak(run, uint64_t(first + 1) << 32 | end))
+					this->RenderTile(first);
+				continue;
+			}
+			bool stolen = false;
+			for (unsigned k = 1; k < threads && !stolen; k++) {
+				std::atomic<uint64_t>& victim = runs[(self + k) % threads];
+				uint64_t victimRun = victim.load();
+				while (true) {
+					uint32_t victimFirst = uint32_t(victimRun >> 32), victimEnd = uint32_t(victimRun);
+					if (victimFirst >= victimEnd)
+						break;
+					uint32_t middle = victimEnd - (victimEnd - victimFirst + 1) / 2;
+					if (victim.compare_exchange_weak(victimRun, uint64_t(victimFirst) << 32 | middle)) {
+						runs[self].store(uint64_t(middle) << 32 | victimEnd);
+						steals++;
+						stolen = true;
+						break;
+					}
+				}
+			}
+			if (!stolen)
+				return;
+		}
+	};
+	if (m_Jobs) {
+		m_Jobs->ParallelFor(threads, 1, [&work](size_t begin, size_t end) {
+			for (size_t job = begin; job < end; job++)
+				work(unsigned(job));
+		});
+	} else {
+		work(0);
+	}
+
+	m_Passes++;
+	m_PassThreads = threads;
+	m_PassSteals = steals;
+	m_PassSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	m_TotalSeconds += m_PassSeconds;
+}
+
+void PathTracer::Resolve(std::vector<uint8_t>& rgb) const {
+	rgb.resize(m_Accumulation.size() * 3);
+	float scale = m_Passes ? 1.f / float(m_Passes) : 0.f;
+	for (size_t i = 0; i < m_Accumulation.size(); i++) {
+		glm::vec3 color = glm::clamp(m_Accumulation[i] * scale, 0.f, 1.f);
+		for (int c = 0; c < 3; c++) {
+			float linear = color[c];
+			float encoded = linear <= 0.0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1 / 2.4f) - 0.055f;
+			rgb[3 * i + c] = uint8_t(encoded * 255 + 0.5f);
+		}
+	}
+}
+
+bool PathTracer::SavePpm(const char* path) const {
+	std::vector<uint8_t> rgb;
+	Resolve(rgb);
+	return ::SavePpm(path, m_Width, m_Height, rgb);
+}
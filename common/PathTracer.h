@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Bvh.h"
+#include "Mesh.h"
+
+class CpuTexture;
+class JobSystem;
+
+// Material of the GL shaders (tinyobj Ka/Kd/Ks/Ns). Kd times the texture is
+// a Lambert lobe, Ks and Ns a normalized Blinn-Phong lobe; Ka has no
+// physical meaning here, the ambient light comes from the sky instead.
+struct PathTracerMaterial {
+	glm::vec3 ambient = glm::vec3(0);
+	glm::vec3 diffuse = glm::vec3(1);
+	glm::vec3 specular = glm::vec3(0);
+	float shininess = 1;
+	const CpuTexture* texture = nullptr;
+};
+
+// Object drawn by the path tracer: the object space tree over its triangles
+// (BvhTriangleRef::triangle indexes `indices`), its vertices and where it is
+// placed. Everything pointed to must stay alive while rendering.
+struct PathTracerObject {
+	const Bvh* blas = nullptr;
+	const Vertex3* vertices = nullptr;
+	const uint32_t* indices = nullptr;
+	glm::mat4 transform = glm::mat4(1);
+	PathTracerMaterial material;
+};
+
+// Pinhole camera given like the GL one, so both render the same frame.
+struct PathTracerCamera {
+	glm::vec3 position = glm::vec3(0);
+	// Inverse of projection * view.
+	glm::mat4 inverseViewProjection = glm::mat4(1);
+};
+
+// Lighting of the GL renderer: one directional light, its ambient color
+// becomes the radiance of the sky reached by the bounces.
+struct PathTracerSettings {
+	glm::vec3 lightDirection = glm::vec3(1, -1, -1);
+	glm::vec3 lightColor = glm::vec3(1);
+	glm::vec3 skyColor = glm::vec3(0.1f);
+	// Seen by the camera rays that miss, the GL clear color.
+	glm::vec3 backgroundColor = glm::vec3(0);
+	int maxBounces = 6;
+	// Maximum number of jobs, 0 = one per thread of the job system.
+	unsigned threadCount = 0;
+};
+
+// Multithreaded progressive path tracer, a reference for the GL renderer.
+// Each RenderPass() adds one sample per pixel to the accumulated image; the
+// image is cut in tiles, each job of the JobSystem starts on its own run of
+// tiles and steals half of another job's remaining run once its own is done.
+// Rays are traced through a Tlas over the objects' trees, with the light
+// sampled directly (shadow rays) at every bounce. Samples only depend on
+// the pixel and the pass, so images do not depend on the thread count.
+class PathTracer
+{
+private:
+	std::vector<PathTracerObject> m_Objects;
+	std::vector<TlasInstance> m_Instances;
+	// Transposed inverse of each object's transform, for normals.
+	std::vector<glm::mat3> m_NormalTransforms;
+	Tlas m_Tlas;
+	PathTracerCamera m_Camera;
+	PathTracerSettings m_Settings;
+	JobSystem* m_Jobs = nullptr;
+	int m_Width = 0;
+	int m_Height = 0;
+	int m_TilesX = 0;
+	int m_TilesY = 0;
+	// Sum of the samples of each pixel.
+	std::vector<glm::vec3> m_Accumulation;
+	uint32_t m_Passes = 0;
+	// Statistics of the last pass.
+	double m_PassSeconds = 0;
+	unsigned m_PassThreads = 0;
+	size_t m_PassSteals = 0;
+	double m_TotalSeconds = 0;
+
+	glm::vec3 Trace(glm::vec3 origin, glm::vec3 direction, uint32_t& rng) const;
+	void RenderTile(size_t tile);
+
+public:
+	// Builds the top level tree, restarts the accumulation.
+	void SetScene(const std::vector<PathTracerObject>& objects);
+	void SetCamera(const PathTracerCamera& camera);
+	void SetSettings(const PathTracerSettings& settings);
+	// Traces with the jobs of `jobs`, on the calling thread alone without.
+	inline void SetJobSystem(JobSystem* jobs) { m_Jobs = jobs; }
+	void Resize(int width, int height);
+	// Drops the accumulated samples.
+	void Reset();
+
+	void RenderPass();
+
+	// Averaged image as sRGB RGB8, row-major from the top row.
+	void Resolve(std::vector<uint8_t>& rgb) const;
+	// Writes the resolved image as a binary PPM file.
+	bool SavePpm(const char* path) const;
+
+	inline int GetWidth() const { return m_Width; }
+	inline int GetHeight() const { return m_Height; }
+	inline uint32_t GetSamplesPerPixel() const { return m_Passes; }
+	inline unsigned GetPassThreads() const { return m_PassThreads; }
+	inline size_t GetPassSteals() const { return m_PassSteals; }
+	inline double GetPassSeconds() const { return m_PassSeconds; }
+	// Time spent in RenderPass() since the last Reset().
+	inline double GetTotalSeconds() const { return m_TotalSeconds; }
+	// Paths traced per second and per thread during the last pass.
+	inline double GetSamplesPerSecondPerCore() const {
+		return m_PassSeconds > 0 ? double(m_Width) * double(m_Height) / m_PassSeconds / double(m_PassThreads) : 0;
+	}
+};
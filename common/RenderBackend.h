@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "RenderDevice.h"
+
+class CommandList;
+
+// Handles returned by RenderBackend are indices, RENDER_NONE names nothing.
+
+// Without flags, a buffer is only changed with WriteBuffer(), CopyBuffer()
+// and ResizeBuffer(), which moves the contents to new, larger storage.
+enum BufferFlags : uint32_t {
+	// Replaced every frame with CommandList::UpdateBuffer().
+	BUFFER_STREAM = 1 << 0,
+	// Mapped for writing for its whole life, see GetMappedPointer(); writes
+	// are seen by the GPU without flushing, the writer must use fences not
+	// to overwrite data still in use.
+	BUFFER_PERSISTENT = 1 << 1,
+};
+
+enum TextureFormat : uint32_t {
+	TEXTURE_RGBA8,
+	TEXTURE_SRGB8_ALPHA8,
+};
+
+struct TextureDesc {
+	int width = 0;
+	int height = 0;
+	TextureFormat format = TEXTURE_SRGB8_ALPHA8;
+	// Full mip chain generated from `data`, sampled trilinearly.
+	bool mipmaps = true;
+	// width * height texels, the first row at t = 0.
+	const void* data = nullptr;
+};
+
+enum AttributeType : uint32_t {
+	ATTRIBUTE_FLOAT,
+	ATTRIBUTE_HALF_FLOAT,
+	ATTRIBUTE_SHORT,
+	ATTRIBUTE_UNSIGNED_SHORT,
+};
+
+// One vertex attribute read from vertex buffer binding 0. `name` is looked
+// up in the program when set (shaders without layout qualifiers), otherwise
+// `location` is used.
+struct VertexAttribute {
+	const char* name = nullptr;
+	uint32_t location = 0;
+	uint32_t components = 0;
+	AttributeType type = ATTRIBUTE_FLOAT;
+	bool normalized = false;
+	uint32_t offset = 0;
+};
+
+// Program, vertex format and fixed function state drawn with.
+struct PipelineDesc {
+	// Shader file paths.
+	std::string vertexShader;
+	std::string fragmentShader;
+	// Permutation: "NAME" or "NAME value", defined in both stages. Each
+	// stage is compiled once per file and define set, whatever the order.
+	std::vector<std::string> defines;
+	std::vector<VertexAttribute> attributes;
+	uint32_t vertexStride = 0;
+	bool depthTest = true;
+	bool cullFace = true;
+	// Alpha blending (source alpha, one minus source alpha).
+	bool blend = false;
+};
+
+// Thin layer over the graphics API the GL renderer draws through: buffers,
+// textures and pipelines are created up front, frames are recorded into
+// CommandLists and submitted. Everything here runs on the thread owning the
+// context; only the recording of command lists may happen on other threads.
+class RenderBackend
+{
+public:
+	virtual ~RenderBackend() {}
+
+	// `data` may be null, the contents are then undefined.
+	virtual uint32_t CreateBuffer(size_t size, const void* data, uint32_t flags = 0) = 0;
+	virtual void WriteBuffer(uint32_t buffer, size_t offset, const void* data, size_t size) = 0;
+	virtual void CopyBuffer(uint32_t source, size_t sourceOffset, uint32_t destination, size_t destinationOffset, size_t size) = 0;
+	// New storage of `size` bytes holding the first `keep` bytes, under the
+	// same handle; not for BUFFER_PERSISTENT buffers.
+	virtual void ResizeBuffer(uint32_t buffer, size_t size, size_t keep) = 0;
+	virtual void DestroyBuffer(uint32_t buffer) = 0;
+	// Start of a BUFFER_PERSISTENT buffer, null for the others.
+	virtual void* GetMappedPointer(uint32_t buffer) const = 0;
+	// Alignment of the offsets given to CommandList::BindStorageBuffer().
+	virtual size_t GetStorageBufferAlignment() const = 0;
+
+	virtual uint32_t CreateTexture(const TextureDesc& desc) = 0;
+	virtual void DestroyTexture(uint32_t texture) = 0;
+
+	// Returns RENDER_NONE if a shader file cannot be read. The shaders build
+	// in the background: the pipeline draws nothing until they are done, and
+	// never if they do not compile or link (the logs are printed).
+	virtual uint32_t CreatePipeline(const PipelineDesc& desc) = 0;
+	// Files the pipeline's shaders were built from, #includes included.
+	virtual std::vector<std::string> GetPipelineFiles(uint32_t pipeline) const = 0;
+	// Compiles again the shader stages built from `path`, then rebuilds the
+	// pipelines using them under the same handles; the other stages and
+	// pipelines are left alone. The pipelines draw as before until their
+	// rebuild is done, and keep doing so if it fails. Returns the number of
+	// pipelines being rebuilt.
+	virtual size_t ReloadShaderFile(const std::string& path) = 0;
+	virtual void DestroyPipeline(uint32_t pipeline) = 0;
+
+	// Uploads done off the render thread when the backend has an upload
+	// thread, right away otherwise. They return an upload id at once and
+	// keep `data` alive until it is copied; the upload is done once
+	// IsUploadDone() says so after some UpdateUploads() calls.
+	virtual uint32_t WriteBufferAsync(uint32_t buffer, size_t offset, std::shared_ptr<const void> data, size_t size) = 0;
+	// `data` replaces desc.data. The texture handle is valid at once but
+	// samples as unbound until the upload is done.
+	virtual uint32_t CreateTextureAsync(const TextureDesc& desc, std::shared_ptr<const void> data, uint32_t* upload = nullptr) = 0;
+	virtual bool IsUploadDone(uint32_t upload) const = 0;
+	// Completes the uploads the GPU is done with, without waiting for the
+	// others; called once per frame.
+	virtual void UpdateUploads() = 0;
+
+	// Executes the commands in order.
+	virtual void Submit(const CommandList& commands) = 0;
+
+	// Marks the point reached in the submitted commands.
+	virtual uint32_t InsertFence() = 0;
+	// Blocks until the GPU has executed everything submitted before the
+	// fence, then releases it.
+	virtual void WaitFence(uint32_t fence) = 0;
+};
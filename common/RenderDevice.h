@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Mesh.h"
+
+// Per-frame state shared by every draw, the uniforms of 3d.fs.glsl.
+struct RenderFrame {
+	int width = 0;
+	int height = 0;
+	glm::mat4 viewProjection = glm::mat4(1);
+	// The shader's `view` uniform, which holds the camera position.
+	glm::vec3 view = glm::vec3(0);
+	glm::vec3 lightDirection = glm::vec3(1, -1, -1);
+	glm::vec3 lightAmbient = glm::vec3(0.1f);
+	glm::vec3 lightDiffuse = glm::vec3(1);
+	glm::vec3 lightSpecular = glm::vec3(0.5f);
+	glm::vec3 clearColor = glm::vec3(0);
+};
+
+// Colors of ObjectData (tinyobj Ka/Kd/Ks/Ns).
+struct RenderMaterial {
+	glm::vec3 ambient = glm::vec3(0);
+	glm::vec3 diffuse = glm::vec3(1);
+	glm::vec3 specular = glm::vec3(0);
+	float shininess = 1;
+};
+
+const uint32_t RENDER_NONE = ~0u;
+
+// Indices firstIndex .. firstIndex + indexCount - 1 of a mesh, placed in the
+// world by `transform` and lit with the Blinn-Phong model of 3d.fs.glsl.
+struct RenderDraw {
+	uint32_t mesh = RENDER_NONE;
+	uint32_t texture = RENDER_NONE;
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+	glm::mat4 transform = glm::mat4(1);
+	RenderMaterial material;
+};
+
+// Small device interface the scene is drawn through when it is not drawn
+// with GL directly. Meshes and textures are copied at creation and named by
+// the returned index; draws are recorded between BeginFrame() and
+// EndFrame(), which renders them.
+class RenderDevice
+{
+public:
+	virtual ~RenderDevice() {}
+
+	virtual uint32_t CreateMesh(const Vertex3* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount) = 0;
+	// `rgba` is sRGB, the first row at t = 0 as with glTexImage2D.
+	virtual uint32_t CreateTexture(int width, int height, const uint8_t* rgba) = 0;
+	// Destroys every mesh and texture; the next ones are numbered from 0.
+	virtual void DestroyResources() = 0;
+
+	virtual void BeginFrame(const RenderFrame& frame) = 0;
+	virtual void Draw(const RenderDraw& draw) = 0;
+	virtual void EndFrame() = 0;
+
+	// Last frame as sRGB RGB8, row-major from the top row.
+	virtual void ReadPixels(std::vector<uint8_t>& rgb) const = 0;
+};
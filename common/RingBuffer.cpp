@@ -0,0 +1,78 @@
+#include "RingBuffer.h"
+#include "RenderBackend.h"
+
+#include <algorithm>
+#include <chrono>
+
+bool RingBuffer::Create(RenderBackend& backend, size_t frameSize, uint32_t frames) {
+	m_Backend = &backend;
+	m_Frames = std::max(frames, 1u);
+	m_Alignment = backend.GetStorageBufferAlignment();
+	m_Fences.assign(m_Frames, RENDER_NONE);
+	m_Frame = 0;
+	m_Offset = 0;
+	return CreateBuffer(frameSize);
+}
+
+bool RingBuffer::CreateBuffer(size_t frameSize) {
+	m_FrameSize = (std::max<size_t>(frameSize, 1) + m_Alignment - 1) / m_Alignment * m_Alignment;
+	m_Buffer = m_Backend->CreateBuffer(m_FrameSize * m_Frames, nullptr, BUFFER_PERSISTENT);
+	m_Mapped = static_cast<uint8_t*>(m_Backend->GetMappedPointer(m_Buffer));
+	return m_Mapped != nullptr;
+}
+
+void RingBuffer::Destroy() {
+	if (!m_Backend)
+		return;
+	for (uint32_t& fence : m_Fences) {
+		if (fence != RENDER_NONE)
+			m_Backend->WaitFence(fence);
+		fence = RENDER_NONE;
+	}
+	for (const Retired& retired : m_Retired)
+		m_Backend->DestroyBuffer(retired.buffer);
+	m_Retired.clear();
+	m_Backend->DestroyBuffer(m_Buffer);
+	m_Buffer = RENDER_NONE;
+	m_Mapped = nullptr;
+}
+
+void RingBuffer::BeginFrame() {
+	auto start = std::chrono::steady_clock::now();
+	uint32_t& fence = m_Fences[m_Frame % m_Frames];
+	if (fence != RENDER_NONE) {
+		m_Backend->WaitFence(fence);
+		fence = RENDER_NONE;
+	}
+	m_WaitSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// The frames using a retired buffer are complete once the fence of the
+	// last one has been waited for, `frames` frames later
+	auto done = [this](const Retired& retired) { return retired.lastFrame + m_Frames <= m_Frame; };
+	for (const Retired& retired : m_Retired)
+		if (done(retired))
+			m_Backend->DestroyBuffer(retired.buffer);
+	m_Retired.erase(std::remove_if(m_Retired.begin(), m_Retired.end(), done), m_Retired.end());
+	m_Offset = 0;
+}
+
+RingAllocation RingBuffer::Allocate(size_t size) {
+	if (m_Offset + size > m_FrameSize) {
+		// Nothing of the new buffer is in use, the frame continues at its start
+		m_Retired.push_back({ m_Buffer, m_Frame });
+		CreateBuffer(std::max(m_FrameSize * 2, size));
+		m_Offset = 0;
+	}
+	size_t region = size_t(m_Frame % m_Frames) * m_FrameSize;
+	RingAllocation allocation;
+	allocation.buffer = m_Buffer;
+	allocation.offset = region + m_Offset;
+	allocation.data = m_Mapped + allocation.offset;
+	m_Offset = (m_Offset + size + m_Alignment - 1) / m_Alignment * m_Alignment;
+	return allocation;
+}
+
+void RingBuffer::EndFrame() {
+	m_Fences[m_Frame % m_Frames] = m_Backend->InsertFence();
+	m_Frame++;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "RenderDevice.h"
+
+class RenderBackend;
+
+// Place in a RingBuffer: the buffer to bind, the offset to bind it at, and
+// where the CPU writes the data.
+struct RingAllocation {
+	uint32_t buffer = RENDER_NONE;
+	size_t offset = 0;
+	void* data = nullptr;
+};
+
+// Per-frame data written by the CPU straight into a persistently mapped
+// buffer, split in `frames` regions used in turn. Each frame allocates from
+// its region; a fence is inserted after the frame is submitted, and waited
+// for before the region is used again `frames` frames later, which is where
+// a CPU ahead of the GPU stalls (GetWaitSeconds()). When a frame does not
+// fit, a buffer twice as large replaces the ring; the old one stays alive
+// until the frames using it have completed.
+class RingBuffer
+{
+private:
+	struct Retired
+	{
+		uint32_t buffer;
+		uint64_t lastFrame;
+	};
+
+	RenderBackend* m_Backend = nullptr;
+	uint32_t m_Buffer = RENDER_NONE;
+	uint8_t* m_Mapped = nullptr;
+	size_t m_FrameSize = 0;
+	uint32_t m_Frames = 0;
+	size_t m_Alignment = 1;
+	// Fence of each region, RENDER_NONE if none.
+	std::vector<uint32_t> m_Fences;
+	std::vector<Retired> m_Retired;
+	uint64_t m_Frame = 0;
+	size_t m_Offset = 0;
+	double m_WaitSeconds = 0;
+
+	bool CreateBuffer(size_t frameSize);
+
+public:
+	bool Create(RenderBackend& backend, size_t frameSize, uint32_t frames = 3);
+	// Waits for the fences still pending.
+	void Destroy();
+
+	// Waits until the GPU is done with the region of this frame.
+	void BeginFrame();
+	// `size` bytes at an offset aligned for storage buffer bindings, valid
+	// until EndFrame().
+	RingAllocation Allocate(size_t size);
+	// Fences the region, after the frame's commands are submitted.
+	void EndFrame();
+
+	inline uint32_t GetBuffer() const { return m_Buffer; }
+	inline size_t GetFrameSize() const { return m_FrameSize; }
+	// Bytes allocated in the current frame.
+	inline size_t GetUsedSize() const { return m_Offset; }
+	// Time blocked on fences in the last BeginFrame().
+	inline double GetWaitSeconds() const { return m_WaitSeconds; }
+};
@@ -0,0 +1,138 @@
+#include "ShaderPreprocessor.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+// Deeper nesting means an include cycle the once rule did not catch.
+const int MAX_INCLUDE_DEPTH = 32;
+
+// Directory part of `path`, with its separator; empty for a bare file name.
+std::string GetDirectory(const std::string& path) {
+    size_t separator = path.find_last_of("/\\");
+    return separator == std::string::npos ? std::string() : path.substr(0, separator + 1);
+}
+
+// True if `line` is the directive `name`, spaces allowed before and after
+// the '#'.
+bool IsDirective(const std::string& line, const char* name) {
+    size_t start = line.find_first_not_of(" \t");
+    if (start == std::string::npos || line[start] != '#')
+        return false;
+    start = line.find_first_not_of(" \t", start + 1);
+    size_t length = std::char_traits<char>::length(name);
+    return start != std::string::npos && line.compare(start, length, name) == 0 &&
+        (start + length == line.size() || line[start + length] == ' ' || line[start + length] == '\t' ||
+            line[start + length] == '"' || line[start + length] == '<');
+}
+
+void AppendLineDirective(std::string& text, int number, size_t fileIndex) {
+    text += "#line " + std::to_string(number) + " " + std::to_string(fileIndex) + "\n";
+}
+
+bool AppendFile(const std::string& path, const std::vector<std::string>* defines, int depth, ShaderSource& source,
+    std::string& text) {
+    // Read in place, only the lines kept are copied into `text`
+    MappedFile file;
+    if (!file.Open(path)) {
+        std::cerr << "Failed to open shader file: " << path << std::endl;
+        return false;
+    }
+    const char* data = file.Data();
+    size_t size = file.Size();
+    size_t fileIndex = source.files.size();
+    source.files.push_back(path);
+    source.bytes += size;
+    text.reserve(text.size() + size);
+    // The main file starts at line 1 of string 0 already, and nothing may
+    // come before its #version
+    if (fileIndex)
+        AppendLineDirective(text, 1, fileIndex);
+
+    std::string line;
+    for (size_t begin = 0, number = 1; begin < size; number++) {
+        const char* newline = static_cast<const char*>(std::memchr(data + begin, '\n', size - begin));
+        size_t end = newline ? size_t(newline - data) : size;
+        line.assign(data + begin, end - begin);
+        begin = end + 1;
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        if (IsDirective(line, "include")) {
+            size_t open = line.find_first_of("\"<");
+            size_t close = open == std::string::npos ? open : line.find(line[open] == '"' ? '"' : '>', open + 1);
+            if (close == std::string::npos) {
+                std::cerr << path << "(" << number << "): malformed #include" << std::endl;
+                return false;
+            }
+            if (depth >= MAX_INCLUDE_DEPTH) {
+                std::cerr << path << "(" << number << "): #include nested too deeply" << std::endl;
+                return false;
+            }
+            std::string included = GetDirectory(path) + line.substr(open + 1, close - open - 1);
+            if (std::find(source.files.begin(), source.files.end(), included) == source.files.end()) {
+                if (!AppendFile(included, nullptr, depth + 1, source, text)) {
+                    std::cerr << "  included from " << path << "(" << number << ")" << std::endl;
+                    return false;
+                }
+                AppendLineDirective(text, int(number + 1), fileIndex);
+            } else {
+                // Keeps the line count without repeating the file
+                text += "\n";
+            }
+            continue;
+        }
+
+        text += line;
+        text += "\n";
+        if (defines && IsDirective(line, "version")) {
+            for (const std::string& define : *defines)
+                text += "#define " + define + "\n";
+            AppendLineDirective(text, int(number + 1), fileIndex);
+            defines = nullptr;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+bool PreprocessShader(const std::string& path, const std::vector<std::string>& defines, ShaderSource& source) {
+    source = ShaderSource();
+    return AppendFile(path, defines.empty() ? nullptr : &defines, 0, source, source.text);
+}
+
+std::string AnnotateShaderLog(const std::string& log, const std::vector<std::string>& files) {
+    std::string annotated;
+    annotated.reserve(log.size());
+    for (size_t begin = 0; begin < log.size();) {
+        size_t end = log.find('\n', begin);
+        end = end == std::string::npos ? log.size() : end + 1;
+
+        // Source string number, after the severity some compilers start with
+        size_t number = begin;
+        for (const char* prefix : { "ERROR: ", "WARNING: " })
+            if (log.compare(begin, std::char_traits<char>::length(prefix), prefix) == 0)
+                number = begin + std::char_traits<char>::length(prefix);
+        size_t digits = number;
+        while (digits < end && std::isdigit(static_cast<unsigned char>(log[digits])))
+            digits++;
+        size_t index = digits > number ? size_t(std::stoul(log.substr(number, digits - number))) : files.size();
+        bool located = digits + 1 < end && (log[digits] == '(' || log[digits] == ':') &&
+            std::isdigit(static_cast<unsigned char>(log[digits + 1]));
+
+        if (located && index < files.size()) {
+            annotated.append(log, begin, number - begin);
+            annotated += files[index];
+            annotated.append(log, digits, end - digits);
+        } else {
+            annotated.append(log, begin, end - begin);
+        }
+        begin = end;
+    }
+    return annotated;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// GLSL source assembled from a shader file for one permutation: each
+// `#include "file"` line is replaced by that file (found relative to the
+// including one, included once like with #pragma once), and a `#define` line
+// per entry of `defines` ("NAME" or "NAME value") follows the #version line.
+// #line directives keep the compiler messages pointing at the original
+// lines: "2(14)" is line 14 of files[2].
+struct ShaderSource {
+    std::string text;
+    // Every file read, the main one first; the source is out of date once
+    // one of them changes.
+    std::vector<std::string> files;
+    // Size of the files read.
+    size_t bytes = 0;
+};
+
+// Reports the file and line of unreadable files and malformed #include lines.
+bool PreprocessShader(const std::string& path, const std::vector<std::string>& defines, ShaderSource& source);
+// Compiler log with the source string numbers at the start of its messages
+// ("0(12)", "0:12(5)", "ERROR: 0:12:") replaced by the file paths.
+std::string AnnotateShaderLog(const std::string& log, const std::vector<std::string>& files);
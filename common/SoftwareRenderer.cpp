@@ -0,0 +1,598 @@
+#include "SoftwareRenderer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include "JobSystem.h"
+
+#if defined(__AVX2__)
+#define SOFTWARE_AVX2 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOFTWARE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Subpixel precision of the snapped vertices, as GL implementations use.
+const int64_t SUBPIXELS = 16;
+const int64_t HALF_PIXEL = SUBPIXELS / 2;
+// Triangles reaching further than this from the screen center (in pixels)
+// are clipped, which keeps the edge functions inside a tile in 32 bits.
+const float GUARD_BAND = 8192.f;
+const int TILE_WIDTH = 32;
+const int TILE_HEIGHT = 16;
+const size_t TILE_PIXELS = size_t(TILE_WIDTH) * size_t(TILE_HEIGHT);
+// Triangles set up by a job each time it takes work.
+const uint32_t CHUNK_TRIANGLES = 4096;
+// Transformed vertices kept per job (direct mapped by index); meshes are
+// optimized for the vertex cache, so most corners hit.
+const uint32_t VERTEX_CACHE_SIZE = 64;
+const int PLANE_COUNT = 7;
+const int ATTRIBUTE_COUNT = 5;
+
+// LANES pixels of a tile row processed at once. Edge values are inside when
+// >= 0, so the sign bit of their OR is set exactly for the pixels outside;
+// masks have all bits set in the lanes kept.
+#if defined(SOFTWARE_AVX2)
+const int LANES = 8;
+typedef __m256i Ints;
+typedef __m256 Floats;
+typedef __m256 Mask;
+inline Ints LoadInts(const int32_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+inline Ints SetInts(int32_t value) { return _mm256_set1_epi32(value); }
+inline Ints AddInts(Ints a, Ints b) { return _mm256_add_epi32(a, b); }
+inline Ints OrInts(Ints a, Ints b) { return _mm256_or_si256(a, b); }
+inline Floats LoadFloats(const float* p) { return _mm256_loadu_ps(p); }
+inline void StoreFloats(float* p, Floats value) { _mm256_storeu_ps(p, value); }
+inline Floats SetFloats(float value) { return _mm256_set1_ps(value); }
+inline Floats Add(Floats a, Floats b) { return _mm256_add_ps(a, b); }
+inline Floats Sub(Floats a, Floats b) { return _mm256_sub_ps(a, b); }
+inline Floats Mul(Floats a, Floats b) { return _mm256_mul_ps(a, b); }
+inline Floats Div(Floats a, Floats b) { return _mm256_div_ps(a, b); }
+inline Floats Max(Floats a, Floats b) { return _mm256_max_ps(a, b); }
+inline Floats Sqrt(Floats a) { return _mm256_sqrt_ps(a); }
+inline Mask Inside(Ints edges) { return _mm256_castsi256_ps(_mm256_cmpgt_epi32(edges, _mm256_set1_epi32(-1))); }
+inline Mask Less(Floats a, Floats b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+inline Mask Greater(Floats a, Floats b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+inline Mask And(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+inline int MaskBits(Mask mask) { return _mm256_movemask_ps(mask); }
+inline Floats Select(Mask mask, Floats a, Floats b) { return _mm256_blendv_ps(b, a, mask); }
+// 2^x for x in [-126, 126], and log2(x) for normal x > 0.
+inline Floats Exp2(Floats x) {
+	Floats floor = _mm256_floor_ps(x);
+	Floats f = _mm256_sub_ps(x, floor);
+	__m256i exponent = _mm256_slli_epi32(_mm256_cvtps_epi32(floor), 23);
+	Floats p = SetFloats(1.33335581e-3f);
+	p = Add(Mul(p, f), SetFloats(9.61812911e-3f));
+	p = Add(Mul(p, f), SetFloats(5.55041087e-2f));
+	p = Add(Mul(p, f), SetFloats(2.40226507e-1f));
+	p = Add(Mul(p, f), SetFloats(6.93147181e-1f));
+	p = Add(Mul(p, f), SetFloats(1.f));
+	return _mm256_castsi256_ps(_mm256_add_epi32(_mm256_castps_si256(p), exponent));
+}
+inline Floats Log2(Floats x) {
+	__m256i bits = _mm256_castps_si256(x);
+	Floats exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+	Floats m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x7fffff)), _mm256_set1_epi32(0x3f800000)));
+	Floats s = Div(Sub(m, SetFloats(1.f)), Add(m, SetFloats(1.f)));
+	Floats s2 = Mul(s, s);
+	Floats p = SetFloats(1.f / 9);
+	p = Add(Mul(p, s2), SetFloats(1.f / 7));
+	p = Add(Mul(p, s2), SetFloats(1.f / 5));
+	p = Add(Mul(p, s2), SetFloats(1.f / 3));
+	p = Add(Mul(p, s2), SetFloats(1.f));
+	return Add(exponent, Mul(Mul(s, p), SetFloats(2.88539008f)));
+}
+#elif defined(SOFTWARE_SSE2)
+const int LANES = 4;
+typedef __m128i Ints;
+typedef __m128 Floats;
+typedef __m128 Mask;
+inline Ints LoadInts(const int32_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+inline Ints SetInts(int32_t value) { return _mm_set1_epi32(value); }
+inline Ints AddInts(Ints a, Ints b) { return _mm_add_epi32(a, b); }
+inline Ints OrInts(Ints a, Ints b) { return _mm_or_si128(a, b); }
+inline Floats LoadFloats(const float* p) { return _mm_loadu_ps(p); }
+inline void StoreFloats(float* p, Floats value) { _mm_storeu_ps(p, value); }
+inline Floats SetFloats(float value) { return _mm_set1_ps(value); }
+inline Floats Add(Floats a, Floats b) { return _mm_add_ps(a, b); }
+inline Floats Sub(Floats a, Floats b) { return _mm_sub_ps(a, b); }
+inline Floats Mul(Floats a, Floats b) { return _mm_mul_ps(a, b); }
+inline Floats Div(Floats a, Floats b) { return _mm_div_ps(a, b); }
+inline Floats Max(Floats a, Floats b) { return _mm_max_ps(a, b); }
+inline Floats Sqrt(Floats a) { return _mm_sqrt_ps(a); }
+inline Mask Inside(Ints edges) { return _mm_castsi128_ps(_mm_cmpgt_epi32(edges, _mm_set1_epi32(-1))); }
+inline Mask Less(Floats a, Floats b) { return _mm_cmplt_ps(a, b); }
+inline Mask Greater(Floats a, Floats b) { return _mm_cmpgt_ps(a, b); }
+inline Mask And(Mask a, Mask b) { return _mm_and_ps(a, b); }
+inline int MaskBits(Mask mask) { return _mm_movemask_ps(mask); }
+inline Floats Select(Mask mask, Floats a, Floats b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+inline Floats Exp2(Floats x) {
+	// Floor: truncation is one too high for negative fractions.
+	__m128i truncated = _mm_cvttps_epi32(x);
+	Floats floor = _mm_cvtepi32_ps(truncated);
+	__m128 adjust = _mm_cmpgt_ps(floor, x);
+	floor = _mm_sub_ps(floor, _mm_and_ps(adjust, _mm_set1_ps(1.f)));
+	truncated = _mm_add_epi32(truncated, _mm_castps_si128(adjust));
+	Floats f = _mm_sub_ps(x, floor);
+	__m128i exponent = _mm_slli_epi32(truncated, 23);
+	Floats p = SetFloats(1.33335581e-3f);
+	p = Add(Mul(p, f), SetFloats(9.61812911e-3f));
+	p = Add(Mul(p, f), SetFloats(5.55041087e-2f));
+	p = Add(Mul(p, f), SetFloats(2.40226507e-1f));
+	p = Add(Mul(p, f), SetFloats(6.93147181e-1f));
+	p = Add(Mul(p, f), SetFloats(1.f));
+	return _mm_castsi128_ps(_mm_add_epi32(_mm_castps_si128(p), exponent));
+}
+inline Floats Log2(Floats x) {
+	__m128i bits = _mm_castps_si128(x);
+	Floats exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+	Floats m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x7fffff)), _mm_set1_epi32(0x3f800000)));
+	Floats s = Div(Sub(m, SetFloats(1.f)), Add(m, SetFloats(1.f)));
+	Floats s2 = Mul(s, s);
+	Floats p = SetFloats(1.f / 9);
+	p = Add(Mul(p, s2), SetFloats(1.f / 7));
+	p = Add(Mul(p, s2), SetFloats(1.f / 5));
+	p = Add(Mul(p, s2), SetFloats(1.f / 3));
+	p = Add(Mul(p, s2), SetFloats(1.f));
+	return Add(exponent, Mul(Mul(s, p), SetFloats(2.88539008f)));
+}
+#else
+const int LANES = 1;
+typedef int32_t Ints;
+typedef float Floats;
+typedef bool Mask;
+inline Ints LoadInts(const int32_t* p) { return *p; }
+inline Ints SetInts(int32_t value) { return value; }
+inline Ints AddInts(Ints a, Ints b) { return a + b; }
+inline Ints OrInts(Ints a, Ints b) { return a | b; }
+inline Floats LoadFloats(const float* p) { return *p; }
+inline void StoreFloats(float* p, Floats value) { *p = value; }
+inline Floats SetFloats(float value) { return value; }
+inline Floats Add(Floats a, Floats b) { return a + b; }
+inline Floats Sub(Floats a, Floats b) { return a - b; }
+inline Floats Mul(Floats a, Floats b) { return a * b; }
+inline Floats Div(Floats a, Floats b) { return a / b; }
+inline Floats Max(Floats a, Floats b) { return std::max(a, b); }
+inline Floats Sqrt(Floats a) { return std::sqrt(a); }
+inline Mask Inside(Ints edges) { return edges >= 0; }
+inline Mask Less(Floats a, Floats b) { return a < b; }
+inline Mask Greater(Floats a, Floats b) { return a > b; }
+inline Mask And(Mask a, Mask b) { return a && b; }
+inline int MaskBits(Mask mask) { return mask ? 1 : 0; }
+inline Floats Select(Mask mask, Floats a, Floats b) { return mask ? a : b; }
+inline Floats Exp2(Floats x) { return std::exp2(x); }
+inline Floats Log2(Floats x) { return std::log2(x); }
+#endif
+
+// pow(x, y) as in GLSL for x >= 0: 0 at x = 0.
+inline Floats Pow(Floats x, Floats y) {
+	const Floats tiny = SetFloats(1e-30f);
+	Floats result = Exp2(Max(Mul(y, Log2(Max(x, tiny))), SetFloats(-126.f)));
+	return Select(Greater(x, tiny), result, SetFloats(0.f));
+}
+
+inline int64_t FloorDiv(int64_t a, int64_t b) {
+	return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+inline float LinearToSrgb(float c) {
+	return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1 / 2.4f) - 0.055f;
+}
+
+} // namespace
+
+uint32_t SoftwareRenderer::CreateMesh(const Vertex3* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount) {
+	m_Meshes.push_back(MeshData());
+	m_Meshes.back().vertices.assign(vertices, vertices + vertexCount);
+	m_Meshes.back().indices.assign(indices, indices + indexCount);
+	return uint32_t(m_Meshes.size() - 1);
+}
+
+uint32_t SoftwareRenderer::CreateTexture(int width, int height, const uint8_t* rgba) {
+	m_Textures.push_back(CpuTexture());
+	m_Textures.back().Create(width, height, rgba);
+	return uint32_t(m_Textures.size() - 1);
+}
+
+void SoftwareRenderer::DestroyResources() {
+	m_Draws.clear();
+	std::vector<MeshData>().swap(m_Meshes);
+	std::vector<CpuTexture>().swap(m_Textures);
+}
+
+void SoftwareRenderer::BeginFrame(const RenderFrame& frame) {
+	m_Frame = frame;
+	m_Draws.clear();
+	int width = std::max(frame.width, 1), height = std::max(frame.height, 1);
+	if (width != m_Width || height != m_Height) {
+		m_Width = width;
+		m_Height = height;
+		m_TilesX = (m_Width + TILE_WIDTH - 1) / TILE_WIDTH;
+		m_TilesY = (m_Height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+		m_Color.resize(size_t(m_TilesX) * size_t(m_TilesY) * TILE_PIXELS * 3);
+		m_Depth.resize(size_t(m_TilesX) * size_t(m_TilesY) * TILE_PIXELS);
+	}
+}
+
+// Draws of missing meshes or past the end of their indices are skipped.
+void SoftwareRenderer::Draw(const RenderDraw& draw) {
+	if (draw.mesh >= m_Meshes.size() || draw.indexCount < 3)
+		return;
+	size_t indexCount = m_Meshes[draw.mesh].indices.size();
+	if (draw.firstIndex > indexCount || draw.indexCount > indexCount - draw.firstIndex)
+		return;
+	m_Draws.push_back(draw);
+}
+
+void SoftwareRenderer::SetupTriangle(Setup& setup, uint32_t draw, const ClipVertex* vertices) {
+	const float halfWidth = 0.5f * float(m_Width), halfHeight = 0.5f * float(m_Height);
+	int64_t x[3], y[3];
+	for (int k = 0; k < 3; k++) {
+		const glm::vec4& clip = vertices[k].position;
+		float invW = 1 / clip.w;
+		x[k] = int64_t(std::floor((clip.x * invW + 1) * halfWidth * float(SUBPIXELS) + 0.5f));
+		y[k] = int64_t(std::floor((clip.y * invW + 1) * halfHeight * float(SUBPIXELS) + 0.5f));
+	}
+	// Counter-clockwise triangles are the front faces.
+	int64_t area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (area <= 0)
+		return;
+
+	// Pixel centers inside the bounding box.
+	Triangle triangle;
+	triangle.pixelMin[0] = int(std::max<int64_t>(FloorDiv(std::min(x[0], std::min(x[1], x[2])) - HALF_PIXEL + SUBPIXELS - 1, SUBPIXELS), 0));
+	triangle.pixelMax[0] = int(std::min<int64_t>(FloorDiv(std::max(x[0], std::max(x[1], x[2])) - HALF_PIXEL, SUBPIXELS), m_Width - 1));
+	triangle.pixelMin[1] = int(std::max<int64_t>(FloorDiv(std::min(y[0], std::min(y[1], y[2])) - HALF_PIXEL + SUBPIXELS - 1, SUBPIXELS), 0));
+	triangle.pixelMax[1] = int(std::min<int64_t>(FloorDiv(std::max(y[0], std::max(y[1], y[2])) - HALF_PIXEL, SUBPIXELS), m_Height - 1));
+	if (triangle.pixelMin[0] > triangle.pixelMax[0] || triangle.pixelMin[1] > triangle.pixelMax[1])
+		return;
+	triangle.origin[0] = triangle.pixelMin[0];
+	triangle.origin[1] = triangle.pixelMin[1];
+	triangle.draw = draw;
+
+	// Edge k is opposite to vertex k, its function is the barycentric
+	// weight of that vertex times the area. Values divided by w interpolate
+	// linearly on screen.
+	double values[PLANE_COUNT][3];
+	for (int k = 0; k < 3; k++) {
+		int a = (k + 1) % 3, b = (k + 2) % 3;
+		triangle.edgeA[k] = int32_t(y[a] - y[b]);
+		triangle.edgeB[k] = int32_t(x[b] - x[a]);
+		triangle.edgeC[k] = -(int64_t(triangle.edgeA[k]) * x[a] + int64_t(triangle.edgeB[k]) * y[a]);
+		const glm::vec4& clip = vertices[k].position;
+		double invW = 1.0 / double(clip.w);
+		values[0][k] = double(clip.z) * invW;
+		values[1][k] = invW;
+		for (int i = 0; i < ATTRIBUTE_COUNT; i++)
+			values[2 + i][k] = double(vertices[k].attributes[i]) * invW;
+	}
+	for (int p = 0; p < PLANE_COUNT; p++) {
+		double planeA = 0, planeB = 0, planeC = 0;
+		for (int k = 0; k < 3; k++) {
+			planeA += double(triangle.edgeA[k]) * values[p][k];
+			planeB += double(triangle.edgeB[k]) * values[p][k];
+			planeC += double(triangle.edgeC[k]) * values[p][k];
+		}
+		double stepX = planeA * double(SUBPIXELS) / double(area), stepY = planeB * double(SUBPIXELS) / double(area);
+		double origin = (planeA * double(HALF_PIXEL) + planeB * double(HALF_PIXEL) + planeC) / double(area) +
+			stepX * triangle.origin[0] + stepY * triangle.origin[1];
+		triangle.planes[p][0] = float(origin);
+		triangle.planes[p][1] = float(stepX);
+		triangle.planes[p][2] = float(stepY);
+	}
+
+	uint32_t index = uint32_t(setup.triangles.size());
+	setup.triangles.push_back(triangle);
+	for (int ty = triangle.pixelMin[1] / TILE_HEIGHT; ty <= triangle.pixelMax[1] / TILE_HEIGHT; ty++)
+		for (int tx = triangle.pixelMin[0] / TILE_WIDTH; tx <= triangle.pixelMax[0] / TILE_WIDTH; tx++)
+			setup.bins[size_t(ty) * size_t(m_TilesX) + size_t(tx)].push_back(index);
+}
+
+void SoftwareRenderer::RasterizeTile(size_t tile) {
+	float* depth = &m_Depth[tile * TILE_PIXELS];
+	float* colors[3] = {
+		&m_Color[tile * TILE_PIXELS * 3], &m_Color[tile * TILE_PIXELS * 3 + TILE_PIXELS], &m_Color[tile * TILE_PIXELS * 3 + 2 * TILE_PIXELS],
+	};
+	std::fill(depth, depth + TILE_PIXELS, 1.f);
+	for (int c = 0; c < 3; c++)
+		std::fill(colors[c], colors[c] + TILE_PIXELS, m_Frame.clearColor[c]);
+	const int tileX = int(tile % size_t(m_TilesX)) * TILE_WIDTH, tileY = int(tile / size_t(m_TilesX)) * TILE_HEIGHT;
+
+	// As 3d.fs.glsl: the light direction is not normalized, the half vector
+	// uses the `view` uniform.
+	const glm::vec3 light = -m_Frame.lightDirection;
+	const glm::vec3 half = glm::normalize(light + m_Frame.view);
+	float laneOffsets[LANES];
+	for (int lane = 0; lane < LANES; lane++)
+		laneOffsets[lane] = float(lane);
+	const Floats lanes = LoadFloats(laneOffsets);
+
+	for (const Setup& setup : m_Setups) {
+		for (uint32_t index : setup.bins[tile]) {
+			const Triangle& triangle = setup.triangles[index];
+			const DrawState& state = m_DrawStates[triangle.draw];
+			int rowBegin = std::max(triangle.pixelMin[1] - tileY, 0);
+			int rowEnd = std::min(triangle.pixelMax[1] - tileY, TILE_HEIGHT - 1);
+			int columnBegin = std::max(triangle.pixelMin[0] - tileX, 0) / LANES * LANES;
+			int columnEnd = std::min(triangle.pixelMax[0] - tileX, TILE_WIDTH - 1);
+
+			// Edge functions at the first pixel drawn. An edge with the whole
+			// tile inside is dropped, one with the whole tile outside
+			// rejects the triangle; the others stay within 32 bits over the tile.
+			int32_t edges[3], stepX[3], stepY[3];
+			bool outside = false;
+			for (int k = 0; k < 3; k++) {
+				int64_t dx = int64_t(triangle.edgeA[k]) * SUBPIXELS, dy = int64_t(triangle.edgeB[k]) * SUBPIXELS;
+				int64_t value = int64_t(triangle.edgeA[k]) * (int64_t(tileX) * SUBPIXELS + HALF_PIXEL) +
+					int64_t(triangle.edgeB[k]) * (int64_t(tileY) * SUBPIXELS + HALF_PIXEL) + triangle.edgeC[k];
+				int64_t minValue = value + std::min<int64_t>(dx * (TILE_WIDTH - 1), 0) + std::min<int64_t>(dy * (TILE_HEIGHT - 1), 0);
+				int64_t maxValue = value + std::max<int64_t>(dx * (TILE_WIDTH - 1), 0) + std::max<int64_t>(dy * (TILE_HEIGHT - 1), 0);
+				if (maxValue < 0) {
+					outside = true;
+					break;
+				}
+				if (minValue >= 0) {
+					edges[k] = stepX[k] = stepY[k] = 0;
+				} else {
+					edges[k] = int32_t(value + dx * columnBegin + dy * rowBegin);
+					stepX[k] = int32_t(dx);
+					stepY[k] = int32_t(dy);
+				}
+			}
+			if (outside)
+				continue;
+
+			int32_t laneEdges[3][LANES];
+			for (int lane = 0; lane < LANES; lane++)
+				for (int k = 0; k < 3; k++)
+					laneEdges[k][lane] = stepX[k] * lane;
+			const Ints laneEdgeOffsets[3] = { LoadInts(laneEdges[0]), LoadInts(laneEdges[1]), LoadInts(laneEdges[2]) };
+			const Ints spanSteps[3] = { SetInts(stepX[0] * LANES), SetInts(stepX[1] * LANES), SetInts(stepX[2] * LANES) };
+
+			for (int row = rowBegin; row <= rowEnd; row++) {
+				Ints e0 = AddInts(SetInts(edges[0]), laneEdgeOffsets[0]);
+				Ints e1 = AddInts(SetInts(edges[1]), laneEdgeOffsets[1]);
+				Ints e2 = AddInts(SetInts(edges[2]), laneEdgeOffsets[2]);
+				const Floats y = SetFloats(float(tileY + row - triangle.origin[1]));
+				const size_t rowOffset = size_t(row) * TILE_WIDTH;
+				for (int column = columnBegin; column <= columnEnd; column += LANES) {
+					Mask inside = Inside(OrInts(OrInts(e0, e1), e2));
+					e0 = AddInts(e0, spanSteps[0]);
+					e1 = AddInts(e1, spanSteps[1]);
+					e2 = AddInts(e2, spanSteps[2]);
+					if (MaskBits(inside) == 0)
+						continue;
+					const Floats x = Add(SetFloats(float(tileX + column - triangle.origin[0])), lanes);
+					auto plane = [&](int p) {
+						return Add(SetFloats(triangle.planes[p][0]), Add(Mul(x, SetFloats(triangle.planes[p][1])), Mul(y, SetFloats(triangle.planes[p][2]))));
+					};
+					float* depthSpan = depth + rowOffset + column;
+					Floats z = plane(0);
+					Floats oldDepth = LoadFloats(depthSpan);
+					Mask visible = And(inside, Less(z, oldDepth));
+					const int visibleBits = MaskBits(visible);
+					if (visibleBits == 0)
+						continue;
+					StoreFloats(depthSpan, Select(visible, z, oldDepth));
+
+					// Perspective correct attributes.
+					Floats w = Div(SetFloats(1.f), plane(1));
+					Floats u = Mul(plane(2), w), v = Mul(plane(3), w);
+					Floats nx = Mul(plane(4), w), ny = Mul(plane(5), w), nz = Mul(plane(6), w);
+					Floats length = Sqrt(Add(Mul(nx, nx), Add(Mul(ny, ny), Mul(nz, nz))));
+					Floats invLength = Div(SetFloats(1.f), Max(length, SetFloats(1e-20f)));
+					nx = Mul(nx, invLength);
+					ny = Mul(ny, invLength);
+					nz = Mul(nz, invLength);
+
+					// Blinn-Phong of 3d.fs.glsl.
+					Floats nl = Add(Mul(nx, SetFloats(light.x)), Add(Mul(ny, SetFloats(light.y)), Mul(nz, SetFloats(light.z))));
+					Floats nh = Add(Mul(nx, SetFloats(half.x)), Add(Mul(ny, SetFloats(half.y)), Mul(nz, SetFloats(half.z))));
+					Floats diffuse = Max(nl, SetFloats(0.f));
+					Floats specular = Select(Greater(nl, SetFloats(0.f)), Pow(Max(nh, SetFloats(0.f)), SetFloats(state.shininess)), SetFloats(0.f));
+
+					float textureLanes[3][LANES];
+					if (state.texture) {
+						float uLanes[LANES], vLanes[LANES];
+						StoreFloats(uLanes, u);
+						StoreFloats(vLanes, v);
+						for (int lane = 0; lane < LANES; lane++) {
+							glm::vec4 texel = (visibleBits >> lane) & 1 ? state.texture->Sample(glm::vec2(uLanes[lane], -vLanes[lane])) : glm::vec4(0);
+							textureLanes[0][lane] = texel.r;
+							textureLanes[1][lane] = texel.g;
+							textureLanes[2][lane] = texel.b;
+						}
+					}
+					for (int c = 0; c < 3; c++) {
+						Floats lit = Add(SetFloats(state.ambient[c]), Add(Mul(diffuse, SetFloats(state.diffuse[c])), Mul(specular, SetFloats(state.specular[c]))));
+						if (state.texture)
+							lit = Mul(lit, LoadFloats(textureLanes[c]));
+						float* colorSpan = colors[c] + rowOffset + column;
+						StoreFloats(colorSpan, Select(visible, lit, LoadFloats(colorSpan)));
+					}
+				}
+				for (int k = 0; k < 3; k++)
+					edges[k] += stepY[k];
+			}
+		}
+	}
+}
+
+void SoftwareRenderer::EndFrame() {
+	auto start = std::chrono::steady_clock::now();
+	const size_t tileCount = size_t(m_TilesX) * size_t(m_TilesY);
+	unsigned threads = m_Jobs ? m_Jobs->GetThreadCount() : 1;
+	if (m_ThreadCount)
+		threads = std::min(threads, m_ThreadCount);
+	m_FrameThreads = threads;
+	// Runs work(job) for each of the `threads` jobs of a phase; every job
+	// takes the next piece of work until none is left
+	auto runJobs = [this, threads](const std::function<void(unsigned)>& work) {
+		if (!m_Jobs) {
+			work(0);
+			return;
+		}
+		m_Jobs->ParallelFor(threads, 1, [&work](size_t begin, size_t end) {
+			for (size_t job = begin; job < end; job++)
+				work(unsigned(job));
+		});
+	};
+
+	m_DrawStates.resize(m_Draws.size());
+	struct Chunk {
+		uint32_t draw;
+		uint32_t firstIndex;
+		uint32_t indexCount;
+	};
+	std::vector<Chunk> chunks;
+	m_TrianglesSubmitted = 0;
+	for (uint32_t d = 0; d < m_Draws.size(); d++) {
+		const RenderDraw& draw = m_Draws[d];
+		DrawState& state = m_DrawStates[d];
+		state.texture = draw.texture < m_Textures.size() ? &m_Textures[draw.texture] : nullptr;
+		state.ambient = m_Frame.lightAmbient * draw.material.ambient;
+		state.diffuse = m_Frame.lightDiffuse * draw.material.diffuse;
+		state.specular = m_Frame.lightSpecular * draw.material.specular;
+		state.shininess = draw.material.shininess;
+		uint32_t triangles = draw.indexCount / 3;
+		m_TrianglesSubmitted += triangles;
+		for (uint32_t t = 0; t < triangles; t += CHUNK_TRIANGLES)
+			chunks.push_back({ d, draw.firstIndex + t * 3, std::min(CHUNK_TRIANGLES, triangles - t) * 3 });
+	}
+
+	// Setup: each job bins into its own lists, taking chunks in turn.
+	m_Setups.resize(threads);
+	for (Setup& setup : m_Setups) {
+		setup.triangles.clear();
+		setup.bins.resize(tileCount);
+		for (std::vector<uint32_t>& bin : setup.bins)
+			bin.clear();
+	}
+	std::atomic<size_t> nextChunk(0);
+	auto setupChunks = [this, &chunks, &nextChunk](unsigned job) {
+		Setup& setup = m_Setups[job];
+		// Clip space planes: near (z >= -w) and the guard band (|x|, |y| <= g * w).
+		const glm::vec4 clipPlanes[5] = {
+			glm::vec4(0, 0, 1, 1),
+			glm::vec4(-1, 0, 0, GUARD_BAND / (0.5f * float(m_Width))), glm::vec4(1, 0, 0, GUARD_BAND / (0.5f * float(m_Width))),
+			glm::vec4(0, -1, 0, GUARD_BAND / (0.5f * float(m_Height))), glm::vec4(0, 1, 0, GUARD_BAND / (0.5f * float(m_Height))),
+		};
+		std::vector<ClipVertex> polygon, clipped;
+		struct CachedVertex {
+			uint32_t index;
+			int outside;
+			ClipVertex vertex;
+		};
+		CachedVertex cache[VERTEX_CACHE_SIZE];
+		for (size_t c = nextChunk++; c < chunks.size(); c = nextChunk++) {
+			for (CachedVertex& cached : cache)
+				cached.index = ~0u;
+			const Chunk& chunk = chunks[c];
+			const RenderDraw& draw = m_Draws[chunk.draw];
+			const MeshData& mesh = m_Meshes[draw.mesh];
+			const glm::mat4 matrix = m_Frame.viewProjection * draw.transform;
+			const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(draw.transform)));
+			const uint32_t* indices = &mesh.indices[chunk.firstIndex];
+			for (uint32_t i = 0; i + 2 < chunk.indexCount; i += 3) {
+				ClipVertex triangle[3];
+				int outsideMask = 0xff, anyOutside = 0;
+				for (int k = 0; k < 3; k++) {
+					const uint32_t index = indices[i + k];
+					CachedVertex& cached = cache[index % VERTEX_CACHE_SIZE];
+					if (cached.index != index) {
+						const Vertex3& vertex = mesh.vertices[index];
+						const glm::vec3& p = vertex.position;
+						ClipVertex& transformed = cached.vertex;
+						transformed.position = matrix[0] * p.x + matrix[1] * p.y + matrix[2] * p.z + matrix[3];
+						glm::vec3 normal = normalMatrix * vertex.normal;
+						transformed.attributes[0] = vertex.texCoords.x;
+						transformed.attributes[1] = vertex.texCoords.y;
+						transformed.attributes[2] = normal.x;
+						transformed.attributes[3] = normal.y;
+						transformed.attributes[4] = normal.z;
+						cached.outside = 0;
+						for (int plane = 0; plane < 5; plane++)
+							if (glm::dot(clipPlanes[plane], transformed.position) < 0)
+								cached.outside |= 1 << plane;
+						cached.index = index;
+					}
+					triangle[k] = cached.vertex;
+					outsideMask &= cached.outside;
+					anyOutside |= cached.outside;
+				}
+				// Entirely behind one plane, or entirely inside all of them.
+				if (outsideMask)
+					continue;
+				if (!anyOutside) {
+					this->SetupTriangle(setup, chunk.draw, triangle);
+					continue;
+				}
+
+				// Sutherland-Hodgman against the planes crossed, then a fan.
+				polygon.assign(triangle, triangle + 3);
+				for (int plane = 0; plane < 5 && polygon.size() >= 3; plane++) {
+					if (!(anyOutside & (1 << plane)))
+						continue;
+					clipped.clear();
+					for (size_t k = 0; k < polygon.size(); k++) {
+						const ClipVertex& a = polygon[k];
+						const ClipVertex& b = polygon[(k + 1) % polygon.size()];
+						float da = glm::dot(clipPlanes[plane], a.position), db = glm::dot(clipPlanes[plane], b.position);
+						if (da >= 0)
+							clipped.push_back(a);
+						if ((da >= 0) != (db >= 0)) {
+							float t = da / (da - db);
+							ClipVertex v;
+							v.position = a.position + (b.position - a.position) * t;
+							for (int n = 0; n < ATTRIBUTE_COUNT; n++)
+								v.attributes[n] = a.attributes[n] + (b.attributes[n] - a.attributes[n]) * t;
+							clipped.push_back(v);
+						}
+					}
+					polygon.swap(clipped);
+				}
+				for (size_t k = 2; k < polygon.size(); k++) {
+					ClipVertex fan[3] = { polygon[0], polygon[k - 1], polygon[k] };
+					this->SetupTriangle(setup, chunk.draw, fan);
+				}
+			}
+		}
+	};
+	runJobs(setupChunks);
+	m_TrianglesRasterized = 0;
+	for (const Setup& setup : m_Setups)
+		m_TrianglesRasterized += setup.triangles.size();
+	auto setupEnd = std::chrono::steady_clock::now();
+	m_SetupSeconds = std::chrono::duration<double>(setupEnd - start).count();
+
+	// Raster: tiles are independent, jobs take the next one until none is left.
+	std::atomic<size_t> nextTile(0);
+	runJobs([this, tileCount, &nextTile](unsigned) {
+		for (size_t tile = nextTile++; tile < tileCount; tile = nextTile++)
+			this->RasterizeTile(tile);
+	});
+	m_RasterSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - setupEnd).count();
+}
+
+void SoftwareRenderer::ReadPixels(std::vector<uint8_t>& rgb) const {
+	rgb.resize(size_t(m_Width) * size_t(m_Height) * 3);
+	// GL_FRAMEBUFFER_SRGB: linear colors are encoded on write.
+	uint8_t table[4096];
+	for (int i = 0; i < 4096; i++)
+		table[i] = uint8_t(LinearToSrgb(float(i) / 4095.f) * 255 + 0.5f);
+	for (int y = 0; y < m_Height; y++) {
+		uint8_t* row = &rgb[size_t(m_Height - 1 - y) * size_t(m_Width) * 3];
+		for (int x = 0; x < m_Width; x++) {
+			size_t tile = size_t(y / TILE_HEIGHT) * size_t(m_TilesX) + size_t(x / TILE_WIDTH);
+			size_t pixel = size_t(y % TILE_HEIGHT) * TILE_WIDTH + size_t(x % TILE_WIDTH);
+			for (int c = 0; c < 3; c++) {
+				float value = std::min(std::max(m_Color[tile * TILE_PIXELS * 3 + size_t(c) * TILE_PIXELS + pixel], 0.f), 1.f);
+				row[3 * x + c] = table[int(value * 4095 + 0.5f)];
+			}
+		}
+	}
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "CpuTexture.h"
+#include "RenderDevice.h"
+
+class JobSystem;
+
+// RenderDevice drawing on the CPU, for machines without a GPU. EndFrame()
+// runs in two phases, each spread over the jobs of a JobSystem:
+// - setup: the draws are cut in chunks of triangles taken by the jobs in
+//   turn; triangles are transformed, clipped against the near plane and the
+//   guard band, back faces culled (as GL_CULL_FACE), edges snapped to fixed
+//   point and binned into the screen tiles by the job that set them up;
+// - raster: the jobs take the tiles in turn and draw every triangle
+//   binned there with a depth test (GL_LESS), LANES pixels at a time (8 with
+//   AVX2, 4 with SSE2), shading the pixels that pass with 3d.fs.glsl's
+//   Blinn-Phong lighting in SIMD.
+// Triangles of different jobs reach a tile in job order, which only
+// matters between fragments at exactly the same depth.
+class SoftwareRenderer : public RenderDevice
+{
+private:
+	struct MeshData
+	{
+		std::vector<Vertex3> vertices;
+		std::vector<uint32_t> indices;
+	};
+
+	// Triangle after setup: fixed point edge functions (A * x + B * y + C
+	// >= 0 inside, in subpixels), and planes of the interpolated values
+	// relative to the center of pixel `origin`.
+	struct Triangle
+	{
+		int32_t edgeA[3];
+		int32_t edgeB[3];
+		int64_t edgeC[3];
+		int pixelMin[2];
+		int pixelMax[2];
+		int origin[2];
+		uint32_t draw;
+		// z, 1 / w, then u, v, normal x, y, z divided by w.
+		float planes[7][3];
+	};
+
+	// Vertex in clip space with its u, v and normal, as produced by clipping.
+	struct ClipVertex
+	{
+		glm::vec4 position;
+		float attributes[5];
+	};
+
+	// Setup output of each job.
+	struct Setup
+	{
+		std::vector<Triangle> triangles;
+		std::vector<std::vector<uint32_t>> bins;
+	};
+
+	// Shading constants of a draw.
+	struct DrawState
+	{
+		const CpuTexture* texture;
+		glm::vec3 ambient;
+		glm::vec3 diffuse;
+		glm::vec3 specular;
+		float shininess;
+	};
+
+	std::vector<MeshData> m_Meshes;
+	std::vector<CpuTexture> m_Textures;
+	RenderFrame m_Frame;
+	std::vector<RenderDraw> m_Draws;
+	std::vector<DrawState> m_DrawStates;
+	JobSystem* m_Jobs = nullptr;
+	unsigned m_ThreadCount = 0;
+	int m_Width = 0;
+	int m_Height = 0;
+	int m_TilesX = 0;
+	int m_TilesY = 0;
+	// Tiled linear color (planar r, g, b) and depth, one block per tile.
+	std::vector<float> m_Color;
+	std::vector<float> m_Depth;
+	std::vector<Setup> m_Setups;
+	// Statistics of the last frame.
+	size_t m_TrianglesSubmitted = 0;
+	size_t m_TrianglesRasterized = 0;
+	unsigned m_FrameThreads = 0;
+	double m_SetupSeconds = 0;
+	double m_RasterSeconds = 0;
+
+	void SetupTriangle(Setup& setup, uint32_t draw, const ClipVertex* vertices);
+	void RasterizeTile(size_t tile);
+
+public:
+	// Renders with the jobs of `jobs`, on the calling thread alone without.
+	inline void SetJobSystem(JobSystem* jobs) { m_Jobs = jobs; }
+	// Maximum number of jobs per phase, 0 = one per thread of the job system.
+	inline void SetThreadCount(unsigned threads) { m_ThreadCount = threads; }
+
+	uint32_t CreateMesh(const Vertex3* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount) override;
+	uint32_t CreateTexture(int width, int height, const uint8_t* rgba) override;
+	void DestroyResources() override;
+
+	void BeginFrame(const RenderFrame& frame) override;
+	void Draw(const RenderDraw& draw) override;
+	void EndFrame() override;
+
+	void ReadPixels(std::vector<uint8_t>& rgb) const override;
+
+	inline int GetWidth() const { return m_Width; }
+	inline int GetHeight() const { return m_Height; }
+	inline size_t GetTrianglesSubmitted() const { return m_TrianglesSubmitted; }
+	// Triangles left after clipping and culling.
+	inline size_t GetTrianglesRasterized() const { return m_TrianglesRasterized; }
+	inline unsigned GetFrameThreads() const { return m_FrameThreads; }
+	inline double GetSetupSeconds() const { return m_SetupSeconds; }
+	inline double GetRasterSeconds() const { return m_RasterSeconds; }
+};
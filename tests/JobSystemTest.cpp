@@ -0,0 +1,221 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+// Stress tests of JobSystem (small, nested, dependent, background and
+// external jobs) on several thread counts, then a scaling benchmark of a
+// culling-like kernel. Needs no window or GPU; the stress cases are also
+// meant to be run under ThreadSanitizer (JOB_SYSTEM_TSAN=ON). Run with
+// "benchmark" for the benchmark only, or a number of stress rounds.
+
+namespace {
+
+int g_Failures = 0;
+
+void Check(bool condition, const char* what, unsigned threads) {
+	if (!condition) {
+		std::cerr << "FAILED with " << threads << " threads: " << what << std::endl;
+		g_Failures++;
+	}
+}
+
+void StressTiny(JobSystem& jobs, unsigned threads) {
+	std::atomic<size_t> sum(0);
+	JobCounter counter;
+	for (size_t i = 0; i < 20000; i++)
+		jobs.Run([&sum, i]() { sum += i; }, &counter);
+	jobs.Wait(counter);
+	Check(counter.IsDone() && sum == size_t(20000) * 19999 / 2, "every tiny job runs once", threads);
+}
+
+// Jobs waiting on the jobs they queue, 100 at a time like the recording of
+// a frame, then a chain of two continuations on the whole group.
+void StressNested(JobSystem& jobs, unsigned threads) {
+	const size_t STRESS_JOBS = 100000;
+	std::atomic<size_t> executed(0);
+	JobCounter stress;
+	for (size_t i = 0; i < STRESS_JOBS / 100; i++) {
+		jobs.Run([&jobs, &executed]() {
+			JobCounter nested;
+			for (int k = 0; k < 99; k++)
+				jobs.Run([&executed]() { executed++; }, &nested);
+			jobs.Wait(nested);
+			executed++;
+		}, &stress);
+	}
+	JobCounter chain[2];
+	std::atomic<bool> ordered(true);
+	std::atomic<int> continued(0);
+	jobs.RunAfter(stress, [&]() {
+		ordered = ordered && executed == STRESS_JOBS;
+		continued++;
+	}, &chain[0]);
+	jobs.RunAfter(chain[0], [&]() {
+		ordered = ordered && continued == 1;
+		continued++;
+	}, &chain[1]);
+	jobs.Wait(chain[1]);
+	Check(executed == STRESS_JOBS, "every nested job runs once", threads);
+	Check(ordered && continued == 2, "continuations run after their dependency", threads);
+}
+
+// 200 stages of 4 jobs, each stage queued once the previous one is done.
+void StressDependencies(JobSystem& jobs, unsigned threads) {
+	const int STAGES = 200, WIDTH = 4;
+	std::vector<JobCounter> stages(STAGES);
+	std::atomic<int> done(0);
+	std::atomic<bool> ordered(true);
+	for (int s = 0; s < STAGES; s++) {
+		for (int k = 0; k < WIDTH; k++) {
+			auto job = [&done, &ordered, s]() {
+				if (done.load() < s * WIDTH)
+					ordered = false;
+				done++;
+			};
+			if (s == 0)
+				jobs.Run(job, &stages[0]);
+			else
+				jobs.RunAfter(stages[s - 1], job, &stages[s]);
+		}
+	}
+	jobs.Wait(stages[STAGES - 1]);
+	Check(ordered && done == STAGES * WIDTH, "dependent stages run in order", threads);
+}
+
+void StressParallelFor(JobSystem& jobs, unsigned threads) {
+	std::vector<uint32_t> visits(100003, 0);
+	jobs.ParallelFor(visits.size(), 1000, [&visits](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+			visits[i]++;
+	});
+	Check(std::all_of(visits.begin(), visits.end(), [](uint32_t count) { return count == 1; }),
+		"ParallelFor visits every item once", threads);
+	bool empty = true;
+	jobs.ParallelFor(0, 16, [&empty](size_t, size_t) { empty = false; });
+	Check(empty, "ParallelFor over nothing calls nothing", threads);
+}
+
+// Jobs queued from a thread outside the system, while it is busy.
+void StressExternal(JobSystem& jobs, unsigned threads) {
+	JobCounter counter;
+	std::atomic<int> sum(0);
+	std::thread producer([&jobs, &counter, &sum]() {
+		for (int i = 0; i < 1000; i++)
+			jobs.Run([&sum]() { sum++; }, &counter);
+	});
+	jobs.ParallelFor(1000, 10, [](size_t, size_t) { std::this_thread::yield(); });
+	producer.join();
+	jobs.Wait(counter);
+	Check(sum == 1000, "jobs queued from another thread run", threads);
+}
+
+// Background jobs are not picked up by Wait(), but run, inline without
+// workers.
+void StressBackground(JobSystem& jobs, unsigned threads) {
+	JobCounter background;
+	std::atomic<int> ran(0);
+	for (int i = 0; i < 64; i++)
+		jobs.RunBackground([&ran]() { ran++; }, &background);
+	JobCounter foreground;
+	jobs.Run([]() {}, &foreground);
+	jobs.Wait(foreground);
+	jobs.Wait(background);
+	Check(ran == 64, "background jobs run", threads);
+}
+
+// Stop() runs what is still queued before joining.
+void StressStop(unsigned threads) {
+	std::atomic<int> ran(0);
+	{
+		JobSystem jobs;
+		jobs.Start(threads);
+		for (int i = 0; i < 1000; i++)
+			jobs.Run([&ran]() { ran++; });
+		jobs.Stop();
+	}
+	Check(ran == 1000, "Stop() runs the queued jobs", threads);
+}
+
+// Culling-like kernel: random vertices projected and tested against the
+// frustum, on 1, 2, 4... threads up to the hardware threads.
+void Benchmark(size_t vertexCount, int passes) {
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> coordinate(-100.f, 100.f);
+	std::vector<glm::vec3> vertices(vertexCount);
+	for (glm::vec3& vertex : vertices)
+		vertex = glm::vec3(coordinate(random), coordinate(random), coordinate(random));
+	const glm::mat4 viewProjection = glm::perspective(1.f, 16.f / 9.f, 0.1f, 500.f) *
+		glm::lookAt(glm::vec3(0, 20, 150), glm::vec3(0), glm::vec3(0, 1, 0));
+	auto kernel = [&](size_t begin, size_t end) {
+		size_t inside = 0;
+		for (size_t i = begin; i < end; i++) {
+			glm::vec4 clip = viewProjection * glm::vec4(vertices[i], 1);
+			inside += std::abs(clip.x) <= clip.w && std::abs(clip.y) <= clip.w && std::abs(clip.z) <= clip.w ? 1 : 0;
+		}
+		return inside;
+	};
+
+	unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	double single = 0;
+	for (unsigned threads = 1;; threads = std::min(threads * 2, maxThreads)) {
+		JobSystem jobs;
+		jobs.Start(threads);
+		std::atomic<size_t> inside(0);
+		auto start = std::chrono::steady_clock::now();
+		for (int pass = 0; pass < passes; pass++)
+			jobs.ParallelFor(vertexCount, 16384, [&](size_t begin, size_t end) { inside += kernel(begin, end); });
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / passes;
+		size_t steals = 0;
+		for (const JobThreadStats& thread : jobs.GetStats())
+			steals += thread.steals;
+		if (threads == 1)
+			single = seconds;
+		std::cout << "Benchmark, " << threads << " threads: " << vertexCount << " vertices culled in " << seconds * 1000
+			<< " ms (x" << single / seconds << "), " << steals << " steals, " << inside / passes << " inside" << std::endl;
+		if (threads == maxThreads)
+			break;
+	}
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	if (argc > 1 && std::strcmp(argv[1], "benchmark") == 0) {
+		Benchmark(size_t(1) << 23, 8);
+		return 0;
+	}
+	int rounds = argc > 1 ? std::max(std::atoi(argv[1]), 1) : 2;
+	const unsigned threadCounts[] = { 1, 2, 3, 4, 8 };
+	for (int round = 0; round < rounds; round++) {
+		for (unsigned threads : threadCounts) {
+			JobSystem jobs;
+			jobs.Start(threads);
+			StressTiny(jobs, threads);
+			StressNested(jobs, threads);
+			StressDependencies(jobs, threads);
+			StressParallelFor(jobs, threads);
+			StressExternal(jobs, threads);
+			StressBackground(jobs, threads);
+			StressStop(threads);
+		}
+	}
+	std::cout << "Stress: " << rounds << " rounds on 1, 2, 3, 4 and 8 threads" << std::endl;
+	Benchmark(size_t(1) << 20, 4);
+	if (g_Failures) {
+		std::cerr << g_Failures << " checks failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "All checks passed" << std::endl;
+	return EXIT_SUCCESS;
+}
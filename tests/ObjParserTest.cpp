@@ -0,0 +1,269 @@
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "ObjParser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// FastObjReader against tinyobj::ObjReader on synthetic OBJs (relative
+// indices, groups, faces without texture coordinates or normals) and on the
+// bundled meshes, split into 1, 2 and many chunks, then throughput
+// benchmarks of both readers and of FastObjReader per thread count. Needs no
+// window or GPU. Run with "benchmark" for the benchmarks only, on every
+// bundled mesh and a 64 MB synthetic OBJ.
+
+#ifndef OBJ_MESHES_DIR
+#define OBJ_MESHES_DIR "Projet/Obj/Meshes"
+#endif
+
+namespace {
+
+int g_Failures = 0;
+
+void Check(bool condition, const char* what, const std::string& name, size_t chunks) {
+	if (!condition) {
+		std::cerr << "FAILED on " << name << " in " << chunks << " chunks: " << what << std::endl;
+		g_Failures++;
+	}
+}
+
+bool SameIndices(const std::vector<tinyobj::index_t>& a, const std::vector<tinyobj::index_t>& b) {
+	return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+		[](const tinyobj::index_t& x, const tinyobj::index_t& y) {
+			return x.vertex_index == y.vertex_index && x.normal_index == y.normal_index &&
+				x.texcoord_index == y.texcoord_index;
+		});
+}
+
+bool SameMaterial(const tinyobj::material_t& a, const tinyobj::material_t& b) {
+	return a.name == b.name && a.diffuse_texname == b.diffuse_texname && a.bump_texname == b.bump_texname &&
+		a.dissolve == b.dissolve && a.illum == b.illum &&
+		std::equal(a.diffuse, a.diffuse + 3, b.diffuse) && std::equal(a.specular, a.specular + 3, b.specular);
+}
+
+void Compare(const FastObjReader& fast, const tinyobj::ObjReader& reference, const std::string& name, size_t chunks) {
+	Check(fast.Valid() == reference.Valid(), "same validity", name, chunks);
+	Check(fast.ChunkCount() <= chunks && (chunks == 1 || fast.ChunkCount() > 1), "split into chunks", name, chunks);
+	const tinyobj::attrib_t& a = fast.GetAttrib();
+	const tinyobj::attrib_t& b = reference.GetAttrib();
+	Check(a.vertices == b.vertices, "same positions", name, chunks);
+	Check(a.vertex_weights == b.vertex_weights, "same position weights", name, chunks);
+	Check(a.normals == b.normals, "same normals", name, chunks);
+	Check(a.texcoords == b.texcoords, "same texture coordinates", name, chunks);
+	Check(a.colors == b.colors, "same vertex colors", name, chunks);
+
+	const std::vector<tinyobj::shape_t>& shapesA = fast.GetShapes();
+	const std::vector<tinyobj::shape_t>& shapesB = reference.GetShapes();
+	Check(shapesA.size() == shapesB.size(), "same number of shapes", name, chunks);
+	for (size_t i = 0; i < std::min(shapesA.size(), shapesB.size()); i++) {
+		const tinyobj::mesh_t& meshA = shapesA[i].mesh;
+		const tinyobj::mesh_t& meshB = shapesB[i].mesh;
+		Check(shapesA[i].name == shapesB[i].name, "same shape names", name, chunks);
+		Check(SameIndices(meshA.indices, meshB.indices), "same face indices", name, chunks);
+		Check(meshA.num_face_vertices == meshB.num_face_vertices, "same face sizes", name, chunks);
+		Check(meshA.material_ids == meshB.material_ids, "same face materials", name, chunks);
+		Check(meshA.smoothing_group_ids == meshB.smoothing_group_ids, "same smoothing groups", name, chunks);
+	}
+
+	const std::vector<tinyobj::material_t>& materialsA = fast.GetMaterials();
+	const std::vector<tinyobj::material_t>& materialsB = reference.GetMaterials();
+	Check(materialsA.size() == materialsB.size() &&
+		std::equal(materialsA.begin(), materialsA.end(), materialsB.begin(), SameMaterial),
+		"same materials", name, chunks);
+}
+
+// Chunk counts to test a file with: whole, halves, and more chunks than
+// threads on most machines.
+std::vector<unsigned> ChunkCounts() {
+	return { 1, 2, std::max(7u, std::thread::hardware_concurrency()) };
+}
+
+void TestBuffer(const std::string& name, const std::string& obj) {
+	tinyobj::ObjReader reference;
+	reference.ParseFromString(obj, "");
+	for (unsigned chunks : ChunkCounts()) {
+		FastObjReader fast;
+		fast.SetThreadCount(chunks);
+		fast.SetMinChunkBytes(1);
+		fast.ParseFromBuffer(obj.data(), obj.size(), "");
+		Compare(fast, reference, name, chunks);
+	}
+}
+
+void TestFile(const std::string& filename) {
+	tinyobj::ObjReader reference;
+	reference.ParseFromFile(filename);
+	for (unsigned chunks : ChunkCounts()) {
+		FastObjReader fast;
+		fast.SetThreadCount(chunks);
+		fast.SetMinChunkBytes(1);
+		fast.ParseFromFile(filename);
+		Compare(fast, reference, filename, chunks);
+	}
+}
+
+// Grid of `columns` x `rows` vertices, one group per row of faces, declared
+// as it goes so that every chunk boundary falls between relative faces.
+// Faces cycle through quads of positions only, v/vt triangles, v//vn
+// triangles and v/vt/vn quads; every third row uses relative indices.
+std::string MakeGrid(int columns, int rows) {
+	std::ostringstream obj;
+	obj << "# synthetic grid\n";
+	int vertices = 0;
+	for (int r = 0; r < rows; r++) {
+		for (int c = 0; c < columns; c++) {
+			obj << "v " << c * 0.25f << ' ' << r * 0.5f << ' ' << (c * r % 7) * 0.125f << '\n';
+			obj << "vt " << float(c) / columns << ' ' << float(r) / rows << '\n';
+			obj << "vn 0 " << (r % 2 ? "0.6 0.8" : "0 1") << '\n';
+		}
+		vertices += columns;
+		if (r == 0)
+			continue;
+		obj << (r % 4 == 0 ? "o object" : "g group") << r << '\n';
+		obj << "s " << (r % 2 ? "1" : "off") << '\n';
+		bool relative = r % 3 == 0;
+		auto index = [&](int row, int column) {
+			int absolute = row * columns + column + 1;
+			return relative ? absolute - vertices - 1 : absolute;
+		};
+		for (int c = 0; c + 1 < columns; c++) {
+			int i0 = index(r - 1, c), i1 = index(r - 1, c + 1), i2 = index(r, c + 1), i3 = index(r, c);
+			switch (c % 4) {
+			case 0:
+				obj << "f " << i0 << ' ' << i1 << ' ' << i2 << ' ' << i3 << '\n';
+				break;
+			case 1:
+				obj << "f " << i0 << '/' << i0 << ' ' << i1 << '/' << i1 << ' ' << i2 << '/' << i2 << '\n';
+				obj << "f " << i0 << '/' << i0 << ' ' << i2 << '/' << i2 << ' ' << i3 << '/' << i3 << '\n';
+				break;
+			case 2:
+				obj << "f " << i0 << "//" << i0 << ' ' << i1 << "//" << i1 << ' ' << i2 << "//" << i2 << '\n';
+				obj << "f " << i0 << "//" << i0 << ' ' << i2 << "//" << i2 << ' ' << i3 << "//" << i3 << '\n';
+				break;
+			default:
+				obj << "f " << i0 << '/' << i0 << '/' << i0 << ' ' << i1 << '/' << i1 << '/' << i1 << ' '
+					<< i2 << '/' << i2 << '/' << i2 << ' ' << i3 << '/' << i3 << '/' << i3 << '\n';
+				break;
+			}
+		}
+	}
+	return obj.str();
+}
+
+void TestSynthetic() {
+	TestBuffer("grid", MakeGrid(33, 40));
+	TestBuffer("positions only",
+		"v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+		"f 1 2 3\nf -4 -2 -1\n"
+		"g named\nv 0 0 1\nv 1 0 1\nv 1 1 1\nf -3 -2 -1 4\n"
+		"g\nf 5 6 7\n");
+	TestBuffer("CRLF, no trailing newline",
+		"v 0 0 0\r\nvt 0 0\r\nv 1 0 0\r\nvt 1 0\r\nv 0 1 0\r\nvt 0 1\r\nv 1 1 0\r\nvt 1 1\r\n"
+		"g first\r\nf 1/1 2/2 3/3\r\ng last\r\nf -3/-3 -2/-2 -1/-1");
+}
+
+// Parse time of a synthetic OBJ on 1, 2, 4... threads up to the hardware
+// threads.
+void Benchmark(int columns, int rows, int passes) {
+	std::string obj = MakeGrid(columns, rows);
+	unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	double single = 0;
+	for (unsigned threads = 1;; threads = std::min(threads * 2, maxThreads)) {
+		FastObjReader reader;
+		reader.SetThreadCount(threads);
+		double best = 1e30;
+		for (int pass = 0; pass < passes; pass++) {
+			reader.ParseFromBuffer(obj.data(), obj.size(), "");
+			best = std::min(best, reader.ParseSeconds());
+		}
+		if (threads == 1)
+			single = best;
+		std::cout << "Benchmark, " << threads << " threads: " << obj.size() / 1024 << " KB in "
+			<< reader.ChunkCount() << " chunks parsed in " << best * 1000 << " ms, "
+			<< obj.size() / (1024.0 * 1024.0) / best << " MB/s (x" << single / best << ")" << std::endl;
+		if (threads == maxThreads)
+			break;
+	}
+}
+
+// Best time of `passes` calls to `parse`, in seconds.
+template <typename Parse>
+double BestTime(int passes, Parse parse) {
+	double best = 1e30;
+	for (int pass = 0; pass < passes; pass++) {
+		auto start = std::chrono::steady_clock::now();
+		parse();
+		best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+	return best;
+}
+
+void ReportReaders(const std::string& name, size_t bytes, double fast, double reference) {
+	double megabytes = bytes / (1024.0 * 1024.0);
+	std::cout << "Readers, " << name << " (" << bytes / 1024 << " KB): FastObjReader " << megabytes / fast
+		<< " MB/s, tinyobj::ObjReader " << megabytes / reference << " MB/s (x" << reference / fast << ")" << std::endl;
+}
+
+// FastObjReader with its default settings, as the application uses it,
+// against tinyobj::ObjReader on a file, both including the file reads.
+void BenchmarkReaders(const std::string& filename, int passes) {
+	size_t bytes = 0;
+	double fast = BestTime(passes, [&]() {
+		FastObjReader reader;
+		reader.ParseFromFile(filename);
+		bytes = reader.BytesParsed();
+	});
+	double reference = BestTime(passes, [&]() {
+		tinyobj::ObjReader reader;
+		reader.ParseFromFile(filename);
+	});
+	ReportReaders(filename.substr(filename.find_last_of('/') + 1), bytes, fast, reference);
+}
+
+// Same on a synthetic grid kept in memory.
+void BenchmarkReaders(int columns, int rows, int passes) {
+	std::string obj = MakeGrid(columns, rows);
+	double fast = BestTime(passes, [&]() {
+		FastObjReader reader;
+		reader.ParseFromBuffer(obj.data(), obj.size(), "");
+	});
+	double reference = BestTime(passes, [&]() {
+		tinyobj::ObjReader reader;
+		reader.ParseFromString(obj, "");
+	});
+	ReportReaders("synthetic grid", obj.size(), fast, reference);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	if (argc > 1 && std::strcmp(argv[1], "benchmark") == 0) {
+		const char* meshes[] = { "Botle.obj", "Mr_Bean_Pirate.obj", "Stylized_pirate_scene.obj", "Wooden.obj",
+			"dinertable.obj", "map.obj", "nolegs.obj", "plate.obj" };
+		for (const char* mesh : meshes)
+			BenchmarkReaders(std::string(OBJ_MESHES_DIR) + "/" + mesh, 5);
+		BenchmarkReaders(1000, 600, 3);
+		Benchmark(1000, 600, 5);
+		return 0;
+	}
+	TestSynthetic();
+	const char* meshes[] = { "Botle.obj", "Mr_Bean_Pirate.obj", "Wooden.obj", "dinertable.obj", "plate.obj" };
+	for (const char* mesh : meshes)
+		TestFile(std::string(OBJ_MESHES_DIR) + "/" + mesh);
+	std::cout << "Compared with tinyobj::ObjReader: 3 synthetic and " << sizeof(meshes) / sizeof(meshes[0])
+		<< " bundled OBJs in 1, 2 and " << ChunkCounts().back() << " chunks" << std::endl;
+	BenchmarkReaders(250, 150, 3);
+	Benchmark(250, 150, 3);
+	if (g_Failures) {
+		std::cerr << g_Failures << " checks failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "All checks passed" << std::endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,276 @@
+#include "OcclusionBuffer.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+// Checks OcclusionBuffer against a scalar reference rasterizer and tests its
+// box queries, then reports the occluder throughput; no window or GPU
+// needed. Run with "benchmark" for the longer throughput runs only.
+
+namespace {
+
+int g_Failures = 0;
+
+void Check(bool condition, const char* what) {
+	if (!condition) {
+		std::cerr << "FAILED: " << what << std::endl;
+		g_Failures++;
+	}
+}
+
+// Reference with the same clipping, snapping and fill rule as the buffer,
+// one pixel at a time in 64-bit integers and double depth.
+std::vector<float> RasterizeReference(int width, int height, const std::vector<glm::vec3>& positions,
+	const std::vector<uint32_t>& indices, const glm::mat4& matrix) {
+	const int64_t SUBPIXELS = 4;
+	std::vector<float> depth(size_t(width) * size_t(height), 1.f);
+	const float halfWidth = 0.5f * float(width), halfHeight = 0.5f * float(height);
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		int64_t x[3], y[3];
+		double z[3];
+		bool clipped = false;
+		for (int k = 0; k < 3; k++) {
+			const glm::vec3& position = positions[indices[i + k]];
+			glm::vec4 clip = matrix[0] * position.x + matrix[1] * position.y + matrix[2] * position.z + matrix[3];
+			if (clip.w < 1e-5f || clip.z < -clip.w) {
+				clipped = true;
+				break;
+			}
+			float invW = 1 / clip.w;
+			float screenX = (clip.x * invW + 1) * halfWidth, screenY = (clip.y * invW + 1) * halfHeight;
+			if (std::abs(screenX) > 65536.f || std::abs(screenY) > 65536.f) {
+				clipped = true;
+				break;
+			}
+			x[k] = int64_t(std::floor(screenX * float(SUBPIXELS) + 0.5f));
+			y[k] = int64_t(std::floor(screenY * float(SUBPIXELS) + 0.5f));
+			z[k] = clip.z * invW;
+		}
+		if (clipped)
+			continue;
+		int64_t area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+		if (area <= 0)
+			continue;
+		for (int py = 0; py < height; py++) {
+			for (int px = 0; px < width; px++) {
+				int64_t cx = int64_t(px) * SUBPIXELS + SUBPIXELS / 2, cy = int64_t(py) * SUBPIXELS + SUBPIXELS / 2;
+				int64_t weights[3];
+				bool inside = true;
+				for (int k = 0; k < 3 && inside; k++) {
+					int a = (k + 1) % 3, b = (k + 2) % 3;
+					weights[k] = (y[a] - y[b]) * (cx - x[a]) + (x[b] - x[a]) * (cy - y[a]);
+					inside = weights[k] >= 0;
+				}
+				if (!inside)
+					continue;
+				double pixelZ = (double(weights[0]) * z[0] + double(weights[1]) * z[1] + double(weights[2]) * z[2]) / double(area);
+				float& stored = depth[size_t(py) * size_t(width) + size_t(px)];
+				stored = std::min(stored, float(pixelZ));
+			}
+		}
+	}
+	return depth;
+}
+
+// Triangles in NDC (drawn with the identity), some larger than the screen,
+// some crossing the near plane, both windings.
+void RandomTriangles(std::mt19937& random, size_t count, float maxSize, std::vector<glm::vec3>& positions,
+	std::vector<uint32_t>& indices) {
+	std::uniform_real_distribution<float> center(-1.2f, 1.2f), depth(-1.1f, 1.f), unit(-1.f, 1.f);
+	positions.clear();
+	indices.clear();
+	for (size_t t = 0; t < count; t++) {
+		glm::vec3 c(center(random), center(random), depth(random));
+		for (int k = 0; k < 3; k++) {
+			indices.push_back(uint32_t(positions.size()));
+			positions.push_back(c + glm::vec3(unit(random) * maxSize, unit(random) * maxSize, unit(random) * 0.1f));
+		}
+	}
+}
+
+void TestAgainstReference() {
+	std::mt19937 random(1);
+	// Not a multiple of the tile size, so partial tiles are covered too
+	const int width = 317, height = 173;
+	const float sizes[] = { 0.02f, 0.2f, 2.f };
+	const unsigned threadCounts[] = { 1, 8 };
+	for (float size : sizes) {
+		std::vector<glm::vec3> positions;
+		std::vector<uint32_t> indices;
+		// Enough triangles for the tiles to be spread over jobs
+		RandomTriangles(random, size < 1 ? 20000 : 200, size, positions, indices);
+		std::vector<float> reference = RasterizeReference(width, height, positions, indices, glm::mat4(1));
+		for (unsigned threads : threadCounts) {
+			JobSystem jobs;
+			jobs.Start(threads);
+			OcclusionBuffer buffer;
+			buffer.SetJobSystem(&jobs);
+			buffer.Resize(width, height);
+			buffer.Clear();
+			buffer.AddOccluder(positions.data(), sizeof(glm::vec3), indices.data(), indices.size(), glm::mat4(1));
+			buffer.BuildPyramid();
+			size_t coverage = 0;
+			float maxError = 0;
+			for (size_t i = 0; i < reference.size(); i++) {
+				float depth = buffer.GetDepth()[i];
+				if ((depth == 1.f) != (reference[i] == 1.f))
+					coverage++;
+				else
+					maxError = std::max(maxError, std::abs(depth - reference[i]));
+			}
+			std::cout << "Reference, size " << size << ", " << threads << " threads: " << coverage
+				<< " coverage differences, max depth error " << maxError << std::endl;
+			Check(coverage == 0, "coverage matches the reference");
+			Check(maxError < 1e-5f, "depth matches the reference");
+		}
+	}
+}
+
+// Two triangles sharing a diagonal cover every pixel of their quad once.
+void TestSharedEdges() {
+	OcclusionBuffer buffer;
+	buffer.Resize(64, 48);
+	buffer.Clear();
+	const glm::vec3 quad[4] = { { -0.73f, -0.61f, 0 }, { 0.67f, -0.59f, 0 }, { 0.71f, 0.63f, 0 }, { -0.69f, 0.57f, 0 } };
+	const uint32_t indices[6] = { 0, 1, 2, 0, 2, 3 };
+	buffer.AddOccluder(quad, sizeof(glm::vec3), indices, 6, glm::mat4(1));
+	buffer.BuildPyramid();
+	int holes = 0;
+	for (int y = 14; y < 34; y++)
+		for (int x = 12; x < 52; x++)
+			holes += buffer.GetDepth()[y * 64 + x] == 1.f ? 1 : 0;
+	Check(holes == 0, "no hole along a shared edge");
+}
+
+void TestQueries() {
+	// Camera at z = 10 looking down -z at a 10x10 wall in the z = 0 plane
+	const glm::mat4 matrix = glm::perspective(1.f, 4.f / 3.f, 0.1f, 500.f) *
+		glm::lookAt(glm::vec3(0, 0, 10), glm::vec3(0), glm::vec3(0, 1, 0));
+	const glm::vec3 wall[4] = { { -5, -5, 0 }, { 5, -5, 0 }, { 5, 5, 0 }, { -5, 5, 0 } };
+	const uint32_t indices[6] = { 0, 1, 2, 0, 2, 3 };
+	OcclusionBuffer buffer;
+	buffer.Resize(320, 240);
+	Check(buffer.IsVisible(glm::vec3(-1), glm::vec3(1), matrix), "everything visible before the first pyramid");
+	buffer.Clear();
+	buffer.AddOccluder(wall, sizeof(glm::vec3), indices, 6, matrix);
+	buffer.BuildPyramid();
+	Check(buffer.GetTrianglesRasterized() == 2, "both wall triangles drawn");
+
+	Check(!buffer.IsVisible({ -1, -1, -3 }, { 1, 1, -2 }, matrix), "box behind the wall is occluded");
+	Check(!buffer.IsVisible({ -4, -4, -50 }, { 4, 4, -40 }, matrix), "far box behind the wall is occluded");
+	Check(buffer.IsVisible({ -1, -1, 1 }, { 1, 1, 2 }, matrix), "box in front of the wall is visible");
+	Check(buffer.IsVisible({ -1, -1, -1 }, { 1, 1, 1 }, matrix), "box through the wall is visible");
+	Check(buffer.IsVisible({ -20, -1, -30 }, { 20, 1, -29 }, matrix), "box wider than the wall is visible");
+	Check(buffer.IsVisible({ 4, -1, -3 }, { 6, 1, -2 }, matrix), "box over the wall's edge is visible");
+	Check(!buffer.IsVisible({ 100, 0, 0 }, { 101, 1, 1 }, matrix), "box outside the screen is not visible");
+	Check(buffer.IsVisible({ -1, -1, 9 }, { 1, 1, 11 }, matrix), "box crossing the near plane is visible");
+
+	// The wall seen from behind is culled and hides nothing
+	const glm::mat4 behind = glm::perspective(1.f, 4.f / 3.f, 0.1f, 500.f) *
+		glm::lookAt(glm::vec3(0, 0, -10), glm::vec3(0), glm::vec3(0, 1, 0));
+	buffer.Clear();
+	buffer.AddOccluder(wall, sizeof(glm::vec3), indices, 6, behind);
+	buffer.BuildPyramid();
+	Check(buffer.GetTrianglesRasterized() == 0, "back facing occluders are skipped");
+	Check(buffer.IsVisible({ -1, -1, 2 }, { 1, 1, 3 }, behind), "nothing is occluded by a culled wall");
+}
+
+// A box reported occluded must be behind the reference depth at every pixel
+// its screen rectangle covers, whatever pyramid level answered.
+void TestQueriesConservative() {
+	std::mt19937 random(2);
+	const int width = 160, height = 120;
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> indices;
+	RandomTriangles(random, 400, 0.3f, positions, indices);
+	std::vector<float> reference = RasterizeReference(width, height, positions, indices, glm::mat4(1));
+	OcclusionBuffer buffer;
+	buffer.Resize(width, height);
+	buffer.Clear();
+	buffer.AddOccluder(positions.data(), sizeof(glm::vec3), indices.data(), indices.size(), glm::mat4(1));
+	buffer.BuildPyramid();
+
+	std::uniform_real_distribution<float> center(-1.f, 1.f), extent(0.f, 0.2f), depth(-1.f, 1.f);
+	size_t occluded = 0, wrong = 0;
+	for (int i = 0; i < 20000; i++) {
+		glm::vec3 c(center(random), center(random), depth(random));
+		glm::vec3 e(extent(random), extent(random), extent(random) * 0.1f);
+		glm::vec3 boundsMin = c - e, boundsMax = glm::min(c + e, glm::vec3(1));
+		if (buffer.IsVisible(boundsMin, boundsMax, glm::mat4(1)))
+			continue;
+		occluded++;
+		// The pixels whose centers the query stands for, as in IsVisible()
+		int x0 = std::max(int((boundsMin.x + 1) * 0.5f * float(width)), 0);
+		int x1 = std::min(int((boundsMax.x + 1) * 0.5f * float(width)), width - 1);
+		int y0 = std::max(int((boundsMin.y + 1) * 0.5f * float(height)), 0);
+		int y1 = std::min(int((boundsMax.y + 1) * 0.5f * float(height)), height - 1);
+		bool hidden = true;
+		for (int y = y0; y <= y1 && hidden; y++)
+			for (int x = x0; x <= x1 && hidden; x++)
+				hidden = reference[size_t(y) * size_t(width) + size_t(x)] < boundsMin.z;
+		wrong += hidden ? 0 : 1;
+	}
+	std::cout << "Queries: " << occluded << " of 20000 random boxes occluded, " << wrong << " wrongly" << std::endl;
+	Check(occluded > 0, "some random boxes are occluded");
+	Check(wrong == 0, "occluded boxes are hidden in the reference");
+}
+
+// Occluder throughput at the application's buffer size, per thread count.
+void Benchmark(size_t triangleCount, int repeats) {
+	std::mt19937 random(3);
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> indices;
+	RandomTriangles(random, triangleCount, 0.05f, positions, indices);
+	unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<unsigned> threadCounts;
+	for (unsigned threads = 1; threads < hardware; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(hardware);
+	for (unsigned threads : threadCounts) {
+		JobSystem jobs;
+		jobs.Start(threads);
+		OcclusionBuffer buffer;
+		buffer.SetJobSystem(&jobs);
+		buffer.Resize(320, 180);
+		double best = 1e30;
+		size_t rasterized = 0;
+		for (int i = 0; i < repeats; i++) {
+			buffer.Clear();
+			buffer.AddOccluder(positions.data(), sizeof(glm::vec3), indices.data(), indices.size(), glm::mat4(1));
+			buffer.BuildPyramid();
+			best = std::min(best, buffer.GetRasterizeSeconds());
+			rasterized = buffer.GetTrianglesRasterized();
+		}
+		std::cout << "Benchmark, " << threads << " threads: " << rasterized << " occluder triangles in " << best * 1000
+			<< " ms (" << double(rasterized) / (best * 1000) << " triangles/ms)" << std::endl;
+	}
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	if (argc > 1 && std::strcmp(argv[1], "benchmark") == 0) {
+		Benchmark(1000000, 20);
+		return 0;
+	}
+	TestAgainstReference();
+	TestSharedEdges();
+	TestQueries();
+	TestQueriesConservative();
+	Benchmark(100000, 5);
+	if (g_Failures) {
+		std::cerr << g_Failures << " checks failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "All checks passed" << std::endl;
+	return EXIT_SUCCESS;
+}